@@ -0,0 +1,660 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// the micro-benchmark suite for the hot paths: stream demuxing, scope
+// painting, X/Y fading, spectrum transforms, CSV formatting, config
+// checksumming and console appends; every case runs for a minimum wall
+// time and the results are written as JSON, so runs can be compared
+// against each other
+//
+// usage: ServotermBench [--json <file>] [--filter <substring>] [--min-time <ms>]
+
+#include "ScopeDataDemux.h"
+#include "ScopeDataScanner.h"
+#include "ScopeCsv.h"
+#include "ScopeRecording.h"
+#include "ConfigChecksum.h"
+#include "Oscilloscope.h"
+#include "OscilloscopeRenderer.h"
+#include "ScopeHistory.h"
+#include "ScopeTrigger.h"
+#include "ScopeStatistics.h"
+#include "XYOscilloscope.h"
+#include "FftPlan.h"
+#include "SpectrumAnalyzer.h"
+#include "AppendTextToEdit.h"
+#include "TextLineAssembler.h"
+#include "globals.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QImage>
+#include <QPlainTextEdit>
+#include <QTextEdit>
+
+#include <cmath>
+#include <functional>
+
+using namespace STMBL_Servoterm;
+
+static const int DEMUX_CHUNK_SIZE = 4096; // roughly what readAll() returns under load
+static const int DEMUX_STREAM_SIZE = 4*1024*1024;
+static const int SCOPE_HEIGHT = 300;
+
+class BenchRunner
+{
+public:
+    BenchRunner(qint64 minimumTimeMs, const QString &filter) : _minimumTimeMs(minimumTimeMs), _filter(filter), _err(stderr) {}
+
+    // calls setup() untimed, then body() batchSize times timed, until
+    // the minimum time has been spent in body(); itemsPerCall is what
+    // the throughput is reported in (bytes, packets, points...)
+    void run(const QString &name, double itemsPerCall, const QString &unit,
+             const std::function<void()> &body,
+             const std::function<void()> &setup = std::function<void()>(),
+             int batchSize = 1)
+    {
+        if (!_filter.isEmpty() && !name.contains(_filter))
+            return;
+        if (setup)
+            setup();
+        body(); // warm up the caches and any lazily allocated buffers
+        qint64 calls = 0;
+        qint64 elapsedNs = 0;
+        QElapsedTimer timer;
+        while (elapsedNs < _minimumTimeMs*1000000)
+        {
+            if (setup)
+                setup();
+            timer.start();
+            for (int i = 0; i < batchSize; i++)
+                body();
+            elapsedNs += timer.nsecsElapsed();
+            calls += batchSize;
+        }
+        const double nsPerCall = static_cast<double>(elapsedNs)/calls;
+        const double itemsPerSecond = itemsPerCall*1.0e9/nsPerCall;
+
+        QJsonObject result;
+        result["name"] = name;
+        result["iterations"] = static_cast<double>(calls);
+        result["ns_per_iteration"] = nsPerCall;
+        result["items_per_iteration"] = itemsPerCall;
+        result["items_per_second"] = itemsPerSecond;
+        result["unit"] = unit;
+        _results.append(result);
+
+        _err << name.leftJustified(40) << QString::number(nsPerCall/1000.0, 'f', 2).rightJustified(12) << " us/iter "
+             << QString::number(itemsPerSecond, 'g', 4).rightJustified(12) << " " << unit << "/s" << '\n';
+        _err.flush(); // NOTE: so the cases show up as they finish
+    }
+    QJsonArray results() const {return _results;}
+protected:
+    qint64 _minimumTimeMs;
+    QString _filter;
+    QTextStream _err;
+    QJsonArray _results;
+};
+
+// builds a stream where roughly textPercent of the bytes are console text
+static QByteArray MakeDemuxStream(int textPercent, int channelCount = SCOPE_CHANNEL_COUNT)
+{
+    static const QByteArray line = "fault0.en <= 1\n";
+    QByteArray stream;
+    stream.reserve(DEMUX_STREAM_SIZE + 64);
+    quint32 seed = 12345;
+    int textBytes = 0;
+    while (stream.size() < DEMUX_STREAM_SIZE)
+    {
+        if (textBytes*100 < stream.size()*textPercent)
+        {
+            stream.append(line);
+            textBytes += line.size();
+            continue;
+        }
+        stream.append(static_cast<char>(0xFF));
+        for (int channel = 0; channel < channelCount; channel++)
+        {
+            seed = seed*1103515245 + 12345;
+            stream.append(static_cast<char>((seed >> 16) % 0xFE)); // never a marker
+        }
+    }
+    return stream;
+}
+
+// the same, in 16-bit CRC checked extended frames
+static QByteArray MakeExtendedDemuxStream(int channelCount)
+{
+    QByteArray stream;
+    stream.reserve(DEMUX_STREAM_SIZE + 64);
+    quint32 seed = 12345;
+    quint8 frame[1 + 2*SCOPE_MAXIMUM_CHANNEL_COUNT + 2];
+    const int length = 1 + 2*channelCount;
+    while (stream.size() < DEMUX_STREAM_SIZE)
+    {
+        frame[0] = static_cast<quint8>(channelCount);
+        for (int i = 1; i < length; i++)
+        {
+            seed = seed*1103515245 + 12345;
+            frame[i] = static_cast<quint8>(seed >> 16);
+        }
+        const quint16 crc = ScopeScanCrc16(frame, length);
+        frame[length] = static_cast<quint8>(crc & 0xFF);
+        frame[length + 1] = static_cast<quint8>(crc >> 8);
+        stream.append(static_cast<char>(0xFF));
+        stream.append(static_cast<char>(0xFF));
+        stream.append(reinterpret_cast<const char *>(frame), length + 2);
+    }
+    return stream;
+}
+
+// the byte-at-a-time loop ScopeDataDemux used before the scanner, kept as the baseline
+struct LegacyDemux
+{
+    LegacyDemux() : readingPacket(false), packets(0) {}
+    QString addData(const QByteArray &data)
+    {
+        QString txt;
+        for (QByteArray::const_iterator it = data.begin(); it != data.end(); ++it)
+        {
+            if (readingPacket)
+            {
+                packet.append((static_cast<int>(static_cast<quint8>(*it)) - 128) / 128.0);
+                if (packet.size() == SCOPE_CHANNEL_COUNT)
+                {
+                    QVector<float> copy = packet;
+                    readingPacket = false;
+                    packet.resize(0);
+                    packets += copy.size()/SCOPE_CHANNEL_COUNT;
+                }
+            }
+            else if (*it == static_cast<char>(0xFF))
+            {
+                readingPacket = true;
+                packet.resize(0);
+            }
+            else if (*it != static_cast<char>(0xFE))
+            {
+                txt.append(QChar::fromLatin1(*it));
+            }
+        }
+        return txt;
+    }
+    bool readingPacket;
+    QVector<float> packet;
+    qint64 packets;
+};
+
+static void BenchDemux(BenchRunner &runner)
+{
+    static const int TEXT_MIXES[] = {0, 10, 50, 100};
+    const ScopeScanIsa bestIsa = ScopeScanBestIsa();
+    for (unsigned m = 0; m < sizeof(TEXT_MIXES)/sizeof(TEXT_MIXES[0]); m++)
+    {
+        const QByteArray stream = MakeDemuxStream(TEXT_MIXES[m]);
+        QList<QByteArray> chunks;
+        for (int offset = 0; offset < stream.size(); offset += DEMUX_CHUNK_SIZE)
+            chunks.append(stream.mid(offset, DEMUX_CHUNK_SIZE));
+        const QString prefix = QString("demux/text%1/").arg(TEXT_MIXES[m]);
+
+        LegacyDemux legacy;
+        runner.run(prefix + "legacy", stream.size(), "bytes", [&] () {
+            for (QList<QByteArray>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+                legacy.addData(*it);
+        });
+        for (int isa = SCOPE_SCAN_ISA_SCALAR; isa <= bestIsa; isa++)
+        {
+            ScopeScanSetIsa(static_cast<ScopeScanIsa>(isa));
+            ScopeDataDemux demux;
+            QByteArray text;
+            text.reserve(DEMUX_CHUNK_SIZE);
+            qint64 packets = 0;
+            QObject::connect(&demux, &ScopeDataDemux::scopePacketsReceived, [&packets] (const ScopeSampleBlock &block) {
+                packets += block.packetCount();
+            });
+            runner.run(prefix + QString(ScopeScanIsaName(static_cast<ScopeScanIsa>(isa))).toLower(), stream.size(), "bytes", [&] () {
+                for (QList<QByteArray>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+                {
+                    text.resize(0);
+                    demux.addData(*it, text);
+                }
+            });
+        }
+    }
+    ScopeScanSetIsa(bestIsa);
+
+    // the other packet widths, which have their own decode kernels
+    static const int CHANNEL_COUNTS[] = {4, 5, 16};
+    for (unsigned c = 0; c < sizeof(CHANNEL_COUNTS)/sizeof(CHANNEL_COUNTS[0]); c++)
+    {
+        const QByteArray stream = MakeDemuxStream(0, CHANNEL_COUNTS[c]);
+        QList<QByteArray> chunks;
+        for (int offset = 0; offset < stream.size(); offset += DEMUX_CHUNK_SIZE)
+            chunks.append(stream.mid(offset, DEMUX_CHUNK_SIZE));
+        ScopeDataDemux demux;
+        demux.setChannelCount(CHANNEL_COUNTS[c]);
+        QByteArray text;
+        runner.run(QString("demux/channels%1/%2").arg(CHANNEL_COUNTS[c]).arg(QString(ScopeScanIsaName(bestIsa)).toLower()), stream.size(), "bytes", [&] () {
+            for (QList<QByteArray>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+                demux.addData(*it, text);
+        });
+    }
+
+    // extended frames, CRC check included
+    static const int EXTENDED_CHANNEL_COUNTS[] = {8, 16};
+    for (unsigned c = 0; c < sizeof(EXTENDED_CHANNEL_COUNTS)/sizeof(EXTENDED_CHANNEL_COUNTS[0]); c++)
+    {
+        const QByteArray stream = MakeExtendedDemuxStream(EXTENDED_CHANNEL_COUNTS[c]);
+        QList<QByteArray> chunks;
+        for (int offset = 0; offset < stream.size(); offset += DEMUX_CHUNK_SIZE)
+            chunks.append(stream.mid(offset, DEMUX_CHUNK_SIZE));
+        ScopeDataDemux demux;
+        QByteArray text;
+        runner.run(QString("demux/extended%1/%2").arg(EXTENDED_CHANNEL_COUNTS[c]).arg(QString(ScopeScanIsaName(bestIsa)).toLower()), stream.size(), "bytes", [&] () {
+            for (QList<QByteArray>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+                demux.addData(*it, text);
+        });
+    }
+}
+
+// packetCount packets of smooth, distinct traces, like a running drive
+static ScopeSampleBlock MakeScopeBlock(int packetCount)
+{
+    ScopeSampleBlock block;
+    block.samples.resize(packetCount*block.channelCount);
+    for (int i = 0; i < packetCount; i++)
+    {
+        for (int channel = 0; channel < block.channelCount; channel++)
+        {
+            const double phase = i*0.01*(channel + 1);
+            // quantized like the real 8-bit codes
+            block.samples[i*block.channelCount + channel] = std::floor(std::sin(phase)*0.9*128.0)/128.0;
+        }
+    }
+    return block;
+}
+
+static void BenchOscilloscope(BenchRunner &runner)
+{
+    // rasterizing a full sweep, off the GUI thread in the application
+    static const int WIDTHS[] = {600, 1200, 1920, 3840};
+    for (unsigned w = 0; w < sizeof(WIDTHS)/sizeof(WIDTHS[0]); w++)
+    {
+        OscilloscopeRenderer renderer;
+        renderer.setSize(QSize(WIDTHS[w], SCOPE_HEIGHT));
+        const ScopeSampleBlock block = MakeScopeBlock(WIDTHS[w]); // one full sweep
+        runner.run(QString("oscilloscope/render/%1").arg(WIDTHS[w]), 1, "frames", [&] () {
+            renderer.addSamples(block);
+            renderer.render();
+        });
+    }
+
+    // a long timebase, folding many packets into every column
+    static const int PACKETS_PER_COLUMN = 100;
+    {
+        OscilloscopeRenderer renderer;
+        renderer.setSize(QSize(1920, SCOPE_HEIGHT));
+        renderer.setPacketsPerColumn(PACKETS_PER_COLUMN);
+        const ScopeSampleBlock block = MakeScopeBlock(1920*PACKETS_PER_COLUMN); // one full sweep
+        runner.run(QString("oscilloscope/render/1920/decimated%1").arg(PACKETS_PER_COLUMN), 1, "frames", [&] () {
+            renderer.addSamples(block);
+            renderer.render();
+        });
+    }
+
+    // the few new columns one drain brings, at a few kHz
+    {
+        OscilloscopeRenderer renderer;
+        renderer.setSize(QSize(1920, SCOPE_HEIGHT));
+        const ScopeSampleBlock block = MakeScopeBlock(64);
+        runner.run("oscilloscope/render/1920/update64", block.packetCount(), "packets", [&] () {
+            renderer.addSamples(block);
+            renderer.render();
+        });
+    }
+
+    // keeping every packet, a channel's ring at a time
+    {
+        ScopeHistory history;
+        const ScopeSampleBlock block = MakeScopeBlock(1 << 16);
+        runner.run("oscilloscope/history/append", block.packetCount(), "packets", [&] () {
+            history.append(block.samples.constData(), block.packetCount());
+        });
+    }
+
+    // the paused view zoomed all the way out over a full history,
+    // summarized from the pyramid rather than from every packet
+    {
+        OscilloscopeRenderer renderer;
+        renderer.setSize(QSize(1920, SCOPE_HEIGHT));
+        const ScopeSampleBlock block = MakeScopeBlock(1 << 20);
+        for (int i = 0; i < 4; i++)
+            renderer.addSamples(block);
+        renderer.setPaused(true);
+        renderer.zoomView(32, 1920);
+        int direction = 1;
+        runner.run("oscilloscope/history/1920/overview", 1, "frames", [&] () {
+            renderer.panView(direction = -direction); // NOTE: anything to make it render again
+            renderer.render();
+        });
+    }
+
+    // looking for an edge in every packet that comes in
+    {
+        ScopeTrigger trigger;
+        ScopeTriggerSettings settings;
+        settings.level = 2.0f; // NOTE: never reached, so every packet is looked at
+        trigger.setSettings(settings);
+        const ScopeSampleBlock block = MakeScopeBlock(1 << 16);
+        runner.run("oscilloscope/trigger/scan", block.packetCount(), "packets", [&] () {
+            trigger.scan(block.samples.constData(), block.packetCount(), block.channelCount);
+        });
+    }
+
+    // measuring every packet over a sweep wide window, the
+    // same cost per packet whatever the width
+    {
+        ScopeStatistics statistics;
+        statistics.reset(SCOPE_CHANNEL_COUNT, 1920);
+        const ScopeSampleBlock block = MakeScopeBlock(1 << 16);
+        runner.run("oscilloscope/statistics/1920", block.packetCount(), "packets", [&] () {
+            for (int i = 0; i < block.packetCount(); i++)
+            {
+                if (i % 8 == 0)
+                    statistics.beginColumn();
+                statistics.addPacket(block.packet(i));
+            }
+        });
+    }
+
+    // compositing the rendered strips, what is left on the GUI thread
+    for (unsigned w = 0; w < sizeof(WIDTHS)/sizeof(WIDTHS[0]); w++)
+    {
+        Oscilloscope scope;
+        scope.resize(WIDTHS[w], SCOPE_HEIGHT);
+        QImage image(scope.size(), QImage::Format_RGB32);
+        runner.run(QString("oscilloscope/paint/%1").arg(WIDTHS[w]), 1, "frames", [&] () {
+            scope.render(&image);
+        });
+    }
+}
+
+static void BenchXYOscilloscope(BenchRunner &runner)
+{
+    static const int POINT_COUNTS[] = {1000, 10000, 60000};
+    for (unsigned p = 0; p < sizeof(POINT_COUNTS)/sizeof(POINT_COUNTS[0]); p++)
+    {
+        // a dense spiral, so (nearly) every sample is its own pixel
+        ScopeSampleBlock block;
+        block.samples.resize(POINT_COUNTS[p]*block.channelCount);
+        for (int i = 0; i < POINT_COUNTS[p]; i++)
+        {
+            const double r = 0.99*std::sqrt(static_cast<double>(i)/POINT_COUNTS[p]);
+            const double a = std::sqrt(static_cast<double>(i))*3.5449; // sqrt(4*pi) spreads them evenly
+            block.samples[i*block.channelCount + 0] = r*std::cos(a);
+            block.samples[i*block.channelCount + 1] = r*std::sin(a);
+        }
+        XYOscilloscope scope;
+        scope.resize(256, 256);
+        // NOTE: a point takes 255 fades to disappear, so
+        // re-plot them before every batch of 100
+        runner.run(QString("xyoscilloscope/fade/%1").arg(POINT_COUNTS[p]), POINT_COUNTS[p], "points", [&] () {
+            QMetaObject::invokeMethod(&scope, "slot_FadeTimeout", Qt::DirectConnection);
+        }, [&] () {
+            scope.addChannelsSamples(block);
+        }, 100);
+
+        // the heatmap, counting every sample and colouring once per frame
+        XYOscilloscope density;
+        density.resize(256, 256);
+        density.setMode(XY_PLOT_DENSITY);
+        runner.run(QString("xyoscilloscope/density/%1").arg(POINT_COUNTS[p]), POINT_COUNTS[p], "points", [&] () {
+            density.addChannelsSamples(block);
+            density.frameTick();
+        });
+
+        // four plots fed from the same pass over the block
+        XYOscilloscope pairs;
+        pairs.resize(512, 512);
+        pairs.setChannelPairs(QVector<XYChannelPair>() << XYChannelPair(0, 1) << XYChannelPair(1, 0) << XYChannelPair(0, 0) << XYChannelPair(1, 1));
+        runner.run(QString("xyoscilloscope/pairs4/%1").arg(POINT_COUNTS[p]), POINT_COUNTS[p], "points", [&] () {
+            pairs.addChannelsSamples(block);
+            pairs.frameTick();
+        });
+    }
+}
+
+static void BenchSpectrum(BenchRunner &runner)
+{
+    static const int FFT_SIZES[] = {1024, 4096, 16384, 65536};
+    for (unsigned f = 0; f < sizeof(FFT_SIZES)/sizeof(FFT_SIZES[0]); f++)
+    {
+        const int size = FFT_SIZES[f];
+        FftPlan plan(size);
+        const ScopeSampleBlock block = MakeScopeBlock(size);
+        QVector<float> signal(size);
+        for (int i = 0; i < size; i++)
+            signal[i] = block.samples[i*block.channelCount];
+        const QVector<float> window(size, 1.0f);
+        QVector<float> power(plan.binCount());
+        runner.run(QString("spectrum/fft/%1").arg(size), 1, "transforms", [&] () {
+            plan.powerSpectrum(signal.constData(), window.constData(), power.data());
+        });
+    }
+
+    // every channel transformed, averaged and reduced to the view, once per frame
+    for (unsigned f = 0; f < sizeof(FFT_SIZES)/sizeof(FFT_SIZES[0]); f++)
+    {
+        SpectrumAnalyzer analyzer;
+        analyzer.setColumnCount(1920);
+        analyzer.setFftSize(FFT_SIZES[f]);
+        analyzer.setAveraging(16);
+        analyzer.setPeakHold(true);
+        analyzer.addSamples(MakeScopeBlock(FFT_SIZES[f]));
+        const ScopeSampleBlock block = MakeScopeBlock(64);
+        runner.run(QString("spectrum/compute/%1/%2ch").arg(FFT_SIZES[f]).arg(SCOPE_CHANNEL_COUNT), 1, "frames", [&] () {
+            analyzer.addSamples(block);
+            analyzer.compute();
+        });
+    }
+}
+
+static void BenchCsv(BenchRunner &runner)
+{
+    static const int PACKET_COUNTS[] = {1, 64, 4096};
+    for (unsigned p = 0; p < sizeof(PACKET_COUNTS)/sizeof(PACKET_COUNTS[0]); p++)
+    {
+        const ScopeSampleBlock block = MakeScopeBlock(PACKET_COUNTS[p]);
+        QByteArray lines;
+        runner.run(QString("csv/format/%1").arg(PACKET_COUNTS[p]), PACKET_COUNTS[p], "packets", [&] () {
+            lines.resize(0);
+            AppendScopeCsvLines(lines, block);
+        });
+    }
+}
+
+static void BenchRecording(BenchRunner &runner)
+{
+    QTemporaryDir dir;
+    const QString filePath = dir.filePath(QString("bench.") + RECORDING_FILE_SUFFIX);
+    static const int PACKET_COUNTS[] = {64, 4096};
+    for (unsigned p = 0; p < sizeof(PACKET_COUNTS)/sizeof(PACKET_COUNTS[0]); p++)
+    {
+        // NOTE: a fresh file every batch, so the disk doesn't fill up
+        const ScopeSampleBlock block = MakeScopeBlock(PACKET_COUNTS[p]);
+        ScopeRecordingWriter writer;
+        runner.run(QString("recording/write/%1").arg(PACKET_COUNTS[p]), PACKET_COUNTS[p], "packets", [&] () {
+            writer.append(block);
+        }, [&] () {
+            writer.close();
+            QFile::remove(filePath);
+            writer.open(filePath);
+        }, 256);
+        writer.close();
+    }
+
+    // reading a screenful of packets from anywhere in a long recording
+    {
+        const ScopeSampleBlock block = MakeScopeBlock(4096);
+        ScopeRecordingWriter writer;
+        QFile::remove(filePath);
+        writer.open(filePath);
+        for (int i = 0; i < 1024; i++)
+            writer.append(block);
+        writer.close();
+    }
+    ScopeRecordingReader reader;
+    reader.open(filePath);
+    QVector<float> samples(1920*reader.channelCount());
+    quint64 first = 0;
+    runner.run("recording/read/1920", 1920, "packets", [&] () {
+        first = (first + 1234567) % (reader.packetCount() - 1920);
+        reader.readPackets(first, 1920, samples.data());
+    });
+}
+
+static void BenchConfigCRC(BenchRunner &runner)
+{
+    static const int CONFIG_SIZES[] = {4*1024, 64*1024, 1024*1024};
+    for (unsigned s = 0; s < sizeof(CONFIG_SIZES)/sizeof(CONFIG_SIZES[0]); s++)
+    {
+        QByteArray config;
+        for (int i = 0; config.size() < CONFIG_SIZES[s]; i++)
+            config.append("conf0.param" + QByteArray::number(i) + " = " + QByteArray::number(i*0.125, 'f', 3) + "\n");
+        config.truncate(CONFIG_SIZES[s]);
+        quint32 crc = 0;
+        runner.run(QString("configcrc/%1").arg(CONFIG_SIZES[s]), config.size(), "bytes", [&] () {
+            crc ^= CalculateConfigCRC(config);
+        });
+    }
+}
+
+static void BenchAppendText(BenchRunner &runner)
+{
+    // a chunk like the drive produces while printing, roughly 4 KiB
+    QString chunk;
+    for (int i = 0; chunk.size() < 4000; i++)
+        chunk += QString("pos_cmd = %1 vel = %2\n").arg(i*0.5).arg(i*0.25);
+
+    QPlainTextEdit plainEdit;
+    runner.run("appendtext/plain", chunk.size(), "chars", [&] () {
+        AppendTextToEdit(plainEdit, &QPlainTextEdit::insertPlainText, chunk);
+    }, [&] () {
+        plainEdit.clear();
+    }, 16);
+
+    QTextEdit htmlEdit; // how the console log used to take drive output
+    runner.run("appendtext/html", chunk.size(), "chars", [&] () {
+        AppendTextToEdit(htmlEdit, &QTextEdit::insertHtml, chunk);
+    }, [&] () {
+        htmlEdit.clear();
+    }, 16);
+
+    QTextEdit logEdit; // like the console log in MainWindow
+    runner.run("appendtext/lines", chunk.size(), "chars", [&] () {
+        AppendPlainTextToEdit(logEdit, chunk);
+    }, [&] () {
+        logEdit.clear();
+    }, 16);
+
+    // cutting the lines out of what trickles in over the link
+    const QByteArray bytes = chunk.toLatin1();
+    TextLineAssembler assembler;
+    QString lines;
+    runner.run("textlines/assemble", bytes.size(), "bytes", [&] () {
+        for (int offset = 0; offset < bytes.size(); offset += 64)
+        {
+            assembler.append(bytes.constData() + offset, qMin(64, bytes.size() - offset));
+            assembler.takeLines(lines);
+        }
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    // NOTE: the widgets are only rendered off-screen, so don't require a display
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Servoterm hot path micro-benchmarks.");
+    parser.addHelpOption();
+    const QCommandLineOption jsonOption("json", "Write the results to <file> instead of stdout.", "file");
+    const QCommandLineOption filterOption("filter", "Only run the benchmarks whose name contains <substring>.", "substring");
+    const QCommandLineOption minimumTimeOption("min-time", "Minimum time spent measuring each benchmark.", "ms", "300");
+    parser.addOption(jsonOption);
+    parser.addOption(filterOption);
+    parser.addOption(minimumTimeOption);
+    parser.process(app);
+
+    BenchRunner runner(qMax(1, parser.value(minimumTimeOption).toInt()), parser.value(filterOption));
+    BenchDemux(runner);
+    BenchOscilloscope(runner);
+    BenchXYOscilloscope(runner);
+    BenchSpectrum(runner);
+    BenchCsv(runner);
+    BenchRecording(runner);
+    BenchConfigCRC(runner);
+    BenchAppendText(runner);
+
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    context["qt_version"] = QString(qVersion());
+    context["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    context["os"] = QSysInfo::prettyProductName();
+    context["scanner_isa"] = QString(ScopeScanIsaName(ScopeScanCurrentIsa()));
+    context["min_time_ms"] = parser.value(minimumTimeOption).toInt();
+#ifdef QT_NO_DEBUG
+    context["build"] = QString("release");
+#else
+    context["build"] = QString("debug");
+#endif
+    QJsonObject root;
+    root["context"] = context;
+    root["benchmarks"] = runner.results();
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(jsonOption))
+    {
+        QFile file(parser.value(jsonOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            QTextStream(stderr) << "couldn't write \"" << file.fileName() << "\": " << file.errorString() << '\n';
+            return 1;
+        }
+    }
+    else
+    {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        out.write(json);
+    }
+    return 0;
+}
@@ -6,24 +6,68 @@ src/AppendTextToEdit.h \
 src/Actions.h \
 src/MenuBar.h \
 src/ClickableComboBox.h \
+src/ConfigChecksum.h \
 src/ConfigDialog.h \
+src/FrameClock.h \
 src/Oscilloscope.h \
+src/OscilloscopeRenderer.h \
+src/ScopeHistory.h \
+src/ScopeTrigger.h \
+src/ScopeStatistics.h \
+src/ScopeMeasurements.h \
+src/TriggerToolBar.h \
 src/XYOscilloscope.h \
+src/FftPlan.h \
+src/SpectrumAnalyzer.h \
+src/SpectrumView.h \
 src/HistoryLineEdit.h \
+src/CaptureFile.h \
+src/DriveSimulator.h \
+src/SpscRing.h \
+src/ScopeClock.h \
+src/SerialIngestWorker.h \
 src/SerialConnection.h \
+src/ScopeSampleBlock.h \
+src/ScopeDataScanner.h \
 src/ScopeDataDemux.h \
+src/ScopeCsv.h \
+src/ScopeRecording.h \
+src/RecordingWorker.h \
+src/ScopeRecorder.h \
+src/TextLineAssembler.h \
 src/MainWindow.h
 
 SOURCES = \
 src/Actions.cpp \
 src/MenuBar.cpp \
 src/ClickableComboBox.cpp \
+src/ConfigChecksum.cpp \
 src/ConfigDialog.cpp \
+src/FrameClock.cpp \
 src/Oscilloscope.cpp \
+src/OscilloscopeRenderer.cpp \
+src/ScopeHistory.cpp \
+src/ScopeTrigger.cpp \
+src/ScopeStatistics.cpp \
+src/ScopeMeasurements.cpp \
+src/TriggerToolBar.cpp \
 src/XYOscilloscope.cpp \
+src/FftPlan.cpp \
+src/SpectrumAnalyzer.cpp \
+src/SpectrumView.cpp \
 src/HistoryLineEdit.cpp \
+src/CaptureFile.cpp \
+src/DriveSimulator.cpp \
+src/ScopeClock.cpp \
+src/SerialIngestWorker.cpp \
 src/SerialConnection.cpp \
+src/ScopeDataScanner.cpp \
 src/ScopeDataDemux.cpp \
+src/ScopeCsv.cpp \
+src/ScopeRecording.cpp \
+src/RecordingWorker.cpp \
+src/ScopeRecorder.cpp \
+src/TextLineAssembler.cpp \
 src/MainWindow.cpp \
 src/main.cpp
 
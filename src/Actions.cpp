@@ -18,6 +18,10 @@
 */
 
 #include "Actions.h"
+#include "globals.h"
+#include "SpectrumAnalyzer.h"
+#include "XYOscilloscope.h"
+#include "ScopeRecording.h"
 
 namespace STMBL_Servoterm {
 
@@ -26,22 +30,260 @@ Actions::Actions(QObject *parent) : QObject(parent)
     fileQuit = new QAction("&Quit", this);
     connectionConnect = new QAction("Connect", this);
     connectionDisconnect = new QAction("Disconnect", this);
+    connectionOpenCapture = new QAction("Open Capture for Replay...", this);
+    connectionReplaySpeedRealTime = new QAction("Real Time", this);
+    connectionReplaySpeed2x = new QAction("2x", this);
+    connectionReplaySpeed10x = new QAction("10x", this);
+    connectionReplaySpeedUnlimited = new QAction("As Fast As Possible", this);
+    connectionReplaySpeedGroup = new QActionGroup(this);
     driveEnable = new QAction("Enable", this);
     driveDisable = new QAction("Disable", this);
     driveJogEnable = new QAction("Jog", this);
     driveEditConfig = new QAction("Config", this);
     dataRecord = new QAction("Record", this);
+    dataCapture = new QAction("Capture Raw Stream", this);
+    dataRecordFormatNative = new QAction("Servoterm Recording", this);
+    dataRecordFormatCsv = new QAction("CSV", this);
+    dataRecordFormatGroup = new QActionGroup(this);
+    dataConvertRecording = new QAction("Convert Recording to CSV...", this);
+    dataChannelsAuto = new QAction("Detect Automatically", this);
+    dataChannels4 = new QAction("4", this);
+    dataChannels8 = new QAction("8", this);
+    dataChannels16 = new QAction("16", this);
+    dataChannelsGroup = new QActionGroup(this);
+    dataHistory64 = new QAction("64 MB", this);
+    dataHistory256 = new QAction("256 MB", this);
+    dataHistory1024 = new QAction("1 GB", this);
+    dataHistoryGroup = new QActionGroup(this);
     dataSetDirectory = new QAction("Set Directory...", this);
     dataOpenDirectory = new QAction("Open Directory (in File Manager)", this);
     viewOscilloscope = new QAction("Show Oscilloscope", this);
     viewXYScope = new QAction("Show X/Y Scope", this);
+    viewSpectrum = new QAction("Show Spectrum", this);
+    viewMeasurements = new QAction("Show Measurements", this);
     viewConsole = new QAction("Show Console Output", this); // TODO change this to "Show Console"
+    viewPauseOscilloscope = new QAction("Pause Oscilloscope", this);
+    viewAutoscaleOscilloscope = new QAction("Autoscale Oscilloscope", this);
+    viewTimebase1 = new QAction("1 Packet per Pixel", this);
+    viewTimebase10 = new QAction("10 Packets per Pixel", this);
+    viewTimebase100 = new QAction("100 Packets per Pixel", this);
+    viewTimebase1000 = new QAction("1000 Packets per Pixel", this);
+    viewTimebaseGroup = new QActionGroup(this);
+    viewFrameRateDisplay = new QAction("Display Refresh Rate", this);
+    viewFrameRate30 = new QAction("30 fps", this);
+    viewFrameRate60 = new QAction("60 fps", this);
+    viewFrameRate120 = new QAction("120 fps", this);
+    viewFrameRateGroup = new QActionGroup(this);
+    viewSpectrumSize1024 = new QAction("1024 Points", this);
+    viewSpectrumSize4096 = new QAction("4096 Points", this);
+    viewSpectrumSize16384 = new QAction("16384 Points", this);
+    viewSpectrumSize65536 = new QAction("65536 Points", this);
+    viewSpectrumSizeGroup = new QActionGroup(this);
+    viewSpectrumWindowHann = new QAction("Hann", this);
+    viewSpectrumWindowFlatTop = new QAction("Flat Top", this);
+    viewSpectrumWindowGroup = new QActionGroup(this);
+    viewSpectrumAveragingOff = new QAction("Off", this);
+    viewSpectrumAveraging4 = new QAction("4 Spectra", this);
+    viewSpectrumAveraging16 = new QAction("16 Spectra", this);
+    viewSpectrumAveraging64 = new QAction("64 Spectra", this);
+    viewSpectrumAveragingGroup = new QActionGroup(this);
+    viewSpectrumPeakHold = new QAction("Peak Hold", this);
+    viewSpectrumResetPeaks = new QAction("Reset Peaks", this);
+    for (int channel = 0; channel < SCOPE_MAXIMUM_CHANNEL_COUNT; channel++)
+        viewSpectrumChannels.append(new QAction(QString("Channel %1").arg(channel + 1), this));
+    viewXYModePersistence = new QAction("Persistence", this);
+    viewXYModeDensity = new QAction("Density", this);
+    viewXYModeGroup = new QActionGroup(this);
+    viewXYDensityLog = new QAction("Logarithmic", this);
+    viewXYDensityGamma = new QAction("Gamma", this);
+    viewXYDensityMappingGroup = new QActionGroup(this);
+    viewXYDensityDecayOff = new QAction("Off", this);
+    viewXYDensityDecaySlow = new QAction("Slow", this);
+    viewXYDensityDecayFast = new QAction("Fast", this);
+    viewXYDensityDecayGroup = new QActionGroup(this);
+    viewXYChannelPairs = new QAction("Channel Pairs...", this);
     viewClearConsole = new QAction("Clear", this); // TODO change this to "Clear Console"?
     driveJogEnable->setCheckable(true);
     dataRecord->setCheckable(true);
+    dataCapture->setCheckable(true);
     viewOscilloscope->setCheckable(true);
     viewXYScope->setCheckable(true);
+    viewSpectrum->setCheckable(true);
+    viewMeasurements->setCheckable(true);
     viewConsole->setCheckable(true);
+    viewPauseOscilloscope->setCheckable(true);
+    viewPauseOscilloscope->setShortcut(QKeySequence("Pause"));
+    viewAutoscaleOscilloscope->setCheckable(true);
+
+    // the replay speed factor, where 0 means unlimited
+    connectionReplaySpeedRealTime->setData(1.0);
+    connectionReplaySpeed2x->setData(2.0);
+    connectionReplaySpeed10x->setData(10.0);
+    connectionReplaySpeedUnlimited->setData(0.0);
+    connectionReplaySpeedGroup->setExclusive(true);
+    connectionReplaySpeedGroup->addAction(connectionReplaySpeedRealTime);
+    connectionReplaySpeedGroup->addAction(connectionReplaySpeed2x);
+    connectionReplaySpeedGroup->addAction(connectionReplaySpeed10x);
+    connectionReplaySpeedGroup->addAction(connectionReplaySpeedUnlimited);
+    connectionReplaySpeedRealTime->setCheckable(true);
+    connectionReplaySpeed2x->setCheckable(true);
+    connectionReplaySpeed10x->setCheckable(true);
+    connectionReplaySpeedUnlimited->setCheckable(true);
+    connectionReplaySpeedRealTime->setChecked(true);
+
+    // what the recordings are written as, one of RecordingFormat
+    dataRecordFormatNative->setData(RECORDING_FORMAT_NATIVE);
+    dataRecordFormatCsv->setData(RECORDING_FORMAT_CSV);
+    dataRecordFormatGroup->setExclusive(true);
+    dataRecordFormatGroup->addAction(dataRecordFormatNative);
+    dataRecordFormatGroup->addAction(dataRecordFormatCsv);
+    dataRecordFormatNative->setCheckable(true);
+    dataRecordFormatCsv->setCheckable(true);
+    dataRecordFormatNative->setChecked(true);
+
+    // the scope channel count, where 0 means detecting it
+    dataChannelsAuto->setData(0);
+    dataChannels4->setData(4);
+    dataChannels8->setData(8);
+    dataChannels16->setData(16);
+    dataChannelsGroup->setExclusive(true);
+    dataChannelsGroup->addAction(dataChannelsAuto);
+    dataChannelsGroup->addAction(dataChannels4);
+    dataChannelsGroup->addAction(dataChannels8);
+    dataChannelsGroup->addAction(dataChannels16);
+    dataChannelsAuto->setCheckable(true);
+    dataChannels4->setCheckable(true);
+    dataChannels8->setCheckable(true);
+    dataChannels16->setCheckable(true);
+    dataChannelsAuto->setChecked(true);
+
+    // the oscilloscope's history memory budget, in megabytes
+    dataHistory64->setData(64);
+    dataHistory256->setData(256);
+    dataHistory1024->setData(1024);
+    dataHistoryGroup->setExclusive(true);
+    dataHistoryGroup->addAction(dataHistory64);
+    dataHistoryGroup->addAction(dataHistory256);
+    dataHistoryGroup->addAction(dataHistory1024);
+    dataHistory64->setCheckable(true);
+    dataHistory256->setCheckable(true);
+    dataHistory1024->setCheckable(true);
+    dataHistory64->setChecked(true);
+
+    // the oscilloscope's packets per pixel column
+    viewTimebase1->setData(1);
+    viewTimebase10->setData(10);
+    viewTimebase100->setData(100);
+    viewTimebase1000->setData(1000);
+    viewTimebaseGroup->setExclusive(true);
+    viewTimebaseGroup->addAction(viewTimebase1);
+    viewTimebaseGroup->addAction(viewTimebase10);
+    viewTimebaseGroup->addAction(viewTimebase100);
+    viewTimebaseGroup->addAction(viewTimebase1000);
+    viewTimebase1->setCheckable(true);
+    viewTimebase10->setCheckable(true);
+    viewTimebase100->setCheckable(true);
+    viewTimebase1000->setCheckable(true);
+    viewTimebase1->setChecked(true);
+
+    // the scope views' frame rate cap, where 0 means the display's refresh rate
+    viewFrameRateDisplay->setData(0);
+    viewFrameRate30->setData(30);
+    viewFrameRate60->setData(60);
+    viewFrameRate120->setData(120);
+    viewFrameRateGroup->setExclusive(true);
+    viewFrameRateGroup->addAction(viewFrameRateDisplay);
+    viewFrameRateGroup->addAction(viewFrameRate30);
+    viewFrameRateGroup->addAction(viewFrameRate60);
+    viewFrameRateGroup->addAction(viewFrameRate120);
+    viewFrameRateDisplay->setCheckable(true);
+    viewFrameRate30->setCheckable(true);
+    viewFrameRate60->setCheckable(true);
+    viewFrameRate120->setCheckable(true);
+    viewFrameRateDisplay->setChecked(true);
+
+    // the spectrum's FFT length
+    viewSpectrumSize1024->setData(1024);
+    viewSpectrumSize4096->setData(4096);
+    viewSpectrumSize16384->setData(16384);
+    viewSpectrumSize65536->setData(65536);
+    viewSpectrumSizeGroup->setExclusive(true);
+    viewSpectrumSizeGroup->addAction(viewSpectrumSize1024);
+    viewSpectrumSizeGroup->addAction(viewSpectrumSize4096);
+    viewSpectrumSizeGroup->addAction(viewSpectrumSize16384);
+    viewSpectrumSizeGroup->addAction(viewSpectrumSize65536);
+    viewSpectrumSize1024->setCheckable(true);
+    viewSpectrumSize4096->setCheckable(true);
+    viewSpectrumSize16384->setCheckable(true);
+    viewSpectrumSize65536->setCheckable(true);
+    viewSpectrumSize4096->setChecked(true);
+
+    // the spectrum's window function, one of SpectrumWindow
+    viewSpectrumWindowHann->setData(SPECTRUM_WINDOW_HANN);
+    viewSpectrumWindowFlatTop->setData(SPECTRUM_WINDOW_FLAT_TOP);
+    viewSpectrumWindowGroup->setExclusive(true);
+    viewSpectrumWindowGroup->addAction(viewSpectrumWindowHann);
+    viewSpectrumWindowGroup->addAction(viewSpectrumWindowFlatTop);
+    viewSpectrumWindowHann->setCheckable(true);
+    viewSpectrumWindowFlatTop->setCheckable(true);
+    viewSpectrumWindowHann->setChecked(true);
+
+    // how many spectra are averaged, where 1 means none
+    viewSpectrumAveragingOff->setData(1);
+    viewSpectrumAveraging4->setData(4);
+    viewSpectrumAveraging16->setData(16);
+    viewSpectrumAveraging64->setData(64);
+    viewSpectrumAveragingGroup->setExclusive(true);
+    viewSpectrumAveragingGroup->addAction(viewSpectrumAveragingOff);
+    viewSpectrumAveragingGroup->addAction(viewSpectrumAveraging4);
+    viewSpectrumAveragingGroup->addAction(viewSpectrumAveraging16);
+    viewSpectrumAveragingGroup->addAction(viewSpectrumAveraging64);
+    viewSpectrumAveragingOff->setCheckable(true);
+    viewSpectrumAveraging4->setCheckable(true);
+    viewSpectrumAveraging16->setCheckable(true);
+    viewSpectrumAveraging64->setCheckable(true);
+    viewSpectrumAveragingOff->setChecked(true);
+
+    viewSpectrumPeakHold->setCheckable(true);
+    for (int channel = 0; channel < SCOPE_MAXIMUM_CHANNEL_COUNT; channel++)
+    {
+        viewSpectrumChannels[channel]->setCheckable(true);
+        viewSpectrumChannels[channel]->setChecked(channel == 0);
+        viewSpectrumChannels[channel]->setEnabled(channel < SCOPE_CHANNEL_COUNT);
+    }
+
+    // the X/Y scope's plot, one of XYPlotMode
+    viewXYModePersistence->setData(XY_PLOT_PERSISTENCE);
+    viewXYModeDensity->setData(XY_PLOT_DENSITY);
+    viewXYModeGroup->setExclusive(true);
+    viewXYModeGroup->addAction(viewXYModePersistence);
+    viewXYModeGroup->addAction(viewXYModeDensity);
+    viewXYModePersistence->setCheckable(true);
+    viewXYModeDensity->setCheckable(true);
+    viewXYModePersistence->setChecked(true);
+
+    // how the hit counts map to colours, one of XYDensityMapping
+    viewXYDensityLog->setData(XY_DENSITY_LOG);
+    viewXYDensityGamma->setData(XY_DENSITY_GAMMA);
+    viewXYDensityMappingGroup->setExclusive(true);
+    viewXYDensityMappingGroup->addAction(viewXYDensityLog);
+    viewXYDensityMappingGroup->addAction(viewXYDensityGamma);
+    viewXYDensityLog->setCheckable(true);
+    viewXYDensityGamma->setCheckable(true);
+    viewXYDensityLog->setChecked(true);
+
+    // the half life of the hit counts in milliseconds, where 0 means they're kept
+    viewXYDensityDecayOff->setData(0);
+    viewXYDensityDecaySlow->setData(2000);
+    viewXYDensityDecayFast->setData(250);
+    viewXYDensityDecayGroup->setExclusive(true);
+    viewXYDensityDecayGroup->addAction(viewXYDensityDecayOff);
+    viewXYDensityDecayGroup->addAction(viewXYDensityDecaySlow);
+    viewXYDensityDecayGroup->addAction(viewXYDensityDecayFast);
+    viewXYDensityDecayOff->setCheckable(true);
+    viewXYDensityDecaySlow->setCheckable(true);
+    viewXYDensityDecayFast->setCheckable(true);
+    viewXYDensityDecaySlow->setChecked(true);
 }
 
 } // namespace STMBL_Servoterm
@@ -23,6 +23,7 @@
 #include <QObject>
 #include <QAction>
 #include <QActionGroup>
+#include <QList>
 
 namespace STMBL_Servoterm {
 
@@ -35,16 +36,77 @@ public:
     QAction *fileQuit;
     QAction *connectionConnect;
     QAction *connectionDisconnect;
+    QAction *connectionOpenCapture;
+    QAction *connectionReplaySpeedRealTime;
+    QAction *connectionReplaySpeed2x;
+    QAction *connectionReplaySpeed10x;
+    QAction *connectionReplaySpeedUnlimited;
+    QActionGroup *connectionReplaySpeedGroup;
     QAction *driveEnable;
     QAction *driveDisable;
     QAction *driveJogEnable;
     QAction *driveEditConfig;
     QAction *dataRecord;
+    QAction *dataCapture;
+    QAction *dataRecordFormatNative;
+    QAction *dataRecordFormatCsv;
+    QActionGroup *dataRecordFormatGroup;
+    QAction *dataConvertRecording;
+    QAction *dataChannelsAuto;
+    QAction *dataChannels4;
+    QAction *dataChannels8;
+    QAction *dataChannels16;
+    QActionGroup *dataChannelsGroup;
+    QAction *dataHistory64;
+    QAction *dataHistory256;
+    QAction *dataHistory1024;
+    QActionGroup *dataHistoryGroup;
     QAction *dataSetDirectory;
     QAction *dataOpenDirectory;
     QAction *viewOscilloscope;
     QAction *viewXYScope;
+    QAction *viewSpectrum;
+    QAction *viewMeasurements;
     QAction *viewConsole;
+    QAction *viewPauseOscilloscope;
+    QAction *viewAutoscaleOscilloscope;
+    QAction *viewTimebase1;
+    QAction *viewTimebase10;
+    QAction *viewTimebase100;
+    QAction *viewTimebase1000;
+    QActionGroup *viewTimebaseGroup;
+    QAction *viewFrameRateDisplay;
+    QAction *viewFrameRate30;
+    QAction *viewFrameRate60;
+    QAction *viewFrameRate120;
+    QActionGroup *viewFrameRateGroup;
+    QAction *viewSpectrumSize1024;
+    QAction *viewSpectrumSize4096;
+    QAction *viewSpectrumSize16384;
+    QAction *viewSpectrumSize65536;
+    QActionGroup *viewSpectrumSizeGroup;
+    QAction *viewSpectrumWindowHann;
+    QAction *viewSpectrumWindowFlatTop;
+    QActionGroup *viewSpectrumWindowGroup;
+    QAction *viewSpectrumAveragingOff;
+    QAction *viewSpectrumAveraging4;
+    QAction *viewSpectrumAveraging16;
+    QAction *viewSpectrumAveraging64;
+    QActionGroup *viewSpectrumAveragingGroup;
+    QAction *viewSpectrumPeakHold;
+    QAction *viewSpectrumResetPeaks;
+    QList<QAction*> viewSpectrumChannels; // NOTE: SCOPE_MAXIMUM_CHANNEL_COUNT of them
+    QAction *viewXYModePersistence;
+    QAction *viewXYModeDensity;
+    QActionGroup *viewXYModeGroup;
+    QAction *viewXYDensityLog;
+    QAction *viewXYDensityGamma;
+    QActionGroup *viewXYDensityMappingGroup;
+    QAction *viewXYDensityDecayOff;
+    QAction *viewXYDensityDecaySlow;
+    QAction *viewXYDensityDecayFast;
+    QActionGroup *viewXYDensityDecayGroup;
+    QAction *viewXYChannelPairs;
     QAction *viewClearConsole;
 };
 
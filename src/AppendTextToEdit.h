@@ -22,6 +22,7 @@
 
 #include <QStringList>
 #include <QTextCursor>
+#include <QTextCharFormat>
 
 namespace STMBL_Servoterm {
 
@@ -57,6 +58,19 @@ static void AppendTextToEdit(T &target, M insertMethod, const QString &txt)
     }
 }
 
+// appends plain text (never interpreted as HTML) in a single edit, in
+// the document's default format rather than whatever was inserted last
+template<typename T>
+static void AppendPlainTextToEdit(T &target, const QString &txt)
+{
+    if (txt.isEmpty())
+        return;
+    target.moveCursor(QTextCursor::End);
+    QTextCursor cursor = target.textCursor();
+    cursor.insertText(txt, QTextCharFormat());
+    target.ensureCursorVisible();
+}
+
 } // namespace STMBL_Servoterm
 
 #endif // QTSERVOTERM_APPENDTEXTTOEDIT_H
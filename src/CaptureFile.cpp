@@ -0,0 +1,255 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CaptureFile.h"
+
+#include <QThread>
+
+namespace STMBL_Servoterm {
+
+static const char CAPTURE_MAGIC[] = "STMBLCAP";
+static const int CAPTURE_MAGIC_LENGTH = 8;
+static const char CAPTURE_VERSION = 1;
+static const int CAPTURE_FLUSH_SIZE = 256*1024; // keep the writes few and large
+static const qint64 CAPTURE_MAXIMUM_QUEUED_BYTES = 64*1024*1024; // how far the disk may fall behind
+static const quint64 CAPTURE_MAXIMUM_CHUNK_SIZE = 64*1024*1024; // anything bigger means the file is damaged
+
+static void AppendVarint(QByteArray &buffer, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        buffer.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.append(static_cast<char>(value));
+}
+
+CaptureFileWorker::CaptureFileWorker(std::atomic<qint64> *queuedBytes, QObject *parent) :
+    QObject(parent),
+    _queuedBytes(queuedBytes),
+    _file(nullptr)
+{
+}
+
+CaptureFileWorker::~CaptureFileWorker()
+{
+    setFile(nullptr);
+}
+
+void CaptureFileWorker::setFile(QFile *file)
+{
+    if (_file)
+    {
+        _file->close();
+        delete _file;
+    }
+    _file = file;
+}
+
+void CaptureFileWorker::write(const QByteArray &buffer)
+{
+    if (_file)
+        _file->write(buffer);
+    _queuedBytes->fetch_sub(buffer.size(), std::memory_order_relaxed);
+}
+
+void CaptureFileWorker::finish()
+{
+    setFile(nullptr);
+    thread()->quit();
+}
+
+CaptureWriter::CaptureWriter() :
+    _queuedBytes(0),
+    _writerThread(new QThread),
+    _worker(new CaptureFileWorker(&_queuedBytes)),
+    _open(false),
+    _lastTimestampUs(0),
+    _queuedTimestampUs(0),
+    _droppedBytes(0)
+{
+    qRegisterMetaType<QFile *>("QFile*");
+    _writerThread->setObjectName("CaptureWriter");
+    _worker->moveToThread(_writerThread);
+    _writerThread->start();
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+    // NOTE: queued behind the writes, so none of them are lost
+    QMetaObject::invokeMethod(_worker, "finish");
+    _writerThread->wait();
+    delete _worker; // NOTE: safe now that its thread is gone
+    delete _writerThread;
+}
+
+bool CaptureWriter::open(const QString &filePath)
+{
+    close();
+    QFile * const file = new QFile(filePath);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    if (!file->open(QIODevice::WriteOnly | QIODevice::NewOnly))
+#else
+    if (file->exists() || !file->open(QIODevice::WriteOnly))
+#endif
+    {
+        delete file;
+        return false;
+    }
+    file->moveToThread(_writerThread);
+    QMetaObject::invokeMethod(_worker, "setFile", Q_ARG(QFile *, file));
+    _open = true;
+    _fileName = filePath;
+    _droppedBytes = 0;
+    // NOTE: the header goes on its own, so it is never dropped
+    QByteArray header(CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH);
+    header.append(CAPTURE_VERSION);
+    _Queue(header);
+    _buffer.reserve(CAPTURE_FLUSH_SIZE + 1024);
+    _lastTimestampUs = 0;
+    _queuedTimestampUs = 0;
+    return true;
+}
+
+bool CaptureWriter::isOpen() const
+{
+    return _open;
+}
+
+QString CaptureWriter::fileName() const
+{
+    return _fileName;
+}
+
+void CaptureWriter::append(qint64 timestampUs, const QByteArray &data)
+{
+    if (!_open)
+        return;
+    AppendVarint(_buffer, static_cast<quint64>(qMax<qint64>(0, timestampUs - _lastTimestampUs)));
+    AppendVarint(_buffer, static_cast<quint64>(data.size()));
+    _buffer.append(data);
+    _lastTimestampUs = qMax(_lastTimestampUs, timestampUs);
+    if (_buffer.size() >= CAPTURE_FLUSH_SIZE)
+        _Flush();
+}
+
+void CaptureWriter::close()
+{
+    if (!_open)
+        return;
+    _Flush();
+    QMetaObject::invokeMethod(_worker, "setFile", Q_ARG(QFile *, nullptr));
+    _open = false;
+}
+
+quint64 CaptureWriter::droppedBytes() const
+{
+    return _droppedBytes;
+}
+
+void CaptureWriter::_Queue(const QByteArray &buffer)
+{
+    _queuedBytes.fetch_add(buffer.size(), std::memory_order_relaxed);
+    QMetaObject::invokeMethod(_worker, "write", Q_ARG(QByteArray, buffer));
+}
+
+void CaptureWriter::_Flush()
+{
+    if (_buffer.isEmpty())
+        return;
+    if (_queuedBytes.load(std::memory_order_relaxed) + _buffer.size() > CAPTURE_MAXIMUM_QUEUED_BYTES)
+    {
+        // the disk is that far behind, lose these records rather than
+        // stall; the next one is timed from the last one that made it
+        _droppedBytes += _buffer.size();
+        _lastTimestampUs = _queuedTimestampUs;
+        _buffer.resize(0);
+        return;
+    }
+    _Queue(_buffer);
+    _queuedTimestampUs = _lastTimestampUs;
+    // NOTE: a fresh one, the queued copy still shares the old data
+    _buffer = QByteArray();
+    _buffer.reserve(CAPTURE_FLUSH_SIZE + 1024);
+}
+
+CaptureReader::CaptureReader() : _timestampUs(0)
+{
+}
+
+bool CaptureReader::open(const QString &filePath)
+{
+    close();
+    _file.setFileName(filePath);
+    if (!_file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray header = _file.read(CAPTURE_MAGIC_LENGTH + 1);
+    if (header.size() != CAPTURE_MAGIC_LENGTH + 1
+     || !header.startsWith(QByteArray(CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH))
+     || header.at(CAPTURE_MAGIC_LENGTH) != CAPTURE_VERSION)
+    {
+        _file.close();
+        return false;
+    }
+    _timestampUs = 0;
+    return true;
+}
+
+bool CaptureReader::isOpen() const
+{
+    return _file.isOpen();
+}
+
+void CaptureReader::close()
+{
+    if (_file.isOpen())
+        _file.close();
+}
+
+bool CaptureReader::readNext(qint64 &timestampUs, QByteArray &data)
+{
+    quint64 delta = 0;
+    quint64 length = 0;
+    if (!_ReadVarint(delta) || !_ReadVarint(length) || length > CAPTURE_MAXIMUM_CHUNK_SIZE)
+        return false;
+    data = _file.read(static_cast<qint64>(length));
+    if (static_cast<quint64>(data.size()) != length)
+        return false;
+    _timestampUs += static_cast<qint64>(delta);
+    timestampUs = _timestampUs;
+    return true;
+}
+
+bool CaptureReader::_ReadVarint(quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        char c;
+        if (!_file.getChar(&c))
+            return false;
+        value |= static_cast<quint64>(static_cast<quint8>(c) & 0x7F) << shift;
+        if ((static_cast<quint8>(c) & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,112 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_CAPTUREFILE_H
+#define STMBL_SERVOTERM_CAPTUREFILE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// raw capture of the received byte stream, for replaying sessions later
+//
+// file layout:
+//     "STMBLCAP" magic, one version byte
+//     then one record per received chunk:
+//         varint microseconds since the previous chunk (the first one since the capture started)
+//         varint chunk length in bytes
+//         the chunk bytes
+// where varint is the usual little-endian base 128 encoding
+
+static const char CAPTURE_FILE_SUFFIX[] = "stmblcap";
+
+// writes the buffers of a CaptureWriter on a thread of its own
+class CaptureFileWorker : public QObject
+{
+    Q_OBJECT
+public:
+    CaptureFileWorker(std::atomic<qint64> *queuedBytes, QObject *parent = nullptr);
+    ~CaptureFileWorker();
+public slots:
+    void setFile(QFile *file); // takes it over, closing the previous one, NOTE: nullptr just closes
+    void write(const QByteArray &buffer);
+    void finish(); // closes the file and stops the thread
+protected:
+    std::atomic<qint64> *_queuedBytes;
+    QFile *_file;
+};
+
+// NOTE: only opening the file happens on the calling thread, the writes
+//       are queued for a CaptureFileWorker, so a slow disk never stalls
+//       the serial reads; once more than a bounded amount is waiting to
+//       be written, whole buffers are dropped (see droppedBytes())
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter(); // NOTE: waits for everything queued to be written
+    bool open(const QString &filePath);
+    bool isOpen() const;
+    QString fileName() const;
+    void append(qint64 timestampUs, const QByteArray &data);
+    void close();
+    quint64 droppedBytes() const; // since opening
+protected:
+    void _Queue(const QByteArray &buffer);
+    void _Flush();
+
+    std::atomic<qint64> _queuedBytes; // handed to the worker, not written yet
+    QThread *_writerThread;
+    CaptureFileWorker *_worker;
+    bool _open;
+    QString _fileName;
+    QByteArray _buffer;
+    qint64 _lastTimestampUs;
+    qint64 _queuedTimestampUs; // of the last record handed to the worker
+    quint64 _droppedBytes;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader();
+    bool open(const QString &filePath);
+    bool isOpen() const;
+    void close();
+    // returns false at the end of the file (or if it is damaged)
+    bool readNext(qint64 &timestampUs, QByteArray &data);
+protected:
+    bool _ReadVarint(quint64 &value);
+
+    QFile _file;
+    qint64 _timestampUs;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_CAPTUREFILE_H
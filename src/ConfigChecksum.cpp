@@ -0,0 +1,55 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ConfigChecksum.h"
+
+#include <QDataStream>
+
+namespace STMBL_Servoterm {
+
+quint32 CalculateConfigCRC(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    quint32 crc = 0xffffffff;
+    while (true)
+    {
+        quint32 value = 0;
+        stream >> value;
+        if (stream.status() != QDataStream::Ok)
+            break;
+        crc ^= value;
+        for (int j = 0; j < 32; j++)
+        {
+            if (crc & 0x80000000)
+               crc = (crc << 1) ^ 0x04C11DB7;
+            else
+               crc = (crc << 1);
+        }
+    }
+
+    /*const size_t len = (data.size()/4)*4;
+    stmbl_config_crc32_t crc = stmbl_config_crc32_init();
+    crc = stmbl_config_crc32_update(crc, data.data(), len);
+    crc = stmbl_config_crc32_finalize(crc);*/
+    return crc;
+}
+
+} // namespace STMBL_Servoterm
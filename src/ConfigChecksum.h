@@ -0,0 +1,35 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STMBL_SERVOTERM_CONFIGCHECKSUM_H
+#define STMBL_SERVOTERM_CONFIGCHECKSUM_H
+
+#include <QByteArray>
+
+namespace STMBL_Servoterm {
+
+// the CRC-32 (poly 0x04C11DB7, no reflection) the drive calculates
+// over its stored config, one little endian 32-bit word at a time;
+// trailing bytes that don't make up a whole word are ignored
+quint32 CalculateConfigCRC(const QByteArray &data);
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_CONFIGCHECKSUM_H
@@ -1,6 +1,7 @@
 #include "ConfigDialog.h"
 #include "SerialConnection.h"
 #include "AppendTextToEdit.h"
+#include "ConfigChecksum.h"
 //#include "stmbl_config_crc32.h"
 
 #include <QVBoxLayout>
@@ -68,9 +69,19 @@ ConfigDialog::~ConfigDialog()
 {
 }
 
+bool ConfigDialog::hasConfig() const
+{
+    return !_configEdit->document()->isEmpty();
+}
+
+quint32 ConfigDialog::configChecksum() const
+{
+    return CalculateConfigCRC(_configEdit->document()->toPlainText().toLatin1());
+}
+
 void ConfigDialog::appendConfigLine(const QString &configLine)
 {
-    AppendTextToEdit(*_configEdit, &QPlainTextEdit::insertPlainText, configLine);
+    AppendPlainTextToEdit(*_configEdit, configLine);
 }
 
 void ConfigDialog::slot_SaveClicked()
@@ -82,42 +93,13 @@ void ConfigDialog::slot_SaveClicked()
     }
 }
 
-static quint32 CalculateCRC(const QByteArray &data)
-{
-    QDataStream stream(data);
-    stream.setByteOrder(QDataStream::LittleEndian);
-    quint32 crc = 0xffffffff;
-    while (true)
-    {
-        quint32 value = 0;
-        stream >> value;
-        if (stream.status() != QDataStream::Ok)
-            break;
-        crc ^= value;
-        for (int j = 0; j < 32; j++)
-        {
-            if (crc & 0x80000000)
-               crc = (crc << 1) ^ 0x04C11DB7;
-            else
-               crc = (crc << 1);
-        }
-    }
-
-    /*const size_t len = (data.size()/4)*4;
-    stmbl_config_crc32_t crc = stmbl_config_crc32_init();
-    crc = stmbl_config_crc32_update(crc, data.data(), len);
-    crc = stmbl_config_crc32_finalize(crc);*/
-    return crc;
-}
-
 void ConfigDialog::slot_ConfigTextChanged()
 {
     // NOTE: the -1 is to disregard an invisible
     // "paragraph separator", see the following post:
     // https://bugreports.qt.io/browse/QTBUG-4841
     _sizeLabel->setText("Size: " + QString::number(qMax(0, _configEdit->document()->characterCount()-1)).rightJustified(6) + " bytes");
-    const QByteArray configBytes = _configEdit->document()->toPlainText().toLatin1();//.replace('\n', '\r');
-    const quint32 checksum = CalculateCRC(configBytes);
+    const quint32 checksum = configChecksum();
     _checksumLabel->setText("CRC: " + QString::number(checksum, 16).rightJustified(8, '0'));
 }
 
@@ -38,6 +38,8 @@ class ConfigDialog : public QDialog
 public:
     ConfigDialog(SerialConnection *serialConnection, QWidget *parent = nullptr);
     ~ConfigDialog();
+    bool hasConfig() const; // NOTE: whether any was read from the drive (or typed in)
+    quint32 configChecksum() const; // see CalculateConfigCRC()
 public slots:
     void appendConfigLine(const QString &configLine);
 protected slots:
@@ -0,0 +1,296 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DriveSimulator.h"
+#include "ScopeDataScanner.h"
+#include "globals.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QTimer>
+
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+static const double TWO_PI = 6.28318530717958647692;
+static const int TICK_INTERVAL_MS = 1;
+static const qint64 JOG_TIMEOUT_MS = 750; // same as the drive
+static const double JOG_VELOCITY = TWO_PI; // rad/s
+static const double VELOCITY_TIME_CONSTANT = 0.05; // s
+static const double CURRENT_PER_ACCELERATION = 0.02;
+static const int SATURATED_NOMINAL_RATE = 20000; // what dt the plant assumes when not rate limited
+static const qint64 SATURATED_BACKLOG_BYTES = 256*1024; // keep this much queued in the socket when saturating
+static const int MAXIMUM_BURST_PACKETS = 10000; // don't try to catch up forever after a stall
+
+DriveSimulator::Options::Options() :
+    port(5000),
+    packetRate(5000),
+    resetInterval(0),
+    textRate(1),
+    channelCount(SCOPE_CHANNEL_COUNT),
+    extendedFrames(false)
+{
+}
+
+DriveSimulator::DriveSimulator(const Options &options, QObject *parent) :
+    QObject(parent),
+    _options(options),
+    _server(new QTcpServer(this)),
+    _client(nullptr),
+    _tickTimer(new QTimer(this)),
+    _position(0.0),
+    _velocity(0.0),
+    _velocityCommand(0.0),
+    _current(0.0),
+    _enabled(false),
+    _jogDeadlineMs(0),
+    _packetsSent(0),
+    _textLinesSent(0),
+    _noiseSeed(1)
+{
+    _config << "conf0.r = 1.5" << "conf0.l = 0.002" << "conf0.j = 0.00001" << "conf0.polecount = 4" << "conf0.max_vel = 6000";
+    _options.channelCount = qBound(1, _options.channelCount, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    _tickTimer->setInterval(TICK_INTERVAL_MS);
+    _tickTimer->setTimerType(Qt::PreciseTimer);
+    connect(_server, &QTcpServer::newConnection, this, &DriveSimulator::slot_NewConnection);
+    connect(_tickTimer, &QTimer::timeout, this, &DriveSimulator::slot_Tick);
+}
+
+bool DriveSimulator::listen()
+{
+    return _server->listen(QHostAddress::LocalHost, _options.port);
+}
+
+QString DriveSimulator::errorString() const
+{
+    return _server->errorString();
+}
+
+void DriveSimulator::slot_NewConnection()
+{
+    QTcpSocket * const socket = _server->nextPendingConnection();
+    if (!socket)
+        return;
+    if (_client)
+    {
+        // like the USB port, only one host at a time
+        socket->write("busy\n");
+        socket->disconnectFromHost();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        return;
+    }
+    _client = socket;
+    _client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(_client, &QTcpSocket::readyRead, this, &DriveSimulator::slot_ClientDataReceived);
+    connect(_client, &QTcpSocket::disconnected, this, &DriveSimulator::slot_ClientDisconnected);
+    connect(_client, &QTcpSocket::bytesWritten, this, &DriveSimulator::slot_Tick); // keeps a saturated link full
+    _rxLine.clear();
+    _packetsSent = 0;
+    _textLinesSent = 0;
+    _clock.start();
+    _tickTimer->start();
+}
+
+void DriveSimulator::slot_ClientDisconnected()
+{
+    _tickTimer->stop();
+    _client->deleteLater();
+    _client = nullptr;
+    _velocityCommand = 0.0;
+    _jogDeadlineMs = 0;
+}
+
+void DriveSimulator::slot_ClientDataReceived()
+{
+    const QByteArray data = _client->readAll();
+    for (QByteArray::const_iterator it = data.begin(); it != data.end(); ++it)
+    {
+        if (*it == '\n')
+        {
+            _HandleCommand(QString::fromLatin1(_rxLine).trimmed());
+            _rxLine.resize(0);
+        }
+        else
+        {
+            _rxLine.append(*it);
+        }
+    }
+}
+
+void DriveSimulator::slot_Tick()
+{
+    if (!_client)
+        return;
+
+    // jogging stops by itself unless the host keeps repeating it
+    if (_jogDeadlineMs != 0 && _clock.elapsed() > _jogDeadlineMs)
+    {
+        _velocityCommand = 0.0;
+        _jogDeadlineMs = 0;
+    }
+
+    // NOTE: in double, a qint64 of nanoseconds times the rate overflows
+    //       within hours at high rates; double stays exact far longer
+    const double elapsedSeconds = _clock.nsecsElapsed()*1e-9;
+    const qint64 packetsDue = static_cast<qint64>(elapsedSeconds*_options.packetRate);
+    qint64 due = 0;
+    if (_options.packetRate > 0)
+        due = packetsDue - _packetsSent;
+    else
+        due = (SATURATED_BACKLOG_BYTES - _client->bytesToWrite())/_PacketSize();
+    due = qBound<qint64>(0, due, MAXIMUM_BURST_PACKETS);
+    if (_options.packetRate > 0 && due == MAXIMUM_BURST_PACKETS)
+        _packetsSent = packetsDue - due; // give up on the backlog
+
+    QByteArray out;
+    out.reserve(due*_PacketSize() + 128);
+    const double dt = 1.0/(_options.packetRate > 0 ? _options.packetRate : SATURATED_NOMINAL_RATE);
+    for (qint64 i = 0; i < due; i++)
+    {
+        _StepPlant(dt);
+        _AppendPacket(out);
+        _packetsSent++;
+        if (_options.resetInterval > 0 && _packetsSent % _options.resetInterval == 0)
+            out.append(static_cast<char>(0xFE));
+    }
+    if (_options.textRate > 0)
+    {
+        const qint64 linesDue = static_cast<qint64>(elapsedSeconds*_options.textRate);
+        while (_textLinesSent < linesDue)
+        {
+            out.append(QString("sim: pos = %1 vel = %2 en = %3\n").arg(_position, 0, 'f', 3).arg(_velocity, 0, 'f', 3).arg(_enabled ? 1 : 0).toLatin1());
+            _textLinesSent++;
+        }
+    }
+    _Send(out);
+}
+
+void DriveSimulator::_HandleCommand(const QString &command)
+{
+    if (command.isEmpty())
+        return;
+    if (command == "jogl" || command == "jogr")
+    {
+        _velocityCommand = (command == "jogl") ? -JOG_VELOCITY : JOG_VELOCITY;
+        _jogDeadlineMs = _clock.elapsed() + JOG_TIMEOUT_MS;
+    }
+    else if (command == "jogx")
+    {
+        _velocityCommand = 0.0;
+        _jogDeadlineMs = 0;
+    }
+    else if (command == "showconf")
+    {
+        _Send(_config.join('\n').toLatin1() + '\n');
+    }
+    else if (command == "deleteconf")
+    {
+        _config.clear();
+    }
+    else if (command.startsWith("appendconf"))
+    {
+        _config.append(command.mid(QString("appendconf").size()).trimmed());
+    }
+    else if (command == "flashsaveconf")
+    {
+        _Send(QString("saved %1 config lines\n").arg(_config.size()).toLatin1());
+    }
+    else if (command.startsWith("fault0.en"))
+    {
+        _enabled = command.endsWith('1');
+    }
+    else
+    {
+        _Send(("not found: " + command + "\n").toLatin1());
+    }
+}
+
+void DriveSimulator::_StepPlant(double dt)
+{
+    const double target = _enabled ? _velocityCommand : 0.0;
+    const double acceleration = (target - _velocity)/VELOCITY_TIME_CONSTANT;
+    _velocity += acceleration*dt;
+    _position = std::fmod(_position + _velocity*dt, TWO_PI);
+    if (_position < 0.0)
+        _position += TWO_PI;
+    _noiseSeed = _noiseSeed*1664525 + 1013904223;
+    const double noise = (static_cast<int>(_noiseSeed >> 24) - 128)/128.0*0.01;
+    _current = acceleration*CURRENT_PER_ACCELERATION + noise;
+}
+
+void DriveSimulator::_AppendPacket(QByteArray &out)
+{
+    double values[SCOPE_MAXIMUM_CHANNEL_COUNT] = {};
+    const double channels[] =
+    {
+        std::cos(_position), // a resolver-like sin/cos pair for the X/Y scope
+        std::sin(_position),
+        _velocity/JOG_VELOCITY*0.5,
+        _current,
+        _velocityCommand/JOG_VELOCITY*0.5,
+        _position/TWO_PI*2.0 - 1.0,
+        _enabled ? 0.5 : 0.0,
+        std::sin(3.0*_position)*0.25
+    };
+    for (int channel = 0; channel < _options.channelCount && channel < static_cast<int>(sizeof(channels)/sizeof(channels[0])); channel++)
+        values[channel] = channels[channel];
+
+    if (_options.extendedFrames)
+    {
+        quint8 frame[1 + 2*SCOPE_MAXIMUM_CHANNEL_COUNT + 2];
+        frame[0] = static_cast<quint8>(_options.channelCount);
+        for (int channel = 0; channel < _options.channelCount; channel++)
+        {
+            const int value = qBound(-32768, static_cast<int>(std::lround(values[channel]*32768.0)), 32767);
+            frame[1 + 2*channel] = static_cast<quint8>(value & 0xFF);
+            frame[2 + 2*channel] = static_cast<quint8>((value >> 8) & 0xFF);
+        }
+        const int length = 1 + 2*_options.channelCount;
+        const quint16 crc = ScopeScanCrc16(frame, length);
+        frame[length] = static_cast<quint8>(crc & 0xFF);
+        frame[length + 1] = static_cast<quint8>(crc >> 8);
+        out.append(static_cast<char>(0xFF));
+        out.append(static_cast<char>(0xFF));
+        out.append(reinterpret_cast<const char *>(frame), length + 2);
+        return;
+    }
+
+    out.append(static_cast<char>(0xFF));
+    for (int channel = 0; channel < _options.channelCount; channel++)
+    {
+        // the drive never sends the marker values as samples
+        const int code = qBound(0, static_cast<int>(std::lround(values[channel]*128.0 + 128.0)), 0xFD);
+        out.append(static_cast<char>(code));
+    }
+}
+
+int DriveSimulator::_PacketSize() const
+{
+    return _options.extendedFrames ? 2 + 1 + 2*_options.channelCount + 2 : 1 + _options.channelCount;
+}
+
+void DriveSimulator::_Send(const QByteArray &data)
+{
+    if (_client && !data.isEmpty())
+        _client->write(data);
+}
+
+} // namespace STMBL_Servoterm
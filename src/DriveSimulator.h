@@ -0,0 +1,94 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_DRIVESIMULATOR_H
+#define STMBL_SERVOTERM_DRIVESIMULATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// well beyond what a real drive or link does, the rates are clamped to these
+static const int SIMULATOR_MAXIMUM_PACKET_RATE = 10000000;
+static const int SIMULATOR_MAXIMUM_TEXT_RATE = 100000;
+
+// pretends to be an STMBL drive on a local TCP port, speaking the same
+// wire format as the USB connection (0xFF framed scope packets, 0xFE
+// scope resets, text in between), for load testing without hardware
+class DriveSimulator : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options
+    {
+        Options();
+        quint16 port;
+        int packetRate; // packets per second, 0 saturates the link
+        int resetInterval; // packets between 0xFE markers, 0 for none
+        int textRate; // status lines per second, 0 for none
+        int channelCount; // scope channels per packet
+        bool extendedFrames; // 16-bit CRC checked frames instead of 8-bit packets
+    };
+
+    DriveSimulator(const Options &options, QObject *parent = nullptr);
+    bool listen();
+    QString errorString() const;
+protected slots:
+    void slot_NewConnection();
+    void slot_ClientDisconnected();
+    void slot_ClientDataReceived();
+    void slot_Tick();
+protected:
+    void _HandleCommand(const QString &command);
+    void _StepPlant(double dt);
+    void _AppendPacket(QByteArray &out);
+    int _PacketSize() const;
+    void _Send(const QByteArray &data);
+
+    Options _options;
+    QTcpServer *_server;
+    QTcpSocket *_client;
+    QTimer *_tickTimer;
+    QElapsedTimer _clock;
+    QByteArray _rxLine;
+    QStringList _config;
+
+    // the plant: a motor with a first order velocity loop
+    double _position;
+    double _velocity;
+    double _velocityCommand;
+    double _current;
+    bool _enabled;
+    qint64 _jogDeadlineMs;
+    qint64 _packetsSent;
+    qint64 _textLinesSent;
+    quint32 _noiseSeed;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_DRIVESIMULATOR_H
@@ -0,0 +1,145 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FftPlan.h"
+
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+static const double PI = 3.14159265358979323846; // NOTE: M_PI isn't standard
+
+FftPlan::FftPlan(int size) :
+    _size(4)
+{
+    while (_size < size)
+        _size <<= 1;
+    const int half = _size/2;
+
+    int bits = 0;
+    while ((1 << bits) < half)
+        bits++;
+    _bitReverse.resize(half);
+    for (int i = 0; i < half; i++)
+    {
+        int reversed = 0;
+        for (int bit = 0; bit < bits; bit++)
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        _bitReverse[i] = reversed;
+    }
+
+    // NOTE: worked out in double precision, so the error doesn't build up
+    _twiddleRe.resize(qMax(1, half - 1));
+    _twiddleIm.resize(qMax(1, half - 1));
+    for (int h = 1; h < half; h *= 2)
+    {
+        for (int j = 0; j < h; j++)
+        {
+            const double angle = -PI*j/h;
+            _twiddleRe[h - 1 + j] = static_cast<float>(std::cos(angle));
+            _twiddleIm[h - 1 + j] = static_cast<float>(std::sin(angle));
+        }
+    }
+    _splitRe.resize(half + 1);
+    _splitIm.resize(half + 1);
+    for (int k = 0; k <= half; k++)
+    {
+        const double angle = -2.0*PI*k/_size;
+        _splitRe[k] = static_cast<float>(std::cos(angle));
+        _splitIm[k] = static_cast<float>(std::sin(angle));
+    }
+    _re.resize(half);
+    _im.resize(half);
+}
+
+int FftPlan::size() const
+{
+    return _size;
+}
+
+int FftPlan::binCount() const
+{
+    return _size/2 + 1;
+}
+
+void FftPlan::powerSpectrum(const float *samples, const float *window, float *power)
+{
+    const int half = _size/2;
+    float * const re = _re.data();
+    float * const im = _im.data();
+    const int * const bitReverse = _bitReverse.constData();
+    // the even samples are the real parts, the odd ones the imaginary parts
+    for (int i = 0; i < half; i++)
+    {
+        const int j = bitReverse[i];
+        re[j] = samples[2*i]*window[2*i];
+        im[j] = samples[2*i + 1]*window[2*i + 1];
+    }
+    _Transform();
+
+    // X[k] = E[k] + e^(-2*pi*i*k/size)*O[k], where the transforms of the
+    // even and odd samples are E[k] = (Z[k] + Z*[half-k])/2 and
+    // O[k] = (Z[k] - Z*[half-k])/2i
+    const float * const splitRe = _splitRe.constData();
+    const float * const splitIm = _splitIm.constData();
+    for (int k = 0; k <= half; k++)
+    {
+        const int a = (k == half) ? 0 : k;
+        const int b = (k == 0) ? 0 : half - k;
+        const float evenRe = 0.5f*(re[a] + re[b]);
+        const float evenIm = 0.5f*(im[a] - im[b]);
+        const float oddRe = 0.5f*(im[a] + im[b]);
+        const float oddIm = -0.5f*(re[a] - re[b]);
+        const float xRe = evenRe + splitRe[k]*oddRe - splitIm[k]*oddIm;
+        const float xIm = evenIm + splitRe[k]*oddIm + splitIm[k]*oddRe;
+        power[k] = xRe*xRe + xIm*xIm;
+    }
+}
+
+void FftPlan::_Transform()
+{
+    // radix-2 decimation in time, each stage going through
+    // the points and its own twiddles front to back
+    const int half = _size/2;
+    float * const re = _re.data();
+    float * const im = _im.data();
+    for (int h = 1; h < half; h *= 2)
+    {
+        const float * const wRe = _twiddleRe.constData() + h - 1;
+        const float * const wIm = _twiddleIm.constData() + h - 1;
+        for (int start = 0; start < half; start += 2*h)
+        {
+            float * const aRe = re + start;
+            float * const aIm = im + start;
+            float * const bRe = aRe + h;
+            float * const bIm = aIm + h;
+            for (int j = 0; j < h; j++)
+            {
+                const float tRe = wRe[j]*bRe[j] - wIm[j]*bIm[j];
+                const float tIm = wRe[j]*bIm[j] + wIm[j]*bRe[j];
+                bRe[j] = aRe[j] - tRe;
+                bIm[j] = aIm[j] - tIm;
+                aRe[j] += tRe;
+                aIm[j] += tIm;
+            }
+        }
+    }
+}
+
+} // namespace STMBL_Servoterm
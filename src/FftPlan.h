@@ -0,0 +1,57 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_FFTPLAN_H
+#define STMBL_SERVOTERM_FFTPLAN_H
+
+#include <QVector>
+
+namespace STMBL_Servoterm {
+
+// a real input FFT of one power of two size, with everything that only
+// depends on the size (the bit reversal, the twiddle factors of every
+// stage laid out one after another) worked out up front
+// NOTE: it is done as a complex FFT of half the size on the even/odd
+//       samples, whose halves are then untangled, which is about twice
+//       as fast as transforming the samples as they are
+class FftPlan
+{
+public:
+    explicit FftPlan(int size = 0); // NOTE: size is rounded up to a power of two, at least 4
+    int size() const;
+    int binCount() const; // size/2 + 1, from 0 up to the Nyquist frequency
+    // windows the size samples and writes the squared magnitudes of the bins
+    // NOTE: not thread safe, the plan has the work buffers too
+    void powerSpectrum(const float *samples, const float *window, float *power);
+protected:
+    void _Transform(); // in place on _re/_im, in bit reversed order
+
+    int _size;
+    QVector<int> _bitReverse; // of the size/2 complex points
+    QVector<float> _twiddleRe; // for the stage with a half length of h, the h entries from h-1 on
+    QVector<float> _twiddleIm;
+    QVector<float> _splitRe; // e^(-2*pi*i*k/size), for untangling the halves
+    QVector<float> _splitIm;
+    QVector<float> _re;
+    QVector<float> _im;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_FFTPLAN_H
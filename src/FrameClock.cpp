@@ -0,0 +1,108 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FrameClock.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTimer>
+
+namespace STMBL_Servoterm {
+
+static const double FALLBACK_REFRESH_RATE = 60.0; // if the display doesn't tell
+static const qint64 STATS_PERIOD_NS = 1000000000;
+
+FrameClock::FrameClock(QObject *parent) :
+    QObject(parent),
+    _timer(new QTimer(this)),
+    _frameRateCap(0),
+    _frameRate(FALLBACK_REFRESH_RATE),
+    _framePeriodNs(0),
+    _nextTickNs(0),
+    _statsStartNs(0),
+    _statsFrames(0),
+    _statsPackets(0)
+{
+    _timer->setSingleShot(true);
+    _timer->setTimerType(Qt::PreciseTimer);
+    connect(_timer, &QTimer::timeout, this, &FrameClock::slot_Tick);
+    _clock.start();
+    setFrameRateCap(0);
+}
+
+int FrameClock::frameRateCap() const
+{
+    return _frameRateCap;
+}
+
+double FrameClock::frameRate() const
+{
+    return _frameRate;
+}
+
+FrameClock::Stats FrameClock::stats() const
+{
+    return _stats;
+}
+
+void FrameClock::setFrameRateCap(int framesPerSecond)
+{
+    _frameRateCap = qMax(0, framesPerSecond);
+    const QScreen * const screen = QGuiApplication::primaryScreen();
+    const double refreshRate = (screen && screen->refreshRate() > 0.0) ? screen->refreshRate() : FALLBACK_REFRESH_RATE;
+    _frameRate = (_frameRateCap > 0) ? qMin(refreshRate, static_cast<double>(_frameRateCap)) : refreshRate;
+    _framePeriodNs = static_cast<qint64>(1e9/_frameRate);
+    _nextTickNs = _clock.nsecsElapsed();
+    _ScheduleNextTick();
+}
+
+void FrameClock::addPackets(int packetCount)
+{
+    _statsPackets += packetCount;
+}
+
+void FrameClock::slot_Tick()
+{
+    emit frame();
+    _statsFrames++;
+    const qint64 now = _clock.nsecsElapsed();
+    if (now - _statsStartNs >= STATS_PERIOD_NS)
+    {
+        _stats.framesPerSecond = _statsFrames*1e9/(now - _statsStartNs);
+        _stats.packetsPerFrame = static_cast<double>(_statsPackets)/_statsFrames;
+        _statsStartNs = now;
+        _statsFrames = 0;
+        _statsPackets = 0;
+    }
+    _ScheduleNextTick();
+}
+
+void FrameClock::_ScheduleNextTick()
+{
+    // aim for evenly spaced ticks rather than a fixed gap after each
+    // one, so the integer millisecond timer doesn't skew the rate
+    // NOTE: ticks that were missed altogether are skipped, not caught up on
+    const qint64 now = _clock.nsecsElapsed();
+    _nextTickNs += _framePeriodNs;
+    if (_nextTickNs < now)
+        _nextTickNs = now + _framePeriodNs;
+    _timer->start(static_cast<int>((_nextTickNs - now + 500000)/1000000));
+}
+
+} // namespace STMBL_Servoterm
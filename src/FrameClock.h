@@ -0,0 +1,76 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_FRAMECLOCK_H
+#define STMBL_SERVOTERM_FRAMECLOCK_H
+
+#include <QObject>
+#include <QElapsedTimer>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// the one render clock for all the scope views: each frame() first drains
+// the ingest (SerialConnection::drainIngest()), which only marks views
+// dirty, and then the views repaint what is dirty; it ticks at the
+// display's refresh rate or a lower cap
+class FrameClock : public QObject
+{
+    Q_OBJECT
+public:
+    // measured over the last second or so
+    struct Stats
+    {
+        Stats() : framesPerSecond(0.0), packetsPerFrame(0.0) {}
+        double framesPerSecond;
+        double packetsPerFrame;
+    };
+
+    FrameClock(QObject *parent = nullptr);
+    int frameRateCap() const;
+    double frameRate() const; // what the ticks aim for
+    Stats stats() const;
+public slots:
+    void setFrameRateCap(int framesPerSecond); // NOTE: 0 means just the display's refresh rate
+    void addPackets(int packetCount); // NOTE: only for the stats
+signals:
+    void frame();
+protected slots:
+    void slot_Tick();
+protected:
+    void _ScheduleNextTick();
+
+    QTimer *_timer;
+    QElapsedTimer _clock;
+    int _frameRateCap;
+    double _frameRate;
+    qint64 _framePeriodNs;
+    qint64 _nextTickNs;
+    qint64 _statsStartNs;
+    int _statsFrames;
+    quint64 _statsPackets;
+    Stats _stats;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_FRAMECLOCK_H
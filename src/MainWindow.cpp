@@ -46,8 +46,15 @@
 #include "ConfigDialog.h"
 #include "Oscilloscope.h"
 #include "XYOscilloscope.h"
+#include "SpectrumView.h"
+#include "ScopeMeasurements.h"
 #include "HistoryLineEdit.h"
 #include "SerialConnection.h"
+#include "CaptureFile.h"
+#include "ScopeRecording.h"
+#include "ScopeRecorder.h"
+#include "FrameClock.h"
+#include "TriggerToolBar.h"
 
 #include <limits>
 
@@ -58,6 +65,10 @@ template<typename T, typename M>
 static void AppendTextToEdit(T &target, M insertMethod, const QString &txt);
 
 static const int SEND_JOG_COMMAND_PERIOD_MS = 250; // 250ms, which is earlier than the 750ms timeout on the STMBL drive
+static const int LINK_STATUS_PERIOD_MS = 1000;
+static const int STATUS_MESSAGE_TIMEOUT_MS = 5000;
+static const int MAXIMUM_REPLAY_FILES = 8;
+static const QString DATETIME_FORMAT = "yyyy-MM-dd_hh-mm-ss-zzz";
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -67,18 +78,27 @@ MainWindow::MainWindow(QWidget *parent) :
     _portList(new ClickableComboBox),
     _oscilloscope(new Oscilloscope),
     _xyOscilloscope(new XYOscilloscope),
+    _spectrumView(new SpectrumView),
+    _measurements(new ScopeMeasurements),
+    _frameClock(new FrameClock(this)),
+    _triggerToolBar(new TriggerToolBar),
     _textLog(new QTextEdit),
     _lineEdit(new HistoryLineEdit),
     _sendButton(new QPushButton("Send")),
     _settings(new QSettings(QCoreApplication::organizationName(), QCoreApplication::applicationName(), this)),
     _configDialog(new ConfigDialog(_serialConnection, this)),
     _jogTimer(new QTimer(this)),
-    _csvFile(new QFile(this)),
+    _recorder(new ScopeRecorder(this)),
+    _converterThread(new QThread(this)),
+    _converter(new ScopeRecordingConverter),
+    _linkStatusLabel(new QLabel),
+    _linkStatusTimer(new QTimer(this)),
     _estopShortcut(new QShortcut(QKeySequence("Esc"), this)),
     _leftPressed(false),
     _rightPressed(false)
 {
     _jogTimer->setInterval(SEND_JOG_COMMAND_PERIOD_MS);
+    _linkStatusTimer->setInterval(LINK_STATUS_PERIOD_MS);
     _portList->setEditable(true);
     {
         static const QString exampleIP = "xxx.xxx.xxx.xxx:yyyyy";
@@ -112,12 +132,18 @@ MainWindow::MainWindow(QWidget *parent) :
     // TODO make these settings saved between program launches
     _actions->viewOscilloscope->setChecked(true);
     _actions->viewXYScope->setChecked(false);
+    _actions->viewSpectrum->setChecked(false);
+    _actions->viewMeasurements->setChecked(false);
     _actions->viewConsole->setChecked(true);
     // TODO find a better solution to the side effects of setVisible(true) when it's already visible but not shown yet
     if (!_actions->viewOscilloscope->isChecked())
         _oscilloscope->setVisible(_actions->viewOscilloscope->isChecked());
     if (!_actions->viewXYScope->isChecked())
         _xyOscilloscope->setVisible(_actions->viewXYScope->isChecked());
+    if (!_actions->viewSpectrum->isChecked())
+        _spectrumView->setVisible(_actions->viewSpectrum->isChecked());
+    if (!_actions->viewMeasurements->isChecked())
+        _measurements->setVisible(_actions->viewMeasurements->isChecked());
     if (!_actions->viewConsole->isChecked())
         _textLog->setVisible(_actions->viewConsole->isChecked());
 
@@ -140,13 +166,16 @@ MainWindow::MainWindow(QWidget *parent) :
         toolbar->addAction(_actions->driveEditConfig);
         addToolBar(toolbar);
     }
+    addToolBar(_triggerToolBar);
     {
         QWidget * const dummy = new QWidget;
         QVBoxLayout * const vbox = new QVBoxLayout(dummy);
         {
             QHBoxLayout * const hbox = new QHBoxLayout;
             hbox->addWidget(_oscilloscope, 1);
+            hbox->addWidget(_spectrumView, 1);
             hbox->addWidget(_xyOscilloscope);
+            hbox->addWidget(_measurements);
             vbox->addLayout(hbox);
         }
         vbox->addWidget(_textLog);
@@ -158,10 +187,13 @@ MainWindow::MainWindow(QWidget *parent) :
         }
         setCentralWidget(dummy);
     }
+    statusBar()->addPermanentWidget(_linkStatusLabel);
 
     connect(_actions->fileQuit, &QAction::triggered, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
     connect(_actions->viewOscilloscope, &QAction::toggled, _oscilloscope, &QWidget::setVisible);
     connect(_actions->viewXYScope, &QAction::toggled, _xyOscilloscope, &QWidget::setVisible);
+    connect(_actions->viewSpectrum, &QAction::toggled, _spectrumView, &QWidget::setVisible);
+    connect(_actions->viewMeasurements, &QAction::toggled, _measurements, &QWidget::setVisible);
     connect(_actions->viewConsole, &QAction::toggled, _textLog, &QWidget::setVisible);
     connect(_menuBar->portMenu, &QMenu::aboutToShow, this, &MainWindow::slot_PortListClicked);
     connect(_menuBar->portGroup, &QActionGroup::triggered, this, &MainWindow::slot_PortMenuItemSelected);
@@ -169,12 +201,42 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(_portList, &ClickableComboBox::currentTextChanged, this, &MainWindow::slot_PortLineEditChanged);
     connect(_actions->connectionConnect, &QAction::triggered, this, &MainWindow::slot_ConnectClicked);
     connect(_actions->connectionDisconnect, &QAction::triggered, this, &MainWindow::slot_DisconnectClicked);
+    connect(_actions->connectionOpenCapture, &QAction::triggered, this, &MainWindow::slot_OpenCaptureClicked);
+    connect(_actions->connectionReplaySpeedGroup, &QActionGroup::triggered, this, &MainWindow::slot_ReplaySpeedSelected);
     connect(_actions->viewClearConsole, &QAction::triggered, _textLog, &QTextEdit::clear);
+    connect(_actions->viewPauseOscilloscope, &QAction::toggled, _oscilloscope, &Oscilloscope::setPaused);
+    connect(_actions->viewAutoscaleOscilloscope, &QAction::toggled, _oscilloscope, &Oscilloscope::setAutoscale);
+    connect(_oscilloscope, &Oscilloscope::statisticsUpdated, _measurements, &ScopeMeasurements::setReport);
+    connect(_oscilloscope, &Oscilloscope::errorMessage, this, &MainWindow::slot_LogError);
+    connect(_triggerToolBar, &TriggerToolBar::settingsChanged, _oscilloscope, &Oscilloscope::setTriggerSettings);
+    connect(_triggerToolBar, &TriggerToolBar::armClicked, _oscilloscope, &Oscilloscope::armTrigger);
+    connect(_actions->viewTimebaseGroup, &QActionGroup::triggered, this, &MainWindow::slot_TimebaseSelected);
+    connect(_actions->viewFrameRateGroup, &QActionGroup::triggered, this, &MainWindow::slot_FrameRateSelected);
+    // NOTE: connected first, so every frame paints what the drain just delivered
+    connect(_frameClock, &FrameClock::frame, _serialConnection, &SerialConnection::drainIngest);
+    connect(_frameClock, &FrameClock::frame, _oscilloscope, &Oscilloscope::frameTick);
+    connect(_frameClock, &FrameClock::frame, _spectrumView, &SpectrumView::frameTick);
+    connect(_actions->viewSpectrumSizeGroup, &QActionGroup::triggered, this, &MainWindow::slot_SpectrumSizeSelected);
+    connect(_actions->viewSpectrumWindowGroup, &QActionGroup::triggered, this, &MainWindow::slot_SpectrumWindowSelected);
+    connect(_actions->viewSpectrumAveragingGroup, &QActionGroup::triggered, this, &MainWindow::slot_SpectrumAveragingSelected);
+    connect(_actions->viewSpectrumPeakHold, &QAction::toggled, _spectrumView, &SpectrumView::setPeakHold);
+    connect(_actions->viewSpectrumResetPeaks, &QAction::triggered, _spectrumView, &SpectrumView::resetPeaks);
+    for (int channel = 0; channel < _actions->viewSpectrumChannels.size(); channel++)
+        connect(_actions->viewSpectrumChannels[channel], &QAction::toggled, this, &MainWindow::slot_SpectrumChannelsChanged);
+    connect(_frameClock, &FrameClock::frame, _xyOscilloscope, &XYOscilloscope::frameTick);
+    connect(_actions->viewXYModeGroup, &QActionGroup::triggered, this, &MainWindow::slot_XYModeSelected);
+    connect(_actions->viewXYDensityMappingGroup, &QActionGroup::triggered, this, &MainWindow::slot_XYDensityMappingSelected);
+    connect(_actions->viewXYDensityDecayGroup, &QActionGroup::triggered, this, &MainWindow::slot_XYDensityDecaySelected);
+    connect(_actions->viewXYChannelPairs, &QAction::triggered, this, &MainWindow::slot_XYChannelPairsClicked);
     connect(_actions->driveDisable, &QAction::triggered, this, &MainWindow::slot_DisableClicked);
     connect(_actions->driveEnable, &QAction::triggered, this, &MainWindow::slot_EnableClicked);
     connect(_actions->driveJogEnable, &QAction::toggled, this, &MainWindow::slot_SendJogCommand);
     connect(_actions->driveEditConfig, &QAction::triggered, _configDialog, &ConfigDialog::exec);
     connect(_actions->dataRecord, &QAction::toggled, this, &MainWindow::slot_DataRecordToggled);
+    connect(_actions->dataCapture, &QAction::toggled, this, &MainWindow::slot_DataCaptureToggled);
+    connect(_actions->dataConvertRecording, &QAction::triggered, this, &MainWindow::slot_DataConvertRecordingClicked);
+    connect(_actions->dataChannelsGroup, &QActionGroup::triggered, this, &MainWindow::slot_DataChannelsSelected);
+    connect(_actions->dataHistoryGroup, &QActionGroup::triggered, this, &MainWindow::slot_HistoryBudgetSelected);
     connect(_actions->dataSetDirectory, &QAction::triggered, this, &MainWindow::slot_DataSetDirectoryClicked);
     connect(_actions->dataOpenDirectory, &QAction::triggered, this, &MainWindow::slot_DataOpenDirectoryClicked);
     connect(_lineEdit, &HistoryLineEdit::textChanged, this, &MainWindow::slot_UpdateButtons);
@@ -182,17 +244,30 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(_sendButton, &QPushButton::clicked, this, &MainWindow::slot_SendClicked);
     connect(_textLog, &QTextEdit::textChanged, this, &MainWindow::slot_UpdateButtons);
     connect(_estopShortcut, &QShortcut::activated, this, &MainWindow::slot_EmergencyStop);
-    connect(_serialConnection, &SerialConnection::lineReceived, this, &MainWindow::slot_LogLine);
+    connect(_serialConnection, &SerialConnection::linesReceived, this, &MainWindow::slot_LogLines);
     connect(_serialConnection, &SerialConnection::configLineReceived, _configDialog, &ConfigDialog::appendConfigLine);
     connect(_serialConnection, &SerialConnection::connected, this, &MainWindow::slot_SerialConnected);
     connect(_serialConnection, &SerialConnection::disconnected, this, &MainWindow::slot_SerialDisconnected);
     connect(_serialConnection, &SerialConnection::connected, this, &MainWindow::slot_UpdateButtons);
     connect(_serialConnection, &SerialConnection::disconnected, this, &MainWindow::slot_UpdateButtons);
-    connect(_serialConnection, &SerialConnection::scopePacketReceived, this, &MainWindow::slot_ScopePacketReceived);
+    connect(_serialConnection, &SerialConnection::scopePacketsReceived, this, &MainWindow::slot_ScopePacketsReceived);
     connect(_serialConnection, &SerialConnection::scopeResetReceived, this, &MainWindow::slot_ScopeResetReceived);
+    connect(_serialConnection, &SerialConnection::scopeChannelCountChanged, this, &MainWindow::slot_ScopeChannelCountChanged);
     connect(_serialConnection, &SerialConnection::errorMessage, this, &MainWindow::slot_LogError);
     connect(_jogTimer, &QTimer::timeout, this, &MainWindow::slot_SendJogCommand);
+    connect(_recorder, &ScopeRecorder::started, this, &MainWindow::slot_RecordingStarted);
+    connect(_recorder, &ScopeRecorder::startFailed, this, &MainWindow::slot_RecordingStartFailed);
+    connect(_recorder, &ScopeRecorder::errorMessage, this, &MainWindow::slot_LogError);
+    connect(_converter, &ScopeRecordingConverter::progress, this, &MainWindow::slot_RecordingConversionProgress);
+    connect(_converter, &ScopeRecordingConverter::finished, this, &MainWindow::slot_RecordingConverted);
+    connect(_linkStatusTimer, &QTimer::timeout, this, &MainWindow::slot_UpdateLinkStatus);
     slot_UpdateButtons();
+    slot_UpdateLinkStatus();
+    _linkStatusTimer->start();
+
+    _converterThread->setObjectName("RecordingConverter");
+    _converter->moveToThread(_converterThread);
+    _converterThread->start();
 
     _RepopulateDeviceList();
     _loadSettings();
@@ -200,6 +275,10 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    _converter->cancel(); // NOTE: don't sit out a conversion still running
+    _converterThread->quit();
+    _converterThread->wait();
+    delete _converter; // NOTE: safe now that its thread is gone
 }
 
 void MainWindow::slot_PortListClicked()
@@ -272,42 +351,188 @@ void MainWindow::slot_EnableClicked()
     _serialConnection->sendData(QString("fault0.en = 1\n").toLatin1());
 }
 
+void MainWindow::slot_OpenCaptureClicked()
+{
+    const QString filePath = QFileDialog::getOpenFileName(this, tr("Open Capture"), _RecordingsDirectory(), QString("Servoterm captures (*.") + CAPTURE_FILE_SUFFIX + ");;All files (*)");
+    if (filePath.isEmpty())
+        return;
+    _AddReplayFile(filePath);
+    _portList->setCurrentText(SerialConnection::replayPortName(filePath));
+}
+
+void MainWindow::slot_ReplaySpeedSelected(QAction *act)
+{
+    _serialConnection->setReplaySpeed(act->data().toDouble());
+}
+
+void MainWindow::slot_DataChannelsSelected(QAction *act)
+{
+    _serialConnection->setScopeChannelCount(act->data().toInt());
+}
+
+void MainWindow::slot_HistoryBudgetSelected(QAction *act)
+{
+    _oscilloscope->setHistoryBudget(static_cast<qint64>(act->data().toInt()) << 20);
+}
+
+void MainWindow::slot_TimebaseSelected(QAction *act)
+{
+    _oscilloscope->setPacketsPerColumn(act->data().toInt());
+}
+
+void MainWindow::slot_FrameRateSelected(QAction *act)
+{
+    _frameClock->setFrameRateCap(act->data().toInt());
+}
+
+void MainWindow::slot_SpectrumSizeSelected(QAction *act)
+{
+    _spectrumView->setFftSize(act->data().toInt());
+}
+
+void MainWindow::slot_SpectrumWindowSelected(QAction *act)
+{
+    _spectrumView->setWindow(act->data().toInt());
+}
+
+void MainWindow::slot_SpectrumAveragingSelected(QAction *act)
+{
+    _spectrumView->setAveraging(act->data().toInt());
+}
+
+void MainWindow::slot_SpectrumChannelsChanged()
+{
+    quint32 channelMask = 0;
+    for (int channel = 0; channel < _actions->viewSpectrumChannels.size(); channel++)
+    {
+        if (_actions->viewSpectrumChannels[channel]->isChecked())
+            channelMask |= 1u << channel;
+    }
+    _spectrumView->setChannelMask(channelMask);
+}
+
+void MainWindow::slot_XYModeSelected(QAction *act)
+{
+    _xyOscilloscope->setMode(act->data().toInt());
+}
+
+void MainWindow::slot_XYDensityMappingSelected(QAction *act)
+{
+    _xyOscilloscope->setDensityMapping(act->data().toInt());
+}
+
+void MainWindow::slot_XYDensityDecaySelected(QAction *act)
+{
+    _xyOscilloscope->setDensityHalfLife(act->data().toInt());
+}
+
+void MainWindow::slot_XYChannelPairsClicked()
+{
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, "X/Y Scope Channel Pairs", "Plot channels against each other (X/Y, separated by commas):", QLineEdit::Normal, XYChannelPairsToString(_xyOscilloscope->channelPairs()), &ok);
+    if (!ok)
+        return;
+    const QVector<XYChannelPair> pairs = XYChannelPairsFromString(text);
+    if (pairs.isEmpty())
+    {
+        QMessageBox::warning(this, "X/Y Scope Channel Pairs", QString("\"%1\" is not a list of channel pairs like \"1/2, 3/4\"!").arg(text));
+        return;
+    }
+    _xyOscilloscope->setChannelPairs(pairs);
+}
+
 void MainWindow::slot_DataRecordToggled(bool recording)
 {
     // close the old file not only when stopping, but when (re)starting
-    if (_csvFile->isOpen())
-        _csvFile->close();
+    _recorder->stop();
     if (recording)
     {
-        static const QString DATETIME_FORMAT = "yyyy-MM-dd_hh-mm-ss-zzz";
-        const QString basePath = _recordingsDirectory.isEmpty() ? QDir::currentPath() : _recordingsDirectory; // TODO consolidate this
+        const int format = _actions->dataRecordFormatGroup->checkedAction()->data().toInt();
+        const QString basePath = _RecordingsDirectory();
         const QString dateStr = QDateTime::currentDateTime().toString(DATETIME_FORMAT); // TODO use UTC version?
         static const int RETRY_COUNT = 3;
-        for (int attempt = 0; !_csvFile->isOpen() && attempt < RETRY_COUNT; attempt++)
+        QStringList filePaths;
+        for (int attempt = 0; attempt < RETRY_COUNT; attempt++)
         {
             QString fileName = "data_" + dateStr;
             if (attempt > 0)
                 fileName += "_" + QString::number(attempt);
-            fileName += ".csv";
-            const QString filePath = QDir::cleanPath(basePath + "/" + fileName);
-            _csvFile->setFileName(filePath);
-#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
-            _csvFile->open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::NewOnly);
-#else
-            if (QFileInfo::exists(_csvFile->fileName()))
-                continue;
-            _csvFile->open(QIODevice::WriteOnly | QIODevice::Text);
-#endif
-        }
-        if (!_csvFile->isOpen())
-        {
-            QMessageBox::critical(this, "Error opening recording file", "Couldn't open \"" + _csvFile->fileName() + "\" for writing!");
-            _actions->dataRecord->setChecked(false);
-            return;
+            fileName += QString(".") + ((format == RECORDING_FORMAT_NATIVE) ? RECORDING_FILE_SUFFIX : RECORDING_CSV_SUFFIX);
+            filePaths.append(QDir::cleanPath(basePath + "/" + fileName));
         }
+        // NOTE: the file is opened on the writer thread, so the GUI never
+        //       waits for the disk; the toggle stays unchecked until it is
+        const QSignalBlocker blocker(_actions->dataRecord);
+        _actions->dataRecord->setChecked(false);
+        _recorder->start(filePaths, format);
+        if (_configDialog->hasConfig())
+            _recorder->setConfigCRC(_configDialog->configChecksum());
     }
 }
 
+void MainWindow::slot_RecordingStarted()
+{
+    const QSignalBlocker blocker(_actions->dataRecord);
+    _actions->dataRecord->setChecked(true);
+}
+
+void MainWindow::slot_RecordingStartFailed(const QString &filePath)
+{
+    QMessageBox::critical(this, "Error opening recording file", "Couldn't open \"" + filePath + "\" for writing!");
+}
+
+void MainWindow::slot_DataCaptureToggled(bool capturing)
+{
+    if (!capturing)
+    {
+        _serialConnection->stopCapture();
+        if (!_captureFilePath.isEmpty())
+            _AddReplayFile(_captureFilePath);
+        _captureFilePath.clear();
+        return;
+    }
+    const QString dateStr = QDateTime::currentDateTime().toString(DATETIME_FORMAT);
+    const QString filePath = QDir::cleanPath(_RecordingsDirectory() + "/capture_" + dateStr + "." + CAPTURE_FILE_SUFFIX);
+    if (!_serialConnection->startCapture(filePath))
+    {
+        QMessageBox::critical(this, "Error opening capture file", "Couldn't open \"" + filePath + "\" for writing!");
+        _actions->dataCapture->setChecked(false);
+        return;
+    }
+    _captureFilePath = filePath;
+}
+
+void MainWindow::slot_DataConvertRecordingClicked()
+{
+    const QString recordingPath = QFileDialog::getOpenFileName(this, tr("Convert Recording"), _RecordingsDirectory(), QString("Servoterm recordings (*.") + RECORDING_FILE_SUFFIX + ");;All files (*)");
+    if (recordingPath.isEmpty())
+        return;
+    const QFileInfo recordingInfo(recordingPath);
+    const QString csvPath = QDir::cleanPath(recordingInfo.absolutePath() + "/" + recordingInfo.completeBaseName() + "." + RECORDING_CSV_SUFFIX);
+    if (QFileInfo::exists(csvPath) && QMessageBox::question(this, "Convert Recording", "\"" + csvPath + "\" already exists, overwrite it?") != QMessageBox::Yes)
+        return;
+    _actions->dataConvertRecording->setEnabled(false); // NOTE: one conversion at a time
+    statusBar()->showMessage("Converting \"" + recordingPath + "\"...");
+    QMetaObject::invokeMethod(_converter, "convert", Q_ARG(QString, recordingPath), Q_ARG(QString, csvPath));
+}
+
+void MainWindow::slot_RecordingConversionProgress(int percent)
+{
+    statusBar()->showMessage(QString("Converting recording... %1%").arg(percent));
+}
+
+void MainWindow::slot_RecordingConverted(bool converted, const QString &recordingPath, const QString &csvPath)
+{
+    _actions->dataConvertRecording->setEnabled(true);
+    if (converted)
+    {
+        statusBar()->showMessage("Converted recording to \"" + csvPath + "\"", STATUS_MESSAGE_TIMEOUT_MS);
+        return;
+    }
+    statusBar()->clearMessage();
+    QMessageBox::critical(this, "Error converting recording", "Couldn't read \"" + recordingPath + "\" or write \"" + csvPath + "\"!");
+}
+
 void MainWindow::slot_DataSetDirectoryClicked()
 {
     const QString dirPath = QFileDialog::getExistingDirectory(this, tr("Open Directory"), _recordingsDirectory, QFileDialog::ShowDirsOnly);
@@ -318,7 +543,7 @@ void MainWindow::slot_DataSetDirectoryClicked()
 
 void MainWindow::slot_DataOpenDirectoryClicked()
 {
-    QDesktopServices::openUrl(QUrl::fromLocalFile(_recordingsDirectory.isEmpty() ? QDir::currentPath() : _recordingsDirectory)); // TODO consolidate this
+    QDesktopServices::openUrl(QUrl::fromLocalFile(_RecordingsDirectory()));
 }
 
 void MainWindow::slot_SendClicked()
@@ -346,9 +571,9 @@ void MainWindow::slot_SerialDisconnected()
     AppendTextToEdit(*_textLog, &QTextEdit::insertPlainText, "\n");
 }
 
-void MainWindow::slot_LogLine(const QString &line)
+void MainWindow::slot_LogLines(const QString &lines)
 {
-    AppendTextToEdit(*_textLog, &QTextEdit::insertHtml, line);
+    AppendPlainTextToEdit(*_textLog, lines);
 }
 
 void MainWindow::slot_LogError(const QString &errorMessage)
@@ -357,19 +582,13 @@ void MainWindow::slot_LogError(const QString &errorMessage)
     AppendTextToEdit(*_textLog, &QTextEdit::insertPlainText, "\n");
 }
 
-void MainWindow::slot_ScopePacketReceived(const QVector<float> &packet)
+void MainWindow::slot_ScopePacketsReceived(const ScopeSampleBlock &block)
 {
-    _oscilloscope->addChannelsSample(packet);
-    _xyOscilloscope->addChannelsSample(packet);
-    if (_csvFile->isOpen() && !packet.isEmpty())
-    {
-        QStringList fields;
-        for (QVector<float>::const_iterator it = packet.begin(); it != packet.end(); ++it)
-        {
-            fields.append(QString::number(*it, 'f'));
-        }
-        _csvFile->write((fields.join(',') + "\n").toUtf8());
-    }
+    _frameClock->addPackets(block.packetCount());
+    _oscilloscope->addChannelsSamples(block);
+    _xyOscilloscope->addChannelsSamples(block);
+    _spectrumView->addChannelsSamples(block);
+    _recorder->append(block); // NOTE: only copies it, the writing happens on another thread
 }
 
 void MainWindow::slot_ScopeResetReceived()
@@ -378,6 +597,19 @@ void MainWindow::slot_ScopeResetReceived()
     _xyOscilloscope->resetScanning();
 }
 
+void MainWindow::slot_ScopeChannelCountChanged(int channelCount)
+{
+    _oscilloscope->setChannelCount(channelCount);
+    _triggerToolBar->setChannelCount(channelCount);
+    _spectrumView->setChannelCount(channelCount);
+    for (int channel = 0; channel < _actions->viewSpectrumChannels.size(); channel++)
+        _actions->viewSpectrumChannels[channel]->setEnabled(channel < channelCount);
+    // a recording has the same channels throughout, so start a new one
+    if (_recorder->isRecording() && _recorder->format() == RECORDING_FORMAT_NATIVE)
+        slot_DataRecordToggled(true);
+    slot_UpdateLinkStatus();
+}
+
 void MainWindow::slot_UpdateButtons()
 {
     const bool portSelected = !_portList->currentText().isEmpty();
@@ -393,8 +625,13 @@ void MainWindow::slot_UpdateButtons()
     _actions->driveDisable->setEnabled(portOpen);
     _actions->driveEditConfig->setEnabled(portOpen);
     _actions->dataRecord->setEnabled(portOpen);
+    _actions->dataCapture->setEnabled(portOpen);
     if (!portOpen)
+    {
         _actions->dataRecord->setChecked(false);
+        _recorder->stop(); // NOTE: also one still being opened, its toggle isn't checked yet
+        _actions->dataCapture->setChecked(false);
+    }
     _sendButton->setEnabled(portOpen && hasCommand);
 }
 
@@ -443,6 +680,27 @@ void MainWindow::slot_SendJogCommand()
         _jogTimer->start();
 }
 
+void MainWindow::slot_UpdateLinkStatus()
+{
+    // NOTE: resyncs/discarded point at the link, dropped at the GUI not keeping up
+    const ScopeDataDemux::Counters counters = _serialConnection->demuxCounters();
+    const double packetPeriod = _serialConnection->scopePacketPeriod();
+    const FrameClock::Stats frameStats = _frameClock->stats();
+    _linkStatusLabel->setText(QString("channels: %1 (%2-bit)  rate: %3  frames: %4  resyncs: %5  crc errors: %6  discarded: %7 B  resets: %8  dropped: %9  fps: %10 (%11 packets/frame)  recording dropped: %12")
+        .arg(_serialConnection->scopeChannelCount())
+        .arg(counters.extendedFrames > 0 ? 16 : 8)
+        .arg(packetPeriod > 0.0 ? QString("%1 Hz").arg(1.0/packetPeriod, 0, 'f', 1) : QString("?"))
+        .arg(counters.goodFrames)
+        .arg(counters.resyncs)
+        .arg(counters.crcErrors)
+        .arg(counters.discardedBytes)
+        .arg(counters.resetMarkers)
+        .arg(_serialConnection->droppedScopePackets())
+        .arg(frameStats.framesPerSecond, 0, 'f', 1)
+        .arg(frameStats.packetsPerFrame, 0, 'f', 1)
+        .arg(_recorder->droppedPackets()));
+}
+
 void MainWindow::dragEnterEvent(QDragEnterEvent *event)
 {
     // if (event->mimeData().hasUrls())
@@ -546,8 +804,12 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
 
 void MainWindow::_RepopulateDeviceList()
 {
-    // build new list of ports
-    const QStringList portNames = SerialConnection::getSerialPortNames();
+    // build new list of ports, followed by the captures that can be replayed
+    QStringList portNames = SerialConnection::getSerialPortNames();
+    for (QStringList::const_iterator it = _replayFiles.begin(); it != _replayFiles.end(); ++it)
+    {
+        portNames.append(SerialConnection::replayPortName(*it));
+    }
 
     // build old list of ports
     QStringList oldPortNames;
@@ -584,11 +846,71 @@ void MainWindow::_RepopulateDeviceList()
     }
 }
 
+void MainWindow::_AddReplayFile(const QString &filePath)
+{
+    _replayFiles.removeAll(filePath);
+    _replayFiles.prepend(filePath);
+    while (_replayFiles.size() > MAXIMUM_REPLAY_FILES)
+        _replayFiles.removeLast();
+    _RepopulateDeviceList();
+}
+
+QString MainWindow::_RecordingsDirectory() const
+{
+    return _recordingsDirectory.isEmpty() ? QDir::currentPath() : _recordingsDirectory;
+}
+
+QAction * MainWindow::_CheckActionWithData(QActionGroup *group, const QVariant &value)
+{
+    QList<QAction*> acts = group->actions();
+    for (QList<QAction*>::const_iterator it = acts.begin(); it != acts.end(); ++it)
+    {
+        if ((*it)->data() == value)
+        {
+            (*it)->setChecked(true);
+            return *it;
+        }
+    }
+    return nullptr;
+}
+
 void MainWindow::_saveSettings()
 {
     _settings->beginGroup("MainWindow");
     _settings->setValue("geometry", saveGeometry());
     _settings->setValue("windowState", saveState());
+    _settings->setValue("replayFiles", _replayFiles);
+    _settings->setValue("recordingFormat", _actions->dataRecordFormatGroup->checkedAction()->data());
+    _settings->setValue("scopeChannelCount", _actions->dataChannelsGroup->checkedAction()->data());
+    _settings->setValue("scopeHistoryMegabytes", _actions->dataHistoryGroup->checkedAction()->data());
+    _settings->setValue("scopePacketsPerColumn", _actions->viewTimebaseGroup->checkedAction()->data());
+    _settings->setValue("frameRateCap", _actions->viewFrameRateGroup->checkedAction()->data());
+    _settings->setValue("scopeAutoscale", _actions->viewAutoscaleOscilloscope->isChecked());
+    _settings->setValue("spectrumFftSize", _actions->viewSpectrumSizeGroup->checkedAction()->data());
+    _settings->setValue("spectrumWindow", _actions->viewSpectrumWindowGroup->checkedAction()->data());
+    _settings->setValue("spectrumAveraging", _actions->viewSpectrumAveragingGroup->checkedAction()->data());
+    _settings->setValue("spectrumPeakHold", _actions->viewSpectrumPeakHold->isChecked());
+    _settings->setValue("xyMode", _actions->viewXYModeGroup->checkedAction()->data());
+    _settings->setValue("xyDensityMapping", _actions->viewXYDensityMappingGroup->checkedAction()->data());
+    _settings->setValue("xyDensityHalfLife", _actions->viewXYDensityDecayGroup->checkedAction()->data());
+    _settings->setValue("xyChannelPairs", XYChannelPairsToString(_xyOscilloscope->channelPairs()));
+    {
+        int channelMask = 0;
+        for (int channel = 0; channel < _actions->viewSpectrumChannels.size(); channel++)
+        {
+            if (_actions->viewSpectrumChannels[channel]->isChecked())
+                channelMask |= 1 << channel;
+        }
+        _settings->setValue("spectrumChannelMask", channelMask);
+    }
+    {
+        const ScopeTriggerSettings trigger = _triggerToolBar->settings();
+        _settings->setValue("triggerMode", static_cast<int>(trigger.mode));
+        _settings->setValue("triggerSlope", static_cast<int>(trigger.slope));
+        _settings->setValue("triggerChannel", trigger.channel);
+        _settings->setValue("triggerLevel", trigger.level);
+        _settings->setValue("triggerHysteresis", trigger.hysteresis);
+    }
     _settings->endGroup();
     _settings->beginGroup("ConfigDialog");
     _settings->setValue("geometry", _configDialog->saveGeometry());
@@ -600,7 +922,63 @@ void MainWindow::_loadSettings()
     _settings->beginGroup("MainWindow");
     restoreGeometry(_settings->value("geometry").toByteArray());
     restoreState(_settings->value("windowState").toByteArray());
+    _replayFiles = _settings->value("replayFiles").toStringList();
+    const int recordingFormat = _settings->value("recordingFormat", RECORDING_FORMAT_NATIVE).toInt();
+    _CheckActionWithData(_actions->dataRecordFormatGroup, recordingFormat);
+    const int scopeChannelCount = _settings->value("scopeChannelCount", 0).toInt();
+    if (_CheckActionWithData(_actions->dataChannelsGroup, scopeChannelCount))
+        _serialConnection->setScopeChannelCount(scopeChannelCount);
+    const int scopeHistoryMegabytes = _settings->value("scopeHistoryMegabytes", 64).toInt();
+    if (_CheckActionWithData(_actions->dataHistoryGroup, scopeHistoryMegabytes))
+        _oscilloscope->setHistoryBudget(static_cast<qint64>(scopeHistoryMegabytes) << 20);
+    const int scopePacketsPerColumn = _settings->value("scopePacketsPerColumn", 1).toInt();
+    if (_CheckActionWithData(_actions->viewTimebaseGroup, scopePacketsPerColumn))
+        _oscilloscope->setPacketsPerColumn(scopePacketsPerColumn);
+    const int frameRateCap = _settings->value("frameRateCap", 0).toInt();
+    if (_CheckActionWithData(_actions->viewFrameRateGroup, frameRateCap))
+        _frameClock->setFrameRateCap(frameRateCap);
+    const int spectrumFftSize = _settings->value("spectrumFftSize", 4096).toInt();
+    if (_CheckActionWithData(_actions->viewSpectrumSizeGroup, spectrumFftSize))
+        _spectrumView->setFftSize(spectrumFftSize);
+    const int spectrumWindow = _settings->value("spectrumWindow", 0).toInt();
+    if (_CheckActionWithData(_actions->viewSpectrumWindowGroup, spectrumWindow))
+        _spectrumView->setWindow(spectrumWindow);
+    const int spectrumAveraging = _settings->value("spectrumAveraging", 1).toInt();
+    if (_CheckActionWithData(_actions->viewSpectrumAveragingGroup, spectrumAveraging))
+        _spectrumView->setAveraging(spectrumAveraging);
+    const int xyMode = _settings->value("xyMode", 0).toInt();
+    if (_CheckActionWithData(_actions->viewXYModeGroup, xyMode))
+        _xyOscilloscope->setMode(xyMode);
+    const int xyDensityMapping = _settings->value("xyDensityMapping", 0).toInt();
+    if (_CheckActionWithData(_actions->viewXYDensityMappingGroup, xyDensityMapping))
+        _xyOscilloscope->setDensityMapping(xyDensityMapping);
+    const int xyDensityHalfLife = _settings->value("xyDensityHalfLife", 2000).toInt();
+    if (_CheckActionWithData(_actions->viewXYDensityDecayGroup, xyDensityHalfLife))
+        _xyOscilloscope->setDensityHalfLife(xyDensityHalfLife);
+    {
+        const QVector<XYChannelPair> xyChannelPairs = XYChannelPairsFromString(_settings->value("xyChannelPairs").toString());
+        if (!xyChannelPairs.isEmpty())
+            _xyOscilloscope->setChannelPairs(xyChannelPairs);
+    }
+    _actions->viewAutoscaleOscilloscope->setChecked(_settings->value("scopeAutoscale", false).toBool());
+    _actions->viewSpectrumPeakHold->setChecked(_settings->value("spectrumPeakHold", false).toBool());
+    {
+        const int channelMask = _settings->value("spectrumChannelMask", 1).toInt();
+        for (int channel = 0; channel < _actions->viewSpectrumChannels.size(); channel++)
+            _actions->viewSpectrumChannels[channel]->setChecked(channelMask & (1 << channel));
+        slot_SpectrumChannelsChanged();
+    }
+    {
+        ScopeTriggerSettings trigger;
+        trigger.mode = static_cast<ScopeTriggerMode>(_settings->value("triggerMode", trigger.mode).toInt());
+        trigger.slope = static_cast<ScopeTriggerSlope>(_settings->value("triggerSlope", trigger.slope).toInt());
+        trigger.channel = _settings->value("triggerChannel", trigger.channel).toInt();
+        trigger.level = _settings->value("triggerLevel", trigger.level).toFloat();
+        trigger.hysteresis = _settings->value("triggerHysteresis", trigger.hysteresis).toFloat();
+        _triggerToolBar->setSettings(trigger);
+    }
     _settings->endGroup();
+    _RepopulateDeviceList();
     _settings->beginGroup("ConfigDialog");
     _configDialog->restoreGeometry(_settings->value("geometry").toByteArray());
     _settings->endGroup();
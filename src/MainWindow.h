@@ -20,6 +20,8 @@
 #ifndef STMBL_SERVOTERM_MAINWINDOW_H
 #define STMBL_SERVOTERM_MAINWINDOW_H
 
+#include "ScopeSampleBlock.h"
+
 #include <QMainWindow>
 #include <QStringList>
 
@@ -31,6 +33,11 @@ class QShortcut;
 class QSettings;
 class QTimer;
 class QFile;
+class QLabel;
+class QAction;
+class QActionGroup;
+class QVariant;
+class QThread;
 QT_END_NAMESPACE
 
 namespace STMBL_Servoterm {
@@ -41,8 +48,14 @@ class ClickableComboBox;
 class ConfigDialog;
 class Oscilloscope;
 class XYOscilloscope;
+class SpectrumView;
+class ScopeMeasurements;
 class HistoryLineEdit;
 class SerialConnection;
+class FrameClock;
+class TriggerToolBar;
+class ScopeRecorder;
+class ScopeRecordingConverter;
 
 class MainWindow : public QMainWindow
 {
@@ -59,18 +72,40 @@ protected slots:
     void slot_EmergencyStop();
     void slot_DisableClicked();
     void slot_EnableClicked();
+    void slot_OpenCaptureClicked();
+    void slot_ReplaySpeedSelected(QAction *act);
     void slot_DataRecordToggled(bool recording);
+    void slot_RecordingStarted();
+    void slot_RecordingStartFailed(const QString &filePath);
+    void slot_DataCaptureToggled(bool capturing);
+    void slot_DataConvertRecordingClicked();
+    void slot_RecordingConversionProgress(int percent);
+    void slot_RecordingConverted(bool converted, const QString &recordingPath, const QString &csvPath);
+    void slot_DataChannelsSelected(QAction *act);
+    void slot_HistoryBudgetSelected(QAction *act);
+    void slot_TimebaseSelected(QAction *act);
+    void slot_FrameRateSelected(QAction *act);
+    void slot_SpectrumSizeSelected(QAction *act);
+    void slot_SpectrumWindowSelected(QAction *act);
+    void slot_SpectrumAveragingSelected(QAction *act);
+    void slot_SpectrumChannelsChanged();
+    void slot_XYModeSelected(QAction *act);
+    void slot_XYDensityMappingSelected(QAction *act);
+    void slot_XYDensityDecaySelected(QAction *act);
+    void slot_XYChannelPairsClicked();
     void slot_DataSetDirectoryClicked();
     void slot_DataOpenDirectoryClicked();
     void slot_SendClicked();
     void slot_SerialConnected();
     void slot_SerialDisconnected();
-    void slot_LogLine(const QString &line);
+    void slot_LogLines(const QString &lines);
     void slot_LogError(const QString &errorMessage);
-    void slot_ScopePacketReceived(const QVector<float> &packet);
+    void slot_ScopePacketsReceived(const STMBL_Servoterm::ScopeSampleBlock &block);
     void slot_ScopeResetReceived();
+    void slot_ScopeChannelCountChanged(int channelCount);
     void slot_UpdateButtons();
     void slot_SendJogCommand();
+    void slot_UpdateLinkStatus();
 protected:
     void dragEnterEvent(QDragEnterEvent *event);
     void dragMoveEvent(QDragMoveEvent *event);
@@ -79,6 +114,9 @@ protected:
     void closeEvent(QCloseEvent *event);
     bool eventFilter(QObject *obj, QEvent *event);
     void _RepopulateDeviceList();
+    void _AddReplayFile(const QString &filePath);
+    QString _RecordingsDirectory() const;
+    QAction * _CheckActionWithData(QActionGroup *group, const QVariant &value); // NOTE: nullptr if no action has it
     void _saveSettings();
     void _loadSettings();
 
@@ -88,13 +126,21 @@ protected:
     ClickableComboBox *_portList;
     Oscilloscope *_oscilloscope;
     XYOscilloscope *_xyOscilloscope;
+    SpectrumView *_spectrumView;
+    ScopeMeasurements *_measurements;
+    FrameClock *_frameClock;
+    TriggerToolBar *_triggerToolBar;
     QTextEdit *_textLog;
     HistoryLineEdit *_lineEdit;
     QPushButton *_sendButton;
     QSettings *_settings;
     ConfigDialog *_configDialog;
     QTimer *_jogTimer;
-    QFile *_csvFile;
+    ScopeRecorder *_recorder;
+    QThread *_converterThread;
+    ScopeRecordingConverter *_converter;
+    QLabel *_linkStatusLabel;
+    QTimer *_linkStatusTimer;
     
     QShortcut *_estopShortcut;
     bool _leftPressed;
@@ -106,6 +152,8 @@ protected:
         JOGGING_CCW
     } _jogState;
     QString _recordingsDirectory;
+    QStringList _replayFiles;
+    QString _captureFilePath;
 };
 
 } // namespace STMBL_Servoterm
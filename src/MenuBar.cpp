@@ -34,6 +34,13 @@ MenuBar::MenuBar(Actions *actions, QWidget *parent) : QMenuBar(parent)
     portMenu = connectionMenu->addMenu("Port");
     portGroup = new QActionGroup(this);
     portGroup->setExclusive(true);
+    connectionMenu->addSeparator();
+    connectionMenu->addAction(actions->connectionOpenCapture);
+    QMenu * const replaySpeedMenu = connectionMenu->addMenu("Replay Speed");
+    replaySpeedMenu->addAction(actions->connectionReplaySpeedRealTime);
+    replaySpeedMenu->addAction(actions->connectionReplaySpeed2x);
+    replaySpeedMenu->addAction(actions->connectionReplaySpeed10x);
+    replaySpeedMenu->addAction(actions->connectionReplaySpeedUnlimited);
 
     QMenu * const driveMenu = addMenu("Drive");
     driveMenu->addAction(actions->driveEnable);
@@ -45,6 +52,20 @@ MenuBar::MenuBar(Actions *actions, QWidget *parent) : QMenuBar(parent)
     
     QMenu * const dataMenu = addMenu("Data");
     dataMenu->addAction(actions->dataRecord);
+    dataMenu->addAction(actions->dataCapture);
+    QMenu * const recordFormatMenu = dataMenu->addMenu("Recording Format");
+    recordFormatMenu->addAction(actions->dataRecordFormatNative);
+    recordFormatMenu->addAction(actions->dataRecordFormatCsv);
+    dataMenu->addAction(actions->dataConvertRecording);
+    QMenu * const channelsMenu = dataMenu->addMenu("Scope Channels");
+    channelsMenu->addAction(actions->dataChannelsAuto);
+    channelsMenu->addAction(actions->dataChannels4);
+    channelsMenu->addAction(actions->dataChannels8);
+    channelsMenu->addAction(actions->dataChannels16);
+    QMenu * const historyMenu = dataMenu->addMenu("Scope History Memory");
+    historyMenu->addAction(actions->dataHistory64);
+    historyMenu->addAction(actions->dataHistory256);
+    historyMenu->addAction(actions->dataHistory1024);
     dataMenu->addSeparator();
     dataMenu->addAction(actions->dataSetDirectory);
     dataMenu->addAction(actions->dataOpenDirectory);
@@ -52,8 +73,56 @@ MenuBar::MenuBar(Actions *actions, QWidget *parent) : QMenuBar(parent)
     QMenu * const viewMenu = addMenu("&View");
     viewMenu->addAction(actions->viewOscilloscope);
     viewMenu->addAction(actions->viewXYScope);
+    viewMenu->addAction(actions->viewSpectrum);
+    viewMenu->addAction(actions->viewMeasurements);
     viewMenu->addAction(actions->viewConsole);
     viewMenu->addSeparator();
+    viewMenu->addAction(actions->viewPauseOscilloscope);
+    viewMenu->addAction(actions->viewAutoscaleOscilloscope);
+    QMenu * const timebaseMenu = viewMenu->addMenu("Oscilloscope Timebase");
+    timebaseMenu->addAction(actions->viewTimebase1);
+    timebaseMenu->addAction(actions->viewTimebase10);
+    timebaseMenu->addAction(actions->viewTimebase100);
+    timebaseMenu->addAction(actions->viewTimebase1000);
+    QMenu * const frameRateMenu = viewMenu->addMenu("Scope Frame Rate");
+    frameRateMenu->addAction(actions->viewFrameRateDisplay);
+    frameRateMenu->addAction(actions->viewFrameRate30);
+    frameRateMenu->addAction(actions->viewFrameRate60);
+    frameRateMenu->addAction(actions->viewFrameRate120);
+    QMenu * const spectrumMenu = viewMenu->addMenu("Spectrum");
+    QMenu * const spectrumChannelsMenu = spectrumMenu->addMenu("Channels");
+    for (int channel = 0; channel < actions->viewSpectrumChannels.size(); channel++)
+        spectrumChannelsMenu->addAction(actions->viewSpectrumChannels[channel]);
+    QMenu * const spectrumSizeMenu = spectrumMenu->addMenu("FFT Length");
+    spectrumSizeMenu->addAction(actions->viewSpectrumSize1024);
+    spectrumSizeMenu->addAction(actions->viewSpectrumSize4096);
+    spectrumSizeMenu->addAction(actions->viewSpectrumSize16384);
+    spectrumSizeMenu->addAction(actions->viewSpectrumSize65536);
+    QMenu * const spectrumWindowMenu = spectrumMenu->addMenu("Window");
+    spectrumWindowMenu->addAction(actions->viewSpectrumWindowHann);
+    spectrumWindowMenu->addAction(actions->viewSpectrumWindowFlatTop);
+    QMenu * const spectrumAveragingMenu = spectrumMenu->addMenu("Averaging");
+    spectrumAveragingMenu->addAction(actions->viewSpectrumAveragingOff);
+    spectrumAveragingMenu->addAction(actions->viewSpectrumAveraging4);
+    spectrumAveragingMenu->addAction(actions->viewSpectrumAveraging16);
+    spectrumAveragingMenu->addAction(actions->viewSpectrumAveraging64);
+    spectrumMenu->addSeparator();
+    spectrumMenu->addAction(actions->viewSpectrumPeakHold);
+    spectrumMenu->addAction(actions->viewSpectrumResetPeaks);
+    QMenu * const xyMenu = viewMenu->addMenu("X/Y Scope");
+    xyMenu->addAction(actions->viewXYChannelPairs);
+    xyMenu->addSeparator();
+    xyMenu->addAction(actions->viewXYModePersistence);
+    xyMenu->addAction(actions->viewXYModeDensity);
+    xyMenu->addSeparator();
+    QMenu * const xyDensityMappingMenu = xyMenu->addMenu("Density Mapping");
+    xyDensityMappingMenu->addAction(actions->viewXYDensityLog);
+    xyDensityMappingMenu->addAction(actions->viewXYDensityGamma);
+    QMenu * const xyDensityDecayMenu = xyMenu->addMenu("Density Decay");
+    xyDensityDecayMenu->addAction(actions->viewXYDensityDecayOff);
+    xyDensityDecayMenu->addAction(actions->viewXYDensityDecaySlow);
+    xyDensityDecayMenu->addAction(actions->viewXYDensityDecayFast);
+    viewMenu->addSeparator();
     viewMenu->addAction(actions->viewClearConsole);
 }
 
@@ -18,130 +18,282 @@
 */
 
 #include "Oscilloscope.h"
+#include "OscilloscopeRenderer.h"
 
 #include <QPaintEvent>
 #include <QResizeEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
 #include <QPainter>
+#include <QThread>
 
 namespace STMBL_Servoterm {
 
-static const QColor SCOPE_CHANNEL_COLORS[SCOPE_CHANNEL_COUNT] =
+Oscilloscope::Oscilloscope(QWidget *parent) :
+    QWidget(parent),
+    _renderThread(new QThread(this)),
+    _renderer(new OscilloscopeRenderer),
+    _channelCount(SCOPE_CHANNEL_COUNT),
+    _packetsPerColumn(1),
+    _scopeX(0),
+    _paused(false),
+    _dragX(0),
+    _selectionStart(-1),
+    _selectionEnd(-1),
+    _wheelRemainder(0)
 {
-    Qt::black,
-    Qt::red,
-    Qt::blue,
-    Qt::green,
-    QColor(255, 128, 0),
-    QColor(128, 128, 64),
-    QColor(128, 64, 128),
-    QColor(64, 128, 128)
-};
+    qRegisterMetaType<STMBL_Servoterm::ScopeSampleBlock>();
+    qRegisterMetaType<STMBL_Servoterm::ScopeTriggerSettings>();
+    qRegisterMetaType<STMBL_Servoterm::ScopeStatisticsReport>();
+    setMinimumSize(600, 256);
+    // NOTE: the composited image covers every pixel, no need to clear them first
+    setAttribute(Qt::WA_OpaquePaintEvent);
+
+    _renderer->setFont(font());
+    _renderThread->setObjectName("ScopeRender");
+    _renderer->moveToThread(_renderThread);
+    connect(_renderer, &OscilloscopeRenderer::stripRendered, this, &Oscilloscope::slot_StripRendered);
+    connect(_renderer, &OscilloscopeRenderer::cursorMoved, this, &Oscilloscope::slot_CursorMoved);
+    connect(_renderer, &OscilloscopeRenderer::statisticsUpdated, this, &Oscilloscope::statisticsUpdated);
+    connect(_renderer, &OscilloscopeRenderer::errorMessage, this, &Oscilloscope::errorMessage);
+    _renderThread->start();
+}
 
-Oscilloscope::Oscilloscope(QWidget *parent) : QWidget(parent), _scopeX(0)
+Oscilloscope::~Oscilloscope()
 {
-    setMinimumSize(600, 256);
-    QPalette pal = palette();
-    pal.setColor(QPalette::Background, Qt::white);
-    setAutoFillBackground(true);
-    setPalette(pal);
+    _renderThread->quit();
+    _renderThread->wait();
+    delete _renderer; // NOTE: safe now that its thread is gone
+}
+
+int Oscilloscope::channelCount() const
+{
+    return _channelCount;
+}
+
+int Oscilloscope::packetsPerColumn() const
+{
+    return _packetsPerColumn;
+}
+
+bool Oscilloscope::isPaused() const
+{
+    return _paused;
+}
+
+void Oscilloscope::setChannelCount(int channelCount)
+{
+    channelCount = qBound(1, channelCount, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    if (channelCount == _channelCount)
+        return;
+    _channelCount = channelCount;
+    QMetaObject::invokeMethod(_renderer, "setChannelCount", Q_ARG(int, channelCount));
+}
+
+void Oscilloscope::setPacketsPerColumn(int packetsPerColumn)
+{
+    packetsPerColumn = qMax(1, packetsPerColumn);
+    if (packetsPerColumn == _packetsPerColumn)
+        return;
+    _packetsPerColumn = packetsPerColumn;
+    QMetaObject::invokeMethod(_renderer, "setPacketsPerColumn", Q_ARG(int, packetsPerColumn));
 }
 
 void Oscilloscope::addChannelsSample(const QVector<float> &channelsSample)
 {
-    if (channelsSample.size() != SCOPE_CHANNEL_COUNT) // sanity check
+    if (channelsSample.size() != _channelCount) // sanity check
         return;
+    ScopeSampleBlock block;
+    block.channelCount = _channelCount;
+    block.samples = channelsSample;
+    addChannelsSamples(block);
+}
 
-    // add/overwrite the appropriate sample
-    const int h = height();
-    // HACK for some reason, updating less than a 4 pixel wide strip results in flickering, I need to investigate...
-    update(_scopeX-1, 0, 4, h); // update affected lines
-    if (_scopeX < _channelsSamples.size())
-        _channelsSamples[_scopeX] = channelsSample;
-    else
-        _channelsSamples.append(channelsSample);
-
-    // update the next position to write to
-    // NOTE: has the side effect of updating the region
-    //       where we just layed down a sample
-    if (_scopeX+1 >= width())
-        _SetScopeX(0);
-    else
-        _SetScopeX(_scopeX + 1);
+void Oscilloscope::addChannelsSamples(const ScopeSampleBlock &block)
+{
+    if (block.channelCount != _channelCount || block.isEmpty()) // sanity check
+        return;
+    // NOTE: the samples are implicitly shared, so this doesn't copy them
+    QMetaObject::invokeMethod(_renderer, "addSamples", Q_ARG(STMBL_Servoterm::ScopeSampleBlock, block));
 }
 
 void Oscilloscope::resetScanning()
 {
-    _SetScopeX(0);
+    QMetaObject::invokeMethod(_renderer, "resetScanning");
 }
 
-static void DrawSampleRange(const QVector< QVector<float> > &channelsSamples, int start, int end, int h, QPainter &painter)
+void Oscilloscope::setPaused(bool paused)
 {
-    const int numSamples = end - start;
-    if (numSamples <= 0)
+    if (paused == _paused)
         return;
-    QPolygon points;
-    points.reserve(numSamples);
-    for (int channel = 0; channel < SCOPE_CHANNEL_COUNT; channel++)
+    _paused = paused;
+    setCursor(_paused ? Qt::OpenHandCursor : Qt::ArrowCursor);
+    if (!_paused)
+        _ClearSelection();
+    QMetaObject::invokeMethod(_renderer, "setPaused", Q_ARG(bool, paused));
+}
+
+void Oscilloscope::setHistoryBudget(qint64 bytes)
+{
+    QMetaObject::invokeMethod(_renderer, "setHistoryBudget", Q_ARG(qint64, bytes));
+}
+
+void Oscilloscope::setTriggerSettings(const ScopeTriggerSettings &settings)
+{
+    QMetaObject::invokeMethod(_renderer, "setTriggerSettings", Q_ARG(STMBL_Servoterm::ScopeTriggerSettings, settings));
+}
+
+void Oscilloscope::armTrigger()
+{
+    QMetaObject::invokeMethod(_renderer, "armTrigger");
+}
+
+void Oscilloscope::setAutoscale(bool autoscale)
+{
+    QMetaObject::invokeMethod(_renderer, "setAutoscale", Q_ARG(bool, autoscale));
+}
+
+void Oscilloscope::frameTick()
+{
+    // shows what the previous request brought, and asks for the next
+    if (!_dirtyRegion.isEmpty())
     {
-        points.resize(0);
-        for (int sample = start; sample < end; sample++)
-        {
-            const int x = sample;
-            const int y = qBound(0, static_cast<int>(h/2 - static_cast<float>(h/2)*channelsSamples[sample].at(channel)), h-1);
-            points.append(QPoint(x, y));
-        }
-        painter.setPen(SCOPE_CHANNEL_COLORS[channel]);
-        if (points.size() == 1)
-            painter.drawPoint(points.at(0));
-        else
-            painter.drawPolyline(points);
+        update(_dirtyRegion);
+        _dirtyRegion = QRegion();
     }
+    QMetaObject::invokeMethod(_renderer, "render");
 }
 
-void Oscilloscope::paintEvent(QPaintEvent *event)
+void Oscilloscope::slot_StripRendered(const QImage &strip, int x)
 {
-    Q_UNUSED(event);
+    QPainter painter(&_image);
+    painter.drawImage(x, 0, strip);
+    _dirtyRegion += QRect(x, 0, strip.width(), strip.height());
+}
 
-    QPainter painter(this);
-    // painter.setRenderHint(QPainter::Antialiasing);
+void Oscilloscope::slot_CursorMoved(int x)
+{
+    if (x == _scopeX)
+        return;
     const int h = height();
-    const int w = width();
-    painter.setPen(Qt::gray);
-    painter.drawLine(0, h/2, w-1, h/2);
+    _dirtyRegion += QRect(_scopeX, 0, 1, h);
+    _dirtyRegion += QRect(x, 0, 1, h);
+    _scopeX = x;
+}
 
-    // a very slight optimization
-    if (!_channelsSamples.isEmpty())
+void Oscilloscope::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    const QRect rect = event->rect();
+    painter.drawImage(rect, _image, rect);
+    if (_selectionStart >= 0)
     {
-        const int  firstX = qMax(0, event->rect().x()-1);
-        const int   lastX = qMin(event->rect().x()+event->rect().width(), _channelsSamples.size());
-        const int middleX = qBound(firstX, _scopeX, lastX);
-        DrawSampleRange(_channelsSamples,  firstX, middleX, h, painter);
-        DrawSampleRange(_channelsSamples, middleX,   lastX, h, painter);
+        const int left = qMin(_selectionStart, _selectionEnd);
+        const int right = qMax(_selectionStart, _selectionEnd);
+        painter.fillRect(left, 0, right - left + 1, height(), QColor(0, 0, 255, 48));
     }
+    if (_scopeX < 0)
+        return;
     painter.setPen(Qt::blue);
-    painter.drawLine(_scopeX, 0, _scopeX, h-1);
+    painter.drawLine(_scopeX, 0, _scopeX, height()-1);
 }
 
 void Oscilloscope::resizeEvent(QResizeEvent *event)
 {
-    const int w = event->size().width();
-
-    // possibly reduce the data window length
-    if (_channelsSamples.size() > w)
-        _channelsSamples.resize(w);
-    // make sure we're still inside the window
-    if (_scopeX >= _channelsSamples.size())
-        _SetScopeX(0);
+    // blank until the renderer catches up with the new size
+    _image = QImage(event->size(), QImage::Format_RGB32);
+    _image.fill(Qt::white);
+    QMetaObject::invokeMethod(_renderer, "setSize", Q_ARG(QSize, event->size()));
     QWidget::resizeEvent(event);
 }
 
-void Oscilloscope::_SetScopeX(int newX)
+void Oscilloscope::changeEvent(QEvent *event)
 {
-    const int h = height();
-    const int oldX = _scopeX;
-    _scopeX = newX;
-    update(oldX, 0, 1, h);
-    update(newX, 0, 1, h);
+    if (event->type() == QEvent::FontChange)
+        QMetaObject::invokeMethod(_renderer, "setFont", Q_ARG(QFont, font()));
+    QWidget::changeEvent(event);
+}
+
+void Oscilloscope::mousePressEvent(QMouseEvent *event)
+{
+    if (!_paused || (event->button() != Qt::LeftButton && event->button() != Qt::RightButton))
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    if (event->button() == Qt::RightButton)
+    {
+        _selectionStart = qBound(0, event->pos().x(), width()-1);
+        _selectionEnd = _selectionStart;
+        update();
+        return;
+    }
+    _dragX = event->pos().x();
+}
+
+void Oscilloscope::mouseMoveEvent(QMouseEvent *event)
+{
+    if (_paused && (event->buttons() & Qt::RightButton) && _selectionStart >= 0)
+    {
+        _selectionEnd = qBound(0, event->pos().x(), width()-1);
+        update();
+        return;
+    }
+    if (!_paused || !(event->buttons() & Qt::LeftButton))
+    {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+    // NOTE: dragging to the right brings older packets into view
+    const int columns = event->pos().x() - _dragX;
+    _dragX = event->pos().x();
+    if (columns != 0)
+        _ClearSelection(); // NOTE: it would be over other packets now
+    QMetaObject::invokeMethod(_renderer, "panView", Q_ARG(int, columns));
+}
+
+void Oscilloscope::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!_paused || event->button() != Qt::RightButton || _selectionStart < 0)
+    {
+        QWidget::mouseReleaseEvent(event);
+        return;
+    }
+    QMetaObject::invokeMethod(_renderer, "selectSpan", Q_ARG(int, _selectionStart), Q_ARG(int, _selectionEnd));
+}
+
+void Oscilloscope::wheelEvent(QWheelEvent *event)
+{
+    if (!_paused || event->angleDelta().y() == 0)
+    {
+        _wheelRemainder = 0;
+        QWidget::wheelEvent(event);
+        return;
+    }
+    // whole notches of 120, the rest waits for the next event
+    _wheelRemainder += event->angleDelta().y();
+    const int steps = _wheelRemainder/120;
+    _wheelRemainder -= steps*120;
+    if (steps == 0)
+        return;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    const int x = event->position().toPoint().x();
+#else
+    const int x = event->pos().x();
+#endif
+    // NOTE: rolling forward zooms in, around the mouse pointer
+    _ClearSelection();
+    QMetaObject::invokeMethod(_renderer, "zoomView", Q_ARG(int, -steps), Q_ARG(int, x));
+}
+
+void Oscilloscope::_ClearSelection()
+{
+    if (_selectionStart < 0)
+        return;
+    _selectionStart = -1;
+    _selectionEnd = -1;
+    update();
+    QMetaObject::invokeMethod(_renderer, "clearSpan");
 }
 
 } // namespace STMBL_Servoterm
@@ -21,25 +21,81 @@
 #define STMBL_SERVOTERM_OSCILLOSCOPE_H
 
 #include "globals.h"
+#include "ScopeSampleBlock.h"
+#include "ScopeTrigger.h"
+#include "ScopeStatistics.h"
 
 #include <QWidget>
+#include <QImage>
+#include <QRegion>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
 
 namespace STMBL_Servoterm {
 
+class OscilloscopeRenderer;
+
+// a sweeping Y-t display of every channel, where each pixel column
+// shows the range (minimum to maximum) of packetsPerColumn() packets,
+// so spikes shorter than a column still show up and painting costs the
+// same no matter how many packets that is
+// NOTE: the traces are rasterized by an OscilloscopeRenderer on its own
+//       thread, this only composites the strips it sends back and draws
+//       the cursor, so the GUI thread stays free for input; both happen
+//       once per frameTick()
+// while paused, the traces stop and the whole history can be looked
+// through instead: dragging pans, the mouse wheel zooms, and dragging
+// with the right button selects a span to measure
 class Oscilloscope : public QWidget
 {
     Q_OBJECT
 public:
     Oscilloscope(QWidget *parent = nullptr);
+    ~Oscilloscope();
+    int channelCount() const;
+    int packetsPerColumn() const;
+    bool isPaused() const;
 public slots:
+    void setChannelCount(int channelCount);
+    void setPacketsPerColumn(int packetsPerColumn);
     void addChannelsSample(const QVector<float> &channelsSample);
+    void addChannelsSamples(const STMBL_Servoterm::ScopeSampleBlock &block);
     void resetScanning();
+    void setPaused(bool paused);
+    void setHistoryBudget(qint64 bytes);
+    void setTriggerSettings(const STMBL_Servoterm::ScopeTriggerSettings &settings);
+    void armTrigger();
+    void setAutoscale(bool autoscale);
+    void frameTick(); // NOTE: nothing is repainted otherwise, see FrameClock
+signals:
+    void statisticsUpdated(const STMBL_Servoterm::ScopeStatisticsReport &report);
+    void errorMessage(const QString &errorMessage);
+protected slots:
+    void slot_StripRendered(const QImage &strip, int x);
+    void slot_CursorMoved(int x);
 protected:
     void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *event);
-    void _SetScopeX(int newX);
-    QVector< QVector<float> > _channelsSamples;
-    int _scopeX;
+    void changeEvent(QEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+    void _ClearSelection();
+    QThread *_renderThread;
+    OscilloscopeRenderer *_renderer;
+    QImage _image; // composited from the rendered strips
+    QRegion _dirtyRegion; // what changed since the last frame
+    int _channelCount;
+    int _packetsPerColumn;
+    int _scopeX; // NOTE: negative when there is no cursor
+    bool _paused;
+    int _dragX;
+    int _selectionStart; // NOTE: negative when nothing is selected
+    int _selectionEnd;
+    int _wheelRemainder; // NOTE: in eighths of a degree, touchpads scroll in bits much smaller than a notch
 };
 
 } // namespace STMBL_Servoterm
@@ -0,0 +1,810 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OscilloscopeRenderer.h"
+
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+static const QColor SCOPE_CHANNEL_COLORS[SCOPE_MAXIMUM_CHANNEL_COUNT] =
+{
+    Qt::black,
+    Qt::red,
+    Qt::blue,
+    Qt::green,
+    QColor(255, 128, 0),
+    QColor(128, 128, 64),
+    QColor(128, 64, 128),
+    QColor(64, 128, 128),
+    Qt::darkGray,
+    Qt::darkRed,
+    Qt::darkBlue,
+    Qt::darkGreen,
+    QColor(255, 0, 255),
+    QColor(0, 192, 192),
+    QColor(192, 160, 0),
+    QColor(128, 128, 255)
+};
+
+// the time grid lines are at least this far apart
+static const int MINIMUM_TIME_DIVISION_PIXELS = 80;
+
+// the part of a triggered frame from before the trigger
+static const int PRE_TRIGGER_DIVISOR = 4;
+
+// how often the measurements of the sweep go out
+static const int STATISTICS_INTERVAL_MS = 250;
+
+// a selected span is read out of the history this many packets at a time
+static const int SPAN_CHUNK_PACKETS = 4096;
+
+// autoscale fills this much of the height, and rescales once a trace
+// leaves it or shrinks below a third of it
+static const float AUTOSCALE_FILL = 0.9f;
+static const float AUTOSCALE_SHRINK = 0.3f;
+// the least half range it zooms in on, so a flat trace isn't all noise
+static const float AUTOSCALE_MINIMUM_RANGE = 1.0f/64.0f;
+
+// a 1, 2 or 5 times a power of ten number of seconds, with a unit that reads well
+static QString FormatSeconds(double seconds)
+{
+    if (seconds < 0.0)
+        return "-" + FormatSeconds(-seconds);
+    if (seconds >= 1.0)
+        return QString::number(seconds, 'g', 4) + " s";
+    if (seconds >= 1e-3)
+        return QString::number(seconds*1e3, 'g', 4) + " ms";
+    return QString::number(seconds*1e6, 'g', 4) + " " + QChar(0x00B5) + "s";
+}
+
+// the smallest 1/2/5 step that keeps the grid lines apart, 0 while unknown
+static double TimeDivision(double secondsPerColumn)
+{
+    if (secondsPerColumn <= 0.0)
+        return 0.0;
+    const double minimumDivision = MINIMUM_TIME_DIVISION_PIXELS*secondsPerColumn;
+    double decade = std::pow(10.0, std::floor(std::log10(minimumDivision)));
+    double division = decade;
+    if (division < minimumDivision)
+        division = 2.0*decade;
+    if (division < minimumDivision)
+        division = 5.0*decade;
+    if (division < minimumDivision)
+        division = 10.0*decade;
+    return division;
+}
+
+static inline int SampleToY(float sample, float gain, float offset, int h)
+{
+    return qBound(0, static_cast<int>(h/2 - static_cast<float>(h/2)*(sample - offset)*gain), h-1);
+}
+
+// NOTE: like the decode kernels, this is specialized for the common
+// channel counts, N = 0 is the generic version going by channelCount
+template<int N>
+static void DrawColumnRange(const float *columns, int channelCount, const float *gains, const float *offsets, int start, int end, int h, bool spans, QPainter &painter)
+{
+    const int stride = (N > 0) ? N : channelCount;
+    const int numColumns = end - start;
+    if (numColumns <= 0)
+        return;
+    QPolygon points;
+    points.reserve(spans ? 2*numColumns : numColumns);
+    for (int channel = 0; channel < stride; channel++)
+    {
+        points.resize(0);
+        const float gain = gains[channel];
+        const float offset = offsets[channel];
+        for (int x = start; x < end; x++)
+        {
+            const float * const column = columns + x*2*stride;
+            const int yMinimum = SampleToY(column[channel], gain, offset, h);
+            if (!spans)
+            {
+                points.append(QPoint(x, yMinimum));
+                continue;
+            }
+            // a vertical span per column, entered from the end
+            // nearest to where the previous one was left
+            const int yMaximum = SampleToY(column[stride + channel], gain, offset, h);
+            if (!points.isEmpty() && qAbs(points.last().y() - yMaximum) < qAbs(points.last().y() - yMinimum))
+            {
+                points.append(QPoint(x, yMaximum));
+                points.append(QPoint(x, yMinimum));
+            }
+            else
+            {
+                points.append(QPoint(x, yMinimum));
+                points.append(QPoint(x, yMaximum));
+            }
+        }
+        painter.setPen(SCOPE_CHANNEL_COLORS[channel]);
+        if (points.size() == 1)
+            painter.drawPoint(points.at(0));
+        else
+            painter.drawPolyline(points);
+    }
+}
+
+static void DrawColumnRange(const QVector<float> &columns, int channelCount, const QVector<float> &gains, const QVector<float> &offsets, int start, int end, int h, bool spans, QPainter &painter)
+{
+    switch (channelCount)
+    {
+        case 4:
+        DrawColumnRange<4>(columns.constData(), channelCount, gains.constData(), offsets.constData(), start, end, h, spans, painter);
+        break;
+
+        case 8:
+        DrawColumnRange<8>(columns.constData(), channelCount, gains.constData(), offsets.constData(), start, end, h, spans, painter);
+        break;
+
+        case 16:
+        DrawColumnRange<16>(columns.constData(), channelCount, gains.constData(), offsets.constData(), start, end, h, spans, painter);
+        break;
+
+        default:
+        DrawColumnRange<0>(columns.constData(), channelCount, gains.constData(), offsets.constData(), start, end, h, spans, painter);
+        break;
+    }
+}
+
+QColor ScopeChannelColor(int channel)
+{
+    return SCOPE_CHANNEL_COLORS[qBound(0, channel, SCOPE_MAXIMUM_CHANNEL_COUNT - 1)];
+}
+
+OscilloscopeRenderer::OscilloscopeRenderer(QObject *parent) :
+    QObject(parent),
+    _anyDirty(false),
+    _channelCount(SCOPE_CHANNEL_COUNT),
+    _packetsPerColumn(1),
+    _columnFill(0),
+    _scopeX(0),
+    _packetPeriod(0.0),
+    _timeDivision(0.0),
+    _historyShortReported(false),
+    _paused(false),
+    _viewEnd(0),
+    _viewPacketsPerColumn(1),
+    _statisticsPending(false),
+    _spanSelected(false),
+    _autoscale(false),
+    _triggerState(TRIGGER_WAITING),
+    _triggerPacket(0),
+    _triggerHoldoff(0),
+    _triggerWaitStart(0),
+    _framePacket(-1)
+{
+    _ResetScales();
+}
+
+void OscilloscopeRenderer::setSize(const QSize &size)
+{
+    if (size == _image.size())
+        return;
+    // possibly reduce the data window length
+    if (_ColumnCount() > size.width())
+        _samples.resize(size.width()*2*_channelCount);
+    // make sure we're still inside the window
+    if (_scopeX >= _ColumnCount())
+    {
+        _columnFill = 0;
+        _scopeX = 0;
+    }
+    const bool resized = (size.width() != _image.width());
+    _image = QImage(size, QImage::Format_RGB32);
+    _dirtyColumns.fill(0, size.width());
+    if (resized)
+        _ResetStatistics(); // NOTE: over another number of columns now
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::setFont(const QFont &font)
+{
+    _font = font;
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::setChannelCount(int channelCount)
+{
+    channelCount = qBound(1, channelCount, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    if (channelCount == _channelCount)
+        return;
+    // the old traces can't be reinterpreted, start over
+    _channelCount = channelCount;
+    _history.setChannelCount(channelCount);
+    _viewEnd = 0;
+    _framePacket = -1;
+    _ResetTrigger();
+    _Restart();
+}
+
+void OscilloscopeRenderer::setPacketsPerColumn(int packetsPerColumn)
+{
+    packetsPerColumn = qMax(1, packetsPerColumn);
+    if (packetsPerColumn == _packetsPerColumn)
+        return;
+    // the columns hold another span of time now, start over
+    _packetsPerColumn = packetsPerColumn;
+    _viewPacketsPerColumn = packetsPerColumn; // NOTE: a paused view follows along
+    _UpdateTimeDivision();
+    _Restart();
+}
+
+void OscilloscopeRenderer::addSamples(const ScopeSampleBlock &block)
+{
+    if (block.channelCount != _channelCount) // sanity check
+        return;
+    const int packetCount = block.packetCount();
+    if (packetCount == 0)
+        return;
+    // NOTE: kept even while paused, or before there's anything to show it on
+    qint64 firstPacket = static_cast<qint64>(_history.endPacket());
+    const int sampleBits = _history.sampleBits();
+    _history.append(block.samples.constData(), packetCount);
+    if (!_historyShortReported && _history.allocatedBudget() >= 0 && _history.allocatedBudget() < _history.budget())
+    {
+        _historyShortReported = true;
+        emit errorMessage(QString("Not enough memory for a %1 MB scope history, keeping %2 MB instead!")
+            .arg(_history.budget() >> 20).arg(_history.allocatedBudget() >> 20));
+    }
+    if (_history.sampleBits() != sampleBits)
+    {
+        // the history started over with wider codes
+        firstPacket = 0;
+        _viewEnd = 0;
+        _framePacket = -1;
+        _ResetTrigger();
+    }
+    if (_image.isNull())
+        return;
+    _SetPacketPeriod(block.packetPeriod);
+    _statisticsPending = true;
+    const bool triggered = (_trigger.settings().mode != SCOPE_TRIGGER_FREE_RUN);
+    if (triggered)
+        _ProcessTrigger(block.samples.constData(), packetCount, firstPacket);
+
+    // lay down all the samples, remembering which columns were touched
+    const int firstX = _scopeX;
+    const bool lapped = (_columnFill + packetCount >= _image.width()*_packetsPerColumn);
+    bool wrapped = false;
+    switch (_channelCount)
+    {
+        case 4:
+        _scopeX = _StoreSamples<4>(block.samples.constData(), packetCount, wrapped);
+        break;
+
+        case 8:
+        _scopeX = _StoreSamples<8>(block.samples.constData(), packetCount, wrapped);
+        break;
+
+        case 16:
+        _scopeX = _StoreSamples<16>(block.samples.constData(), packetCount, wrapped);
+        break;
+
+        default:
+        _scopeX = _StoreSamples<0>(block.samples.constData(), packetCount, wrapped);
+        break;
+    }
+    // NOTE: the sweep goes on underneath the paused or triggered
+    //       view, and is redone as a whole when it comes back
+    if (!_paused && !triggered)
+        _MarkDirty(firstX, _scopeX, wrapped, lapped);
+}
+
+void OscilloscopeRenderer::resetScanning()
+{
+    _columnFill = 0;
+    _scopeX = 0;
+    _anyDirty = true; // NOTE: at least the cursor moved
+}
+
+void OscilloscopeRenderer::setPaused(bool paused)
+{
+    if (paused == _paused)
+        return;
+    _paused = paused;
+    if (_paused)
+    {
+        // start out from what the sweep showed last
+        _viewEnd = static_cast<qint64>(_history.endPacket());
+        _viewPacketsPerColumn = _packetsPerColumn;
+    }
+    else
+    {
+        _spanSelected = false;
+    }
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::setHistoryBudget(qint64 bytes)
+{
+    if (bytes == _history.budget())
+        return;
+    _history.setBudget(bytes);
+    _historyShortReported = false;
+    _viewEnd = 0;
+    _framePacket = -1;
+    _ResetTrigger();
+    if (_paused || _trigger.settings().mode != SCOPE_TRIGGER_FREE_RUN)
+        _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::panView(int columns)
+{
+    if (!_paused || columns == 0)
+        return;
+    _viewEnd -= static_cast<qint64>(columns)*_viewPacketsPerColumn;
+    _ClampView();
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::zoomView(int steps, int anchorX)
+{
+    if (!_paused || _image.isNull())
+        return;
+    const int w = _image.width();
+    // NOTE: zoomed out no further than all of the history fitting on screen
+    const qint64 maximumPacketsPerColumn = qMax<qint64>(1, static_cast<qint64>((_history.capacity() + w - 1)/w));
+    qint64 packetsPerColumn = _viewPacketsPerColumn;
+    for (; steps > 0 && packetsPerColumn < maximumPacketsPerColumn; steps--)
+        packetsPerColumn = qMin(2*packetsPerColumn, maximumPacketsPerColumn);
+    for (; steps < 0 && packetsPerColumn > 1; steps++)
+        packetsPerColumn /= 2;
+    const qint64 anchorColumns = w - qBound(0, anchorX, w);
+    const qint64 anchorPacket = _viewEnd - anchorColumns*_viewPacketsPerColumn;
+    _viewPacketsPerColumn = static_cast<int>(packetsPerColumn);
+    _viewEnd = anchorPacket + anchorColumns*_viewPacketsPerColumn;
+    _ClampView();
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::setTriggerSettings(const ScopeTriggerSettings &settings)
+{
+    _trigger.setSettings(settings);
+    if (settings.mode == SCOPE_TRIGGER_FREE_RUN)
+        _framePacket = -1;
+    _ResetTrigger();
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::armTrigger()
+{
+    _ResetTrigger();
+}
+
+void OscilloscopeRenderer::setAutoscale(bool autoscale)
+{
+    if (autoscale == _autoscale)
+        return;
+    _autoscale = autoscale;
+    _ResetScales();
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::selectSpan(int firstX, int lastX)
+{
+    if (!_paused || _image.isNull())
+        return;
+    if (firstX > lastX)
+        qSwap(firstX, lastX);
+    _ClampView();
+    const qint64 viewFirst = _viewEnd - static_cast<qint64>(_image.width())*_viewPacketsPerColumn;
+    const qint64 first = qMax(viewFirst + static_cast<qint64>(qMax(0, firstX))*_viewPacketsPerColumn, static_cast<qint64>(_history.firstPacket()));
+    const qint64 end = qMin(viewFirst + static_cast<qint64>(lastX + 1)*_viewPacketsPerColumn, static_cast<qint64>(_history.endPacket()));
+
+    // NOTE: a single column, the span is measured once as a whole
+    ScopeStatistics statistics;
+    statistics.reset(_channelCount, 1);
+    QVector<float> packets(SPAN_CHUNK_PACKETS*_channelCount);
+    for (qint64 packet = first; packet < end; packet += SPAN_CHUNK_PACKETS)
+    {
+        const int count = static_cast<int>(qMin<qint64>(SPAN_CHUNK_PACKETS, end - packet));
+        _history.readPackets(static_cast<quint64>(packet), count, packets.data());
+        for (int i = 0; i < count; i++)
+            statistics.addPacket(packets.constData() + i*_channelCount);
+    }
+    ScopeStatisticsReport report = statistics.report(_packetPeriod);
+    report.selection = true;
+    _spanSelected = true;
+    emit statisticsUpdated(report);
+}
+
+void OscilloscopeRenderer::clearSpan()
+{
+    _spanSelected = false;
+}
+
+void OscilloscopeRenderer::render()
+{
+    if (_image.isNull())
+        return;
+    if (!_paused)
+    {
+        _EmitStatistics();
+        if (_autoscale)
+            _UpdateAutoscale();
+    }
+    if (!_anyDirty)
+        return;
+    _anyDirty = false;
+    if (_paused)
+    {
+        _RenderHistory();
+        emit stripRendered(_image.copy(), 0);
+        emit cursorMoved(-1);
+        return;
+    }
+    if (_trigger.settings().mode != SCOPE_TRIGGER_FREE_RUN)
+    {
+        // NOTE: the cursor marks the trigger
+        _RenderTriggered();
+        emit stripRendered(_image.copy(), 0);
+        emit cursorMoved(_framePacket >= 0 ? _PreTriggerColumns() : -1);
+        return;
+    }
+    // every run of changed columns goes out as one strip
+    const int w = _image.width();
+    const int h = _image.height();
+    char * const dirty = _dirtyColumns.data();
+    for (int first = 0; first < w; /* */)
+    {
+        if (!dirty[first])
+        {
+            first++;
+            continue;
+        }
+        int last = first;
+        while (last < w && dirty[last])
+            dirty[last++] = 0;
+        _RenderColumns(first, last);
+        emit stripRendered(_image.copy(first, 0, last - first, h), first);
+        first = last;
+    }
+    emit cursorMoved(_scopeX);
+}
+
+int OscilloscopeRenderer::_ColumnCount() const
+{
+    return _samples.size()/(2*_channelCount);
+}
+
+void OscilloscopeRenderer::_Restart()
+{
+    _samples.clear();
+    _columnFill = 0;
+    _scopeX = 0;
+    _ResetStatistics();
+    _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::_SetPacketPeriod(double packetPeriod)
+{
+    if (packetPeriod <= 0.0)
+        return; // NOTE: keep what was known, the estimate is only reset on (re)connecting
+    _packetPeriod = packetPeriod;
+    _UpdateTimeDivision();
+}
+
+void OscilloscopeRenderer::_UpdateTimeDivision()
+{
+    if (_packetPeriod <= 0.0)
+        return;
+    const double division = TimeDivision(_packetPeriod*_packetsPerColumn);
+    if (division != _timeDivision)
+    {
+        _timeDivision = division;
+        _MarkAllDirty(); // NOTE: the labels all change
+    }
+}
+
+void OscilloscopeRenderer::_MarkAllDirty()
+{
+    _dirtyColumns.fill(1);
+    _anyDirty = true;
+}
+
+void OscilloscopeRenderer::_MarkDirty(int firstX, int x, bool wrapped, bool lapped)
+{
+    // NOTE: the column before the first one is redone for the line coming
+    //       in from it, the one after the last for the line going out to it
+    const int w = _image.width();
+    const int first = firstX - 1;
+    const int last = x + 1 + (wrapped ? w : 0);
+    if (lapped || last - first + 1 >= w)
+    {
+        _MarkAllDirty();
+        return;
+    }
+    char * const dirty = _dirtyColumns.data();
+    for (int column = first; column <= last; column++)
+        dirty[(column + w) % w] = 1;
+    _anyDirty = true;
+}
+
+void OscilloscopeRenderer::_ClampView()
+{
+    // keep the screen as full as the history allows
+    const qint64 span = static_cast<qint64>(_image.width())*_viewPacketsPerColumn;
+    const qint64 end = static_cast<qint64>(_history.endPacket());
+    const qint64 earliest = qMin(end, static_cast<qint64>(_history.firstPacket()) + span);
+    _viewEnd = qBound(earliest, _viewEnd, end);
+}
+
+void OscilloscopeRenderer::_ResetStatistics()
+{
+    _statistics.reset(_channelCount, _image.width());
+    _statisticsPending = true;
+}
+
+void OscilloscopeRenderer::_EmitStatistics()
+{
+    if (!_statisticsPending || _spanSelected)
+        return;
+    if (_statisticsClock.isValid() && _statisticsClock.elapsed() < STATISTICS_INTERVAL_MS)
+        return;
+    _statisticsClock.start();
+    _statisticsPending = false;
+    emit statisticsUpdated(_statistics.report(_packetPeriod));
+}
+
+void OscilloscopeRenderer::_UpdateAutoscale()
+{
+    if (_statistics.packetCount() == 0)
+        return;
+    // only rescaled once a trace doesn't fit or has become
+    // too small, so it doesn't keep jumping around
+    bool changed = false;
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        _statistics.range(channel, minimum, maximum);
+        const float halfRange = qMax(0.5f*(maximum - minimum), AUTOSCALE_MINIMUM_RANGE);
+        const float shown = 1.0f/_gains[channel]; // half of what fits on screen
+        const float offset = _offsets[channel];
+        if (minimum >= offset - shown && maximum <= offset + shown && halfRange >= AUTOSCALE_SHRINK*shown)
+            continue;
+        _offsets[channel] = 0.5f*(minimum + maximum);
+        _gains[channel] = AUTOSCALE_FILL/halfRange;
+        changed = true;
+    }
+    if (changed)
+        _MarkAllDirty();
+}
+
+void OscilloscopeRenderer::_ResetScales()
+{
+    _gains.fill(1.0f, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    _offsets.fill(0.0f, SCOPE_MAXIMUM_CHANNEL_COUNT);
+}
+
+int OscilloscopeRenderer::_PreTriggerColumns() const
+{
+    return _image.width()/PRE_TRIGGER_DIVISOR;
+}
+
+void OscilloscopeRenderer::_ResetTrigger()
+{
+    // NOTE: only what comes in from now on can trigger
+    _trigger.reset();
+    _triggerState = TRIGGER_WAITING;
+    _triggerHoldoff = static_cast<qint64>(_history.endPacket());
+    _triggerWaitStart = _triggerHoldoff;
+}
+
+void OscilloscopeRenderer::_ProcessTrigger(const float *samples, int packetCount, qint64 firstPacket)
+{
+    const qint64 endPacket = firstPacket + packetCount;
+    const qint64 framePackets = static_cast<qint64>(_image.width())*_packetsPerColumn;
+    const qint64 postTriggerPackets = framePackets - static_cast<qint64>(_PreTriggerColumns())*_packetsPerColumn;
+    for (;;)
+    {
+        if (_triggerState == TRIGGER_WAITING)
+        {
+            const qint64 from = qMax(firstPacket, _triggerHoldoff);
+            if (from >= endPacket)
+                break;
+            const int found = _trigger.scan(samples + (from - firstPacket)*_channelCount, static_cast<int>(endPacket - from), _channelCount);
+            if (found >= 0)
+            {
+                _triggerPacket = from + found;
+                _triggerState = TRIGGER_CAPTURING;
+            }
+            else if (_trigger.settings().mode == SCOPE_TRIGGER_AUTO && endPacket - _triggerWaitStart >= framePackets)
+            {
+                // nothing for a whole screen, show what there is anyway
+                _triggerPacket = endPacket - postTriggerPackets;
+                _triggerState = TRIGGER_CAPTURING;
+            }
+            else
+            {
+                break;
+            }
+        }
+        else if (_triggerState == TRIGGER_CAPTURING)
+        {
+            if (endPacket < _triggerPacket + postTriggerPackets)
+                break;
+            // the frame is complete, show it and wait for the next one after it
+            _framePacket = _triggerPacket;
+            _triggerHoldoff = _triggerPacket + postTriggerPackets;
+            _triggerWaitStart = _triggerHoldoff;
+            _trigger.reset();
+            _triggerState = (_trigger.settings().mode == SCOPE_TRIGGER_SINGLE) ? TRIGGER_HELD : TRIGGER_WAITING;
+            if (!_paused)
+                _MarkAllDirty();
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+void OscilloscopeRenderer::_RenderColumns(int first, int last)
+{
+    const int h = _image.height();
+    const QRect strip(first, 0, last - first, h);
+    QPainter painter(&_image);
+    painter.setFont(_font);
+    painter.setClipRect(strip);
+    _DrawBackground(painter, strip, _packetPeriod*_packetsPerColumn, _timeDivision, 0.0);
+
+    // NOTE: the trace is cut at the cursor, so the newest
+    //       column doesn't get joined to the oldest one
+    const int  firstX = qMax(0, first-1);
+    const int   lastX = qMin(last, _ColumnCount());
+    const int middleX = qBound(firstX, _scopeX, qMax(firstX, lastX));
+    // NOTE: with one packet per column the minimum is all there is
+    const bool spans = (_packetsPerColumn > 1);
+    DrawColumnRange(_samples, _channelCount, _gains, _offsets,  firstX, middleX, h, spans, painter);
+    DrawColumnRange(_samples, _channelCount, _gains, _offsets, middleX,   lastX, h, spans, painter);
+}
+
+void OscilloscopeRenderer::_RenderHistory()
+{
+    _ClampView();
+    const qint64 first = _viewEnd - static_cast<qint64>(_image.width())*_viewPacketsPerColumn;
+    // NOTE: the time is counted back from the newest packet
+    _RenderFromHistory(first, _viewPacketsPerColumn, (first - static_cast<qint64>(_history.endPacket()))*_packetPeriod);
+}
+
+void OscilloscopeRenderer::_RenderTriggered()
+{
+    // NOTE: the time is counted from the trigger, and
+    //       there's just the grid until the first one
+    const int preTriggerColumns = _PreTriggerColumns();
+    const qint64 first = (_framePacket >= 0) ? _framePacket - static_cast<qint64>(preTriggerColumns)*_packetsPerColumn : static_cast<qint64>(_history.endPacket());
+    _RenderFromHistory(first, _packetsPerColumn, -preTriggerColumns*_packetPeriod*_packetsPerColumn);
+
+    // and the level it triggers at
+    const ScopeTriggerSettings &settings = _trigger.settings();
+    if (settings.channel >= _channelCount)
+        return;
+    const int y = SampleToY(settings.level, _gains[settings.channel], _offsets[settings.channel], _image.height());
+    QPainter painter(&_image);
+    painter.setPen(QPen(SCOPE_CHANNEL_COLORS[settings.channel], 0, Qt::DashLine));
+    painter.drawLine(0, y, _image.width()-1, y);
+}
+
+void OscilloscopeRenderer::_RenderFromHistory(qint64 first, int packetsPerColumn, double originSeconds)
+{
+    const int w = _image.width();
+    const int h = _image.height();
+    _viewColumns.resize(w*2*_channelCount);
+    int validFirst = 0;
+    int validLast = 0;
+    _history.readColumns(first, packetsPerColumn, w, _viewColumns.data(), validFirst, validLast);
+
+    QPainter painter(&_image);
+    painter.setFont(_font);
+    const double secondsPerColumn = _packetPeriod*packetsPerColumn;
+    _DrawBackground(painter, _image.rect(), secondsPerColumn, TimeDivision(secondsPerColumn), originSeconds);
+    DrawColumnRange(_viewColumns, _channelCount, _gains, _offsets, validFirst, validLast, h, packetsPerColumn > 1, painter);
+}
+
+void OscilloscopeRenderer::_DrawBackground(QPainter &painter, const QRect &rect, double secondsPerColumn, double timeDivision, double originSeconds)
+{
+    const int h = _image.height();
+    painter.fillRect(rect, Qt::white);
+    _DrawTimeGrid(painter, rect, secondsPerColumn, timeDivision, originSeconds);
+    painter.setPen(Qt::gray);
+    painter.drawLine(rect.left(), h/2, rect.right(), h/2);
+}
+
+void OscilloscopeRenderer::_DrawTimeGrid(QPainter &painter, const QRect &rect, double secondsPerColumn, double timeDivision, double originSeconds)
+{
+    if (timeDivision <= 0.0 || secondsPerColumn <= 0.0)
+        return;
+    const int h = _image.height();
+    const double pixelsPerDivision = timeDivision/secondsPerColumn;
+    const double originDivisions = originSeconds/timeDivision; // where x = 0 is
+    const int fontHeight = painter.fontMetrics().height();
+    const QPen gridPen(Qt::lightGray, 0, Qt::DotLine);
+    // NOTE: a label sticks out to the right of its line, so start one division early
+    const qint64 firstDivision = static_cast<qint64>(std::floor(originDivisions + rect.left()/pixelsPerDivision)) - 1;
+    for (qint64 division = firstDivision; ; division++)
+    {
+        const double x = (division - originDivisions)*pixelsPerDivision;
+        if (x > rect.right())
+            break;
+        const int ix = static_cast<int>(std::floor(x + 0.5));
+        painter.setPen(gridPen);
+        painter.drawLine(ix, 0, ix, h-1);
+        painter.setPen(Qt::gray);
+        painter.drawText(ix + 2, h - fontHeight/2, FormatSeconds(division*timeDivision));
+    }
+}
+
+template<int N>
+int OscilloscopeRenderer::_StoreSamples(const float *samples, int packetCount, bool &wrapped)
+{
+    const int stride = (N > 0) ? N : _channelCount;
+    const int w = _image.width();
+
+    // add the columns this will reach for the first time up front
+    const int touchedColumns = (_columnFill + packetCount + _packetsPerColumn - 1)/_packetsPerColumn;
+    const int reachedColumns = qMin(w, _scopeX + touchedColumns);
+    if (_ColumnCount() < reachedColumns)
+        _samples.resize(reachedColumns*2*stride);
+
+    // fold the packets into the columns' minimums/maximums,
+    // starting a column over when the first one arrives
+    float * const columns = _samples.data();
+    int x = _scopeX;
+    wrapped = false;
+    for (int i = 0; i < packetCount; i++)
+    {
+        const float * const packet = samples + i*stride;
+        float * const minimums = columns + x*2*stride;
+        float * const maximums = minimums + stride;
+        if (_columnFill == 0)
+            _statistics.beginColumn();
+        _statistics.addPacket(packet);
+        if (_columnFill == 0)
+        {
+            std::copy(packet, packet + stride, minimums);
+            std::copy(packet, packet + stride, maximums);
+        }
+        else
+        {
+            for (int channel = 0; channel < stride; channel++)
+            {
+                minimums[channel] = qMin(minimums[channel], packet[channel]);
+                maximums[channel] = qMax(maximums[channel], packet[channel]);
+            }
+        }
+        if (++_columnFill < _packetsPerColumn)
+            continue;
+        _columnFill = 0;
+        if (++x >= w)
+        {
+            x = 0;
+            wrapped = true;
+        }
+    }
+    return x;
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,148 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_OSCILLOSCOPERENDERER_H
+#define STMBL_SERVOTERM_OSCILLOSCOPERENDERER_H
+
+#include "globals.h"
+#include "ScopeSampleBlock.h"
+#include "ScopeHistory.h"
+#include "ScopeTrigger.h"
+#include "ScopeStatistics.h"
+
+#include <QObject>
+#include <QImage>
+#include <QFont>
+#include <QColor>
+#include <QElapsedTimer>
+
+QT_BEGIN_NAMESPACE
+class QPainter;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// the color every view draws the channel in
+QColor ScopeChannelColor(int channel);
+
+// does all the work behind Oscilloscope, usually on a thread of its own:
+// the packets are folded into pixel columns (the range, minimum to
+// maximum, of packetsPerColumn packets each) and the columns that
+// changed are rasterized into a backing image, which goes out as strips
+// for the widget to composite
+// NOTE: nothing is rendered until render() is called, which
+//       Oscilloscope does once per frame
+// every packet also goes into a ScopeHistory, so while paused the view
+// can be panned and zoomed over all of it, while capturing goes on;
+// it is also what a triggered frame is drawn from, the trigger packet a
+// quarter of the way in so what led up to it shows as well
+// the packets of the sweep are also measured as they come in, over the
+// columns on screen (see ScopeStatistics), which is what autoscale
+// sizes the traces by; while paused, a span can be measured instead
+class OscilloscopeRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    OscilloscopeRenderer(QObject *parent = nullptr);
+public slots:
+    void setSize(const QSize &size);
+    void setFont(const QFont &font);
+    void setChannelCount(int channelCount);
+    void setPacketsPerColumn(int packetsPerColumn);
+    void addSamples(const STMBL_Servoterm::ScopeSampleBlock &block);
+    void resetScanning();
+    void setPaused(bool paused);
+    void setHistoryBudget(qint64 bytes);
+    void panView(int columns); // NOTE: positive goes back in time
+    void zoomView(int steps, int anchorX); // doubles the packets per column each step, keeping the one at anchorX in place
+    void setTriggerSettings(const STMBL_Servoterm::ScopeTriggerSettings &settings);
+    void armTrigger(); // waits for the next trigger, in single mode
+    void setAutoscale(bool autoscale);
+    void selectSpan(int firstX, int lastX); // measures the columns from firstX to lastX, while paused
+    void clearSpan();
+    void render(); // renders whatever changed since the last time
+signals:
+    void stripRendered(const QImage &strip, int x);
+    void cursorMoved(int x);
+    void statisticsUpdated(const STMBL_Servoterm::ScopeStatisticsReport &report);
+    void errorMessage(const QString &errorMessage);
+protected:
+    int _ColumnCount() const;
+    void _Restart();
+    void _SetPacketPeriod(double packetPeriod);
+    void _UpdateTimeDivision();
+    void _MarkAllDirty();
+    void _MarkDirty(int firstX, int x, bool wrapped, bool lapped);
+    void _ClampView();
+    void _ResetStatistics();
+    void _EmitStatistics();
+    void _UpdateAutoscale();
+    void _ResetScales();
+    int _PreTriggerColumns() const;
+    void _ResetTrigger();
+    void _ProcessTrigger(const float *samples, int packetCount, qint64 firstPacket);
+    void _RenderColumns(int first, int last);
+    void _RenderHistory();
+    void _RenderTriggered();
+    void _RenderFromHistory(qint64 first, int packetsPerColumn, double originSeconds);
+    void _DrawBackground(QPainter &painter, const QRect &rect, double secondsPerColumn, double timeDivision, double originSeconds);
+    void _DrawTimeGrid(QPainter &painter, const QRect &rect, double secondsPerColumn, double timeDivision, double originSeconds);
+    template<int N>
+    int _StoreSamples(const float *samples, int packetCount, bool &wrapped); // returns where the next one goes
+
+    QImage _image; // the traces and grid
+    QFont _font;
+    QVector<float> _samples; // column after column, the _channelCount minimums then the _channelCount maximums
+    QVector<char> _dirtyColumns; // NOTE: one per column of the image
+    bool _anyDirty;
+    int _channelCount;
+    int _packetsPerColumn;
+    int _columnFill; // how many packets went into the column at _scopeX so far
+    int _scopeX;
+    double _packetPeriod; // NOTE: in seconds, 0 while unknown
+    double _timeDivision; // the spacing of the time grid, in seconds
+    ScopeHistory _history;
+    bool _historyShortReported; // NOTE: once per budget
+    bool _paused;
+    qint64 _viewEnd; // one past the newest packet shown while paused
+    int _viewPacketsPerColumn;
+    QVector<float> _viewColumns; // laid out like _samples
+    ScopeStatistics _statistics; // of the sweep
+    QElapsedTimer _statisticsClock; // since the last report
+    bool _statisticsPending; // anything came in since the last report
+    bool _spanSelected; // NOTE: the sweep isn't reported while there's a span
+    bool _autoscale;
+    QVector<float> _gains; // per channel, the traces are drawn as (sample - offset)*gain
+    QVector<float> _offsets;
+    ScopeTrigger _trigger;
+    enum TriggerState
+    {
+        TRIGGER_WAITING,
+        TRIGGER_CAPTURING, // fired, waiting for the rest of the frame
+        TRIGGER_HELD // single mode, done until armed again
+    } _triggerState;
+    qint64 _triggerPacket; // where the frame being captured fired
+    qint64 _triggerHoldoff; // nothing before this fires, so frames don't overlap
+    qint64 _triggerWaitStart; // for auto mode to give up on waiting
+    qint64 _framePacket; // the trigger of the frame on screen, -1 if none
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_OSCILLOSCOPERENDERER_H
@@ -0,0 +1,150 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RecordingWorker.h"
+#include "ScopeCsv.h"
+
+namespace STMBL_Servoterm {
+
+static const int CSV_FLUSH_SIZE = 1024*1024; // keep the writes few and large
+
+RecordingWorker::RecordingWorker(QObject *parent) :
+    QObject(parent),
+    freeBatches(RECORDING_BATCH_COUNT),
+    filledBatches(RECORDING_BATCH_COUNT),
+    _batches(RECORDING_BATCH_COUNT),
+    _batchData(_batches.data()), // NOTE: detach once, before any threads get involved
+    _batchesPending(false),
+    _recording(0),
+    _errorReported(false)
+{
+    for (int index = 0; index < RECORDING_BATCH_COUNT; index++)
+        freeBatches.tryWrite(&index, 1);
+    _csvBuffer.reserve(CSV_FLUSH_SIZE + 256*1024);
+}
+
+RecordingWorker::~RecordingWorker()
+{
+    close();
+}
+
+void RecordingWorker::open(const QStringList &filePaths, int format, int recording)
+{
+    close();
+    _errorReported = false;
+    _recording = recording;
+    int i = 0;
+    while (i < filePaths.size() && !_Open(filePaths[i], format))
+        i++;
+    if (i < filePaths.size())
+        emit opened(filePaths[i]);
+    else
+        emit openFailed(filePaths.isEmpty() ? QString() : filePaths.last());
+    // the batches filled while this was on its way (NOTE: just returned if it failed)
+    writeBatches();
+}
+
+void RecordingWorker::setConfigCRC(quint32 crc)
+{
+    _writer.setConfigCRC(crc);
+}
+
+void RecordingWorker::writeBatches()
+{
+    // NOTE: cleared first, so whatever gets queued from here on
+    //       either gets written below or invokes this again
+    _batchesPending.store(false, std::memory_order_release);
+    // NOTE: a batch of the next recording waits for its open(), it may
+    //       be filled before the last one got closed
+    while (filledBatches.readAvailable() > 0 && batch(filledBatches.peek())->recording == _recording)
+    {
+        int index;
+        filledBatches.read(&index, 1);
+        _WriteBatch(*batch(index));
+        freeBatches.tryWrite(&index, 1); // NOTE: always fits, there are only as many batches
+    }
+}
+
+void RecordingWorker::close()
+{
+    writeBatches();
+    if (_writer.isOpen())
+    {
+        _writer.close();
+        _CheckError(_writer.error(), _writer.fileName());
+    }
+    if (_csvFile.isOpen())
+    {
+        _FlushCsv();
+        _csvFile.close();
+    }
+}
+
+bool RecordingWorker::_Open(const QString &filePath, int format)
+{
+    if (format == RECORDING_FORMAT_NATIVE)
+        return _writer.open(filePath);
+    _csvFile.setFileName(filePath);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    return _csvFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::NewOnly);
+#else
+    if (_csvFile.exists())
+        return false;
+    return _csvFile.open(QIODevice::WriteOnly | QIODevice::Text);
+#endif
+}
+
+void RecordingWorker::_WriteBatch(const RecordingBatch &batch)
+{
+    const int channelCount = batch.channelCount;
+    for (int segment = 0; segment < batch.segmentCount; segment++)
+    {
+        const RecordingSegment &s = batch.segments[segment];
+        const int end = (segment + 1 < batch.segmentCount) ? batch.segments[segment + 1].firstPacket : batch.packetCount;
+        const float * const samples = batch.samples.constData() + s.firstPacket*channelCount;
+        if (_writer.isOpen())
+            _writer.append(samples, end - s.firstPacket, channelCount, s.startTime, s.packetPeriod);
+        else if (_csvFile.isOpen())
+            AppendScopeCsvLines(_csvBuffer, samples, end - s.firstPacket, channelCount, s.startTime, s.packetPeriod);
+    }
+    if (_writer.isOpen())
+        _CheckError(_writer.error(), _writer.fileName());
+    else if (_csvBuffer.size() >= CSV_FLUSH_SIZE)
+        _FlushCsv();
+}
+
+void RecordingWorker::_FlushCsv()
+{
+    if (_csvBuffer.isEmpty())
+        return;
+    _csvFile.write(_csvBuffer);
+    _csvBuffer.resize(0);
+    _CheckError(_csvFile.error(), _csvFile.fileName());
+}
+
+void RecordingWorker::_CheckError(QFileDevice::FileError error, const QString &fileName)
+{
+    // NOTE: once per recording, a full disk would say so for every batch
+    if (error == QFileDevice::NoError || _errorReported)
+        return;
+    _errorReported = true;
+    emit errorMessage("Couldn't write to the recording \"" + fileName + "\"!");
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,107 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_RECORDINGWORKER_H
+#define STMBL_SERVOTERM_RECORDINGWORKER_H
+
+#include "SpscRing.h"
+#include "ScopeRecording.h"
+
+#include <QObject>
+#include <QFile>
+#include <QVector>
+#include <QStringList>
+
+#include <atomic>
+
+namespace STMBL_Servoterm {
+
+static const int RECORDING_BATCH_COUNT = 8;
+static const int RECORDING_BATCH_SAMPLES = 131072; // 16384 packets of 8 channels
+static const int RECORDING_BATCH_SEGMENTS = 256;
+
+// a stretch of a batch whose packets follow one steady packet period
+struct RecordingSegment
+{
+    int firstPacket; // in the batch
+    double startTime;
+    double packetPeriod;
+};
+
+// packets on their way to the disk, allocated once and then passed back
+// and forth between ScopeRecorder and RecordingWorker
+struct RecordingBatch
+{
+    RecordingBatch() : recording(0), channelCount(0), packetCount(0), segmentCount(0), samples(RECORDING_BATCH_SAMPLES), segments(RECORDING_BATCH_SEGMENTS) {}
+    int packetCapacity() const {return channelCount > 0 ? samples.size()/channelCount : 0;}
+
+    int recording; // the serial of the one it belongs to
+    int channelCount;
+    int packetCount;
+    int segmentCount;
+    QVector<float> samples; // packet after packet
+    QVector<RecordingSegment> segments;
+};
+
+// writes the recording on its own thread, so a disk that stalls never
+// holds up the GUI; the batches go round from freeBatches, filled by
+// ScopeRecorder, to filledBatches, written out here, and back again
+class RecordingWorker : public QObject
+{
+    Q_OBJECT
+public:
+    RecordingWorker(QObject *parent = nullptr);
+    ~RecordingWorker();
+
+    // the hand-over, NOTE: each ring has exactly one producer and one consumer
+    RecordingBatch * batch(int index) {return _batchData + index;}
+    SpscRing<int> freeBatches; // to ScopeRecorder
+    SpscRing<int> filledBatches; // from ScopeRecorder
+    // producer side, returns whether writeBatches() needs invoking, or
+    // is already on its way
+    bool markBatchesPending() {return !_batchesPending.exchange(true, std::memory_order_acq_rel);}
+public slots:
+    // tries the paths in turn, then says how it went with opened() or openFailed()
+    void open(const QStringList &filePaths, int format, int recording); // one of RecordingFormat, with a new serial
+    void setConfigCRC(quint32 crc);
+    void writeBatches();
+    void close();
+signals:
+    void opened(const QString &filePath);
+    void openFailed(const QString &filePath); // the last one tried
+    void errorMessage(const QString &errorMessage);
+protected:
+    bool _Open(const QString &filePath, int format);
+    void _WriteBatch(const RecordingBatch &batch);
+    void _FlushCsv();
+    void _CheckError(QFileDevice::FileError error, const QString &fileName);
+
+    QVector<RecordingBatch> _batches;
+    RecordingBatch *_batchData;
+    std::atomic<bool> _batchesPending;
+    int _recording; // the serial of the last open()
+    ScopeRecordingWriter _writer;
+    QFile _csvFile;
+    QByteArray _csvBuffer;
+    bool _errorReported;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_RECORDINGWORKER_H
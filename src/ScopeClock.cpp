@@ -0,0 +1,125 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeClock.h"
+
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+// how quickly old arrivals are forgotten, long enough to average away
+// the jitter, short enough to follow the drive's crystal drifting
+static const double TIME_CONSTANT_SECONDS = 10.0;
+
+// what it takes before the estimate is trusted
+static const int LOCK_ARRIVAL_COUNT = 16;
+static const double LOCK_SPAN_SECONDS = 0.5;
+
+// an arrival this far off the line means the stream paused (or the
+// drive restarted it at another rate), so start over from there
+static const double GAP_SECONDS = 0.25;
+
+ScopeClockEstimator::ScopeClockEstimator()
+{
+    reset();
+}
+
+void ScopeClockEstimator::reset()
+{
+    _referencePacket = 0;
+    _referenceTime = 0.0;
+    _firstArrivalTime = 0.0;
+    _arrivalCount = 0;
+    _weightSum = 0.0;
+    _packetSum = 0.0;
+    _timeSum = 0.0;
+    _packetPacketSum = 0.0;
+    _packetTimeSum = 0.0;
+    _period = 0.0;
+    _offset = 0.0;
+    _offsetPacket = 0;
+    _locked = false;
+}
+
+void ScopeClockEstimator::addArrival(quint64 packetCount, double arrivalTime)
+{
+    if (_arrivalCount > 0 && _locked && std::fabs(arrivalTime - packetTime(packetCount)) > GAP_SECONDS)
+        reset();
+    if (_arrivalCount == 0)
+    {
+        _referencePacket = packetCount;
+        _referenceTime = arrivalTime;
+        _firstArrivalTime = arrivalTime;
+    }
+
+    // age the sums, then move their origin onto this arrival
+    const double decay = std::exp(-(arrivalTime - _referenceTime)/TIME_CONSTANT_SECONDS);
+    const double dn = static_cast<double>(static_cast<qint64>(packetCount - _referencePacket));
+    const double dt = arrivalTime - _referenceTime;
+    _weightSum *= decay;
+    _packetSum *= decay;
+    _timeSum *= decay;
+    _packetPacketSum *= decay;
+    _packetTimeSum *= decay;
+    _packetPacketSum += dn*dn*_weightSum - 2.0*dn*_packetSum;
+    _packetTimeSum += dn*dt*_weightSum - dn*_timeSum - dt*_packetSum;
+    _packetSum -= dn*_weightSum;
+    _timeSum -= dt*_weightSum;
+    _referencePacket = packetCount;
+    _referenceTime = arrivalTime;
+
+    // the new arrival itself sits right at the origin
+    _weightSum += 1.0;
+    _arrivalCount++;
+    _Solve();
+}
+
+bool ScopeClockEstimator::isLocked() const
+{
+    return _locked;
+}
+
+double ScopeClockEstimator::packetPeriod() const
+{
+    return _locked ? _period : 0.0;
+}
+
+double ScopeClockEstimator::packetTime(quint64 packetIndex) const
+{
+    if (!_locked)
+        return _referenceTime;
+    return _offset + _period*static_cast<double>(static_cast<qint64>(packetIndex - _offsetPacket));
+}
+
+void ScopeClockEstimator::_Solve()
+{
+    const double meanPacket = _packetSum/_weightSum;
+    const double meanTime = _timeSum/_weightSum;
+    const double variance = _packetPacketSum/_weightSum - meanPacket*meanPacket;
+    const double covariance = _packetTimeSum/_weightSum - meanPacket*meanTime;
+    if (variance <= 0.0 || covariance <= 0.0)
+        return; // NOTE: keeps the previous estimate (if any)
+    _period = covariance/variance;
+    _offset = _referenceTime + meanTime - _period*meanPacket;
+    _offsetPacket = _referencePacket;
+    if (!_locked)
+        _locked = (_arrivalCount >= LOCK_ARRIVAL_COUNT && _referenceTime - _firstArrivalTime >= LOCK_SPAN_SECONDS);
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,72 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPECLOCK_H
+#define STMBL_SERVOTERM_SCOPECLOCK_H
+
+#include <QtGlobal>
+
+namespace STMBL_Servoterm {
+
+// ties a point of the scope sample stream to the host's clock, from
+// there on the packets follow at a steady packetPeriod (0 if unknown)
+struct ScopeClockStamp
+{
+    ScopeClockStamp() : position(0), time(0.0), packetPeriod(0.0) {}
+    quint64 position; // in the stream of samples written to SerialIngestWorker::scopeSamples
+    double time; // of the packet at position, in seconds since connecting
+    double packetPeriod; // in seconds
+};
+
+// recovers the drive's packet period from when the packets arrive on
+// the host, which is only known per read and jitters with the USB and
+// OS scheduling; an exponentially weighted least squares line through
+// (packets received so far, arrival time) smooths that out
+// NOTE: the sums are kept relative to the newest arrival, so they stay
+//       small no matter how long the connection has been running
+class ScopeClockEstimator
+{
+public:
+    ScopeClockEstimator();
+    void reset();
+    void addArrival(quint64 packetCount, double arrivalTime); // NOTE: packetCount is everything received up to arrivalTime
+    bool isLocked() const;
+    double packetPeriod() const; // NOTE: 0 until locked
+    double packetTime(quint64 packetIndex) const; // NOTE: the latest arrival time until locked
+protected:
+    void _Solve();
+
+    quint64 _referencePacket;
+    double _referenceTime;
+    double _firstArrivalTime;
+    int _arrivalCount;
+    double _weightSum;
+    double _packetSum;
+    double _timeSum;
+    double _packetPacketSum;
+    double _packetTimeSum;
+    double _period;
+    double _offset; // the estimated time of _offsetPacket
+    quint64 _offsetPacket;
+    bool _locked;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPECLOCK_H
@@ -0,0 +1,137 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "ScopeCsv.h"
+
+#include <cstring>
+
+namespace STMBL_Servoterm {
+
+static const int MAXIMUM_TIME_CHARS = 32;
+static const int CODE_TEXT_CHARS = 16;
+static const int GROW_LINES = 256; // how many lines' worth the output grows by at a time
+
+// the text of every 8-bit code, exactly as QByteArray::number() has it
+struct CsvCodeTexts
+{
+    CsvCodeTexts()
+    {
+        for (int code = -128; code < 128; code++)
+        {
+            const QByteArray text = QByteArray::number(code/128.0f, 'f');
+            std::memset(texts[code + 128], 0, CODE_TEXT_CHARS);
+            std::memcpy(texts[code + 128], text.constData(), text.size());
+            lengths[code + 128] = text.size();
+        }
+    }
+    char texts[256][CODE_TEXT_CHARS];
+    int lengths[256];
+};
+
+static const CsvCodeTexts & NarrowCodeTexts()
+{
+    static const CsvCodeTexts texts; // NOTE: thread safe, the recorder formats off the GUI thread
+    return texts;
+}
+
+// seconds to the microsecond, like QByteArray::number(time, 'f', 6)
+static char * FormatTime(char *out, double time)
+{
+    qint64 us = qRound64(time*1e6);
+    if (us < 0)
+    {
+        *out++ = '-';
+        us = -us;
+    }
+    qint64 whole = us/1000000;
+    int fraction = static_cast<int>(us % 1000000);
+    char digits[20];
+    int count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (count > 0)
+        *out++ = digits[--count];
+    *out++ = '.';
+    for (int i = 5; i >= 0; i--)
+    {
+        out[i] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+    return out + 6;
+}
+
+void AppendScopeCsvLines(QByteArray &out, const ScopeSampleBlock &block)
+{
+    AppendScopeCsvLines(out, block.samples.constData(), block.packetCount(), block.channelCount, block.startTime, block.packetPeriod);
+}
+
+void AppendScopeCsvLines(QByteArray &out, const float *samples, int packetCount, int channelCount, double startTime, double packetPeriod)
+{
+    const CsvCodeTexts &narrow = NarrowCodeTexts();
+    // NOTE: written through a pointer into room made up front, growing
+    //       it whenever what is left might not take another line
+    const int lineChars = MAXIMUM_TIME_CHARS + channelCount*(1 + CODE_TEXT_CHARS) + 1;
+    int size = out.size();
+    out.resize(size + qMin(packetCount, GROW_LINES)*lineChars);
+    char *p = out.data() + size;
+    char *end = out.data() + out.size();
+    for (int i = 0; i < packetCount; i++)
+    {
+        if (end - p < lineChars)
+        {
+            size = static_cast<int>(p - out.data());
+            out.resize(size + qMin(packetCount - i, GROW_LINES)*lineChars);
+            p = out.data() + size;
+            end = out.data() + out.size();
+        }
+        const float * const packet = samples + i*channelCount;
+        p = FormatTime(p, startTime + i*packetPeriod);
+        for (int channel = 0; channel < channelCount; channel++)
+        {
+            *p++ = ',';
+            const float scaled = packet[channel]*128.0f;
+            if (scaled >= -128.0f && scaled <= 127.0f && scaled == static_cast<float>(static_cast<int>(scaled)))
+            {
+                const int index = static_cast<int>(scaled) + 128;
+                std::memcpy(p, narrow.texts[index], CODE_TEXT_CHARS);
+                p += narrow.lengths[index];
+                continue;
+            }
+            // a 16-bit code (or something odd), which may be longer than what was made room for
+            const QByteArray text = QByteArray::number(packet[channel], 'f');
+            if (end - p < text.size() + lineChars)
+            {
+                size = static_cast<int>(p - out.data());
+                out.resize(size + text.size() + qMin(packetCount - i, GROW_LINES)*lineChars);
+                p = out.data() + size;
+                end = out.data() + out.size();
+            }
+            std::memcpy(p, text.constData(), text.size());
+            p += text.size();
+        }
+        *p++ = '\n';
+    }
+    out.resize(static_cast<int>(p - out.data()));
+}
+
+} // namespace STMBL_Servoterm
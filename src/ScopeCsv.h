@@ -0,0 +1,40 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STMBL_SERVOTERM_SCOPECSV_H
+#define STMBL_SERVOTERM_SCOPECSV_H
+
+#include "ScopeSampleBlock.h"
+
+#include <QByteArray>
+
+namespace STMBL_Servoterm {
+
+// appends one comma separated line per packet of the block, the
+// packet's time (in seconds, to the microsecond) followed by its samples
+// NOTE: samples that are 8-bit codes (all of them, unless the drive
+//       sends the extended frames) come from a table of their 256
+//       texts, only the others get formatted
+void AppendScopeCsvLines(QByteArray &out, const ScopeSampleBlock &block);
+void AppendScopeCsvLines(QByteArray &out, const float *samples, int packetCount, int channelCount, double startTime, double packetPeriod);
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPECSV_H
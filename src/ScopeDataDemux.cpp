@@ -18,50 +18,383 @@
 */
 
 #include "ScopeDataDemux.h"
+#include "ScopeDataScanner.h"
 #include "globals.h"
 
 #include <QByteArray>
+#include <QMetaMethod>
+
+#include <algorithm>
 
 namespace STMBL_Servoterm {
 
-ScopeDataDemux::ScopeDataDemux(QObject *parent) : QObject(parent), _state(SCOPEDATADEMUX_STATE_IDLE)
+static const char SCOPE_PACKET_MARKER = static_cast<char>(0xFF);
+static const char SCOPE_RESET_MARKER = static_cast<char>(0xFE);
+static const int CHANNEL_COUNT_DETECTION_PACKETS = 64; // consecutive packets needed to switch
+
+// the firmware only ever prints plain ASCII
+static bool LooksLikeText(const QByteArray &bytes)
 {
+    for (QByteArray::const_iterator it = bytes.begin(); it != bytes.end(); ++it)
+    {
+        const quint8 c = static_cast<quint8>(*it);
+        if ((c < 0x20 || c > 0x7E) && c != '\n' && c != '\r' && c != '\t')
+            return false;
+    }
+    return true;
 }
 
-QString ScopeDataDemux::addData(const QByteArray &data)
+ScopeDataDemux::ScopeDataDemux(QObject *parent) :
+    QObject(parent),
+    _state(SCOPEDATADEMUX_STATE_IDLE),
+    _configuredChannelCount(0),
+    _channelCount(SCOPE_CHANNEL_COUNT),
+    _packetFill(0),
+    _frameFill(0),
+    _frameLength(0),
+    _gapBytes(0),
+    _frameFollowsFrame(false),
+    _holdingText(false),
+    _streamPosition(0),
+    _lastPacketMarkerPosition(-1),
+    _candidateChannelCount(0),
+    _candidatePackets(0),
+    _publishedGoodFrames(0),
+    _publishedResyncs(0),
+    _publishedDiscardedBytes(0),
+    _publishedResetMarkers(0),
+    _publishedExtendedFrames(0),
+    _publishedCrcErrors(0)
 {
-    QString txt;
-    for (QByteArray::const_iterator it = data.begin(); it != data.end(); ++it)
+    _heldText.reserve(SCOPE_MAXIMUM_CHANNEL_COUNT);
+    reset();
+}
+
+void ScopeDataDemux::addData(const QByteArray &data, QByteArray &text)
+{
+    // at most one sample per received byte (plus a packet that started
+    // in the previous chunk), so this avoids any reallocation
+    _block.samples.reserve(_block.samples.size() + data.size() + SCOPE_MAXIMUM_CHANNEL_COUNT);
+    const char *it = data.constData();
+    const char * const end = it + data.size();
+    while (it != end)
     {
-        if(_state == SCOPEDATADEMUX_STATE_READING_PACKET)
+        if (_state == SCOPEDATADEMUX_STATE_READING_MARKER)
+        {
+            if (*it == SCOPE_PACKET_MARKER)
+            {
+                // an empty legacy packet is impossible, so a second marker
+                // means an extended frame follows
+                _state = SCOPEDATADEMUX_STATE_READING_FRAME;
+                _frameFill = 0;
+                _frameLength = 0;
+                _lastPacketMarkerPosition = -1; // their spacing says nothing about the channel count
+                ++it;
+            }
+            else
+            {
+                _state = SCOPEDATADEMUX_STATE_READING_PACKET;
+                _packetFill = 0;
+            }
+            continue;
+        }
+
+        if (_state == SCOPEDATADEMUX_STATE_READING_FRAME)
+        {
+            it = _ReadFrame(it, end);
+            continue;
+        }
+
+        if (_state == SCOPEDATADEMUX_STATE_READING_PACKET)
         {
-            _packet.append((static_cast<int>(static_cast<quint8>(*it)) - 128) / 128.0);
-            if(_packet.size() == SCOPE_CHANNEL_COUNT)
+            const int count = qMin(static_cast<int>(end - it), _channelCount - _packetFill);
+            const int markerOffset = ScopeScanFindMarker(it, count);
+            if (markerOffset < count)
+            {
+                // samples never contain marker bytes, so bytes of this packet got
+                // lost; drop what we have and let the marker start over cleanly
+                _counters.resyncs++;
+                _counters.discardedBytes += 1 + _packetFill + markerOffset;
+                _state = SCOPEDATADEMUX_STATE_IDLE;
+                _packetFill = 0;
+                it += markerOffset;
+                continue;
+            }
+            const quint8 *codes = reinterpret_cast<const quint8 *>(it);
+            if (count < _channelCount)
+            {
+                // the packet is split across chunks, gather it first
+                std::copy(codes, codes + count, _packet + _packetFill);
+                _packetFill += count;
+                codes = _packet;
+            }
+            it += count;
+            if (count == _channelCount || _packetFill == _channelCount)
             {
-                // save the packet
-                QVector<float> packet = _packet;
+                // convert the whole packet straight into the block
+                const int offset = _block.samples.size();
+                _block.samples.resize(offset + _channelCount);
+                ScopeScanConvertPacket(codes, _block.samples.data() + offset, _channelCount);
+                _counters.goodFrames++;
                 // reset the state
                 _state = SCOPEDATADEMUX_STATE_IDLE;
-                _packet.resize(0);
-                // dispatch the packet
-                emit scopePacketReceived(packet);
+                _packetFill = 0;
+                _holdingText = _frameFollowsFrame;
+                _gapBytes = 0;
             }
+            continue;
         }
-        else if (*it == static_cast<char>(0xFF))
+
+        // copy the text up to the next marker byte in one go
+        const int textLength = ScopeScanFindMarker(it, end - it);
+        if (textLength > 0)
+        {
+            _AddText(it, textLength, text);
+            it += textLength;
+            if (it == end)
+                break;
+        }
+
+        if (*it == SCOPE_PACKET_MARKER)
         {
-            _state = SCOPEDATADEMUX_STATE_READING_PACKET;
-            _packet.resize(0);
+            const qint64 markerPosition = _streamPosition + (it - data.constData());
+            if (_lastPacketMarkerPosition >= 0)
+                _DetectChannelCount(markerPosition - _lastPacketMarkerPosition - 1);
+            _lastPacketMarkerPosition = markerPosition;
+            // exactly one packet's worth of binary garbage between two back to back
+            // packets means the marker in front of it got lost, it isn't text
+            if (_holdingText && _heldText.size() == _channelCount && !LooksLikeText(_heldText))
+            {
+                _counters.resyncs++;
+                _counters.discardedBytes += _heldText.size();
+                _heldText.resize(0);
+                _holdingText = false;
+                _gapBytes = 0;
+            }
+            _ReleaseHeldText(text);
+            _frameFollowsFrame = (_gapBytes == 0);
+            _state = SCOPEDATADEMUX_STATE_READING_MARKER;
         }
-        else if (*it == static_cast<char>(0xFE))
+        else if (*it == SCOPE_RESET_MARKER)
         {
+            _ReleaseHeldText(text);
+            _counters.resetMarkers++;
+            _lastPacketMarkerPosition = -1; // the spacing across a reset means nothing
+            // the packets before the reset belong to the old scan
+            _FlushBlock();
             emit scopeResetReceived();
         }
-        else
+        ++it;
+    }
+    // held text that reads like text is let through now, rather than
+    // waiting for a marker that may never come (a short reply right as
+    // the scope stream stops); only a lost packet's binary is kept back
+    // NOTE: one split across chunks, printable in the first, slips through
+    if (_holdingText && LooksLikeText(_heldText))
+        _ReleaseHeldText(text);
+    _streamPosition += data.size();
+    // dispatch all the packets of this chunk at once
+    _FlushBlock();
+    _PublishCounters();
+}
+
+const char * ScopeDataDemux::_ReadFrame(const char *it, const char *end)
+{
+    if (_frameLength == 0)
+    {
+        // the header, which is just the channel count
+        const int channelCount = static_cast<quint8>(*it);
+        if (channelCount < 1 || channelCount > SCOPE_MAXIMUM_CHANNEL_COUNT)
+        {
+            // not a frame after all, look at this byte again as text/marker
+            _counters.resyncs++;
+            _counters.discardedBytes += 2;
+            _state = SCOPEDATADEMUX_STATE_IDLE;
+            return it;
+        }
+        _frameLength = 1 + 2*channelCount + 2;
+    }
+
+    // use the frame in place if it's all there, otherwise gather it first
+    const quint8 *frame = reinterpret_cast<const quint8 *>(it);
+    const int count = qMin(static_cast<int>(end - it), _frameLength - _frameFill);
+    if (_frameFill > 0 || count < _frameLength)
+    {
+        std::copy(frame, frame + count, _frame + _frameFill);
+        frame = _frame;
+    }
+    _frameFill += count;
+    it += count;
+    if (_frameFill < _frameLength)
+        return it;
+
+    _state = SCOPEDATADEMUX_STATE_IDLE;
+    _holdingText = false;
+    _gapBytes = 0;
+    const int channelCount = frame[0];
+    const quint16 crc = static_cast<quint16>(frame[_frameLength - 2] | (frame[_frameLength - 1] << 8));
+    if (ScopeScanCrc16(frame, _frameLength - 2) != crc)
+    {
+        // NOTE: its bytes aren't searched for the next frame, so a frame
+        //       cut short also costs the one after it
+        _counters.crcErrors++;
+        _counters.resyncs++;
+        _counters.discardedBytes += 2 + _frameLength;
+        return it;
+    }
+    // the frame says how wide it is, which beats any configuration
+    _SetChannelCount(channelCount);
+    const int offset = _block.samples.size();
+    _block.samples.resize(offset + channelCount);
+    ScopeScanConvertWidePacket(frame + 1, _block.samples.data() + offset, channelCount);
+    _counters.goodFrames++;
+    _counters.extendedFrames++;
+    return it;
+}
+
+void ScopeDataDemux::reset()
+{
+    _state = SCOPEDATADEMUX_STATE_IDLE;
+    _packetFill = 0;
+    _frameFill = 0;
+    _frameLength = 0;
+    _block.samples.resize(0);
+    _gapBytes = 0;
+    _frameFollowsFrame = false;
+    _holdingText = false;
+    _heldText.resize(0);
+    _streamPosition = 0;
+    _lastPacketMarkerPosition = -1;
+    _candidateChannelCount = 0;
+    _candidatePackets = 0;
+    _SetChannelCount(_configuredChannelCount > 0 ? _configuredChannelCount : SCOPE_CHANNEL_COUNT);
+    _counters.goodFrames = 0;
+    _counters.resyncs = 0;
+    _counters.discardedBytes = 0;
+    _counters.resetMarkers = 0;
+    _counters.extendedFrames = 0;
+    _counters.crcErrors = 0;
+    _PublishCounters();
+}
+
+ScopeDataDemux::Counters ScopeDataDemux::counters() const
+{
+    Counters counters;
+    counters.goodFrames = _publishedGoodFrames.load(std::memory_order_relaxed);
+    counters.resyncs = _publishedResyncs.load(std::memory_order_relaxed);
+    counters.discardedBytes = _publishedDiscardedBytes.load(std::memory_order_relaxed);
+    counters.resetMarkers = _publishedResetMarkers.load(std::memory_order_relaxed);
+    counters.extendedFrames = _publishedExtendedFrames.load(std::memory_order_relaxed);
+    counters.crcErrors = _publishedCrcErrors.load(std::memory_order_relaxed);
+    return counters;
+}
+
+void ScopeDataDemux::setChannelCount(int channelCount)
+{
+    _configuredChannelCount = qBound(0, channelCount, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    _candidateChannelCount = 0;
+    _candidatePackets = 0;
+    if (_configuredChannelCount > 0)
+        _SetChannelCount(_configuredChannelCount);
+}
+
+int ScopeDataDemux::channelCount() const
+{
+    return _channelCount;
+}
+
+void ScopeDataDemux::_SetChannelCount(int channelCount)
+{
+    if (channelCount == _channelCount)
+        return;
+    // the packets so far still have the old width
+    _FlushBlock();
+    _channelCount = channelCount;
+    _block.channelCount = channelCount;
+    _state = SCOPEDATADEMUX_STATE_IDLE;
+    _packetFill = 0;
+    emit channelCountChanged(channelCount);
+}
+
+void ScopeDataDemux::_DetectChannelCount(qint64 markerDistance)
+{
+    if (_configuredChannelCount > 0)
+        return;
+    if (markerDistance < 1 || markerDistance > SCOPE_MAXIMUM_CHANNEL_COUNT || markerDistance == _channelCount)
+    {
+        // text in between, or the width we already expect
+        _candidatePackets = 0;
+        return;
+    }
+    if (markerDistance != _candidateChannelCount)
+    {
+        _candidateChannelCount = static_cast<int>(markerDistance);
+        _candidatePackets = 0;
+    }
+    if (++_candidatePackets >= CHANNEL_COUNT_DETECTION_PACKETS)
+    {
+        _candidatePackets = 0;
+        _SetChannelCount(_candidateChannelCount);
+    }
+}
+
+void ScopeDataDemux::_FlushBlock()
+{
+    if (_block.isEmpty())
+        return;
+    emit scopePacketsReceived(_block);
+
+    // compatibility with per-packet consumers, only paid for if somebody listens
+    static const QMetaMethod packetSignal = QMetaMethod::fromSignal(&ScopeDataDemux::scopePacketReceived);
+    if (isSignalConnected(packetSignal))
+    {
+        const int packetCount = _block.packetCount();
+        for (int i = 0; i < packetCount; i++)
+        {
+            const float * const samples = _block.packet(i);
+            QVector<float> packet(_block.channelCount);
+            std::copy(samples, samples + _block.channelCount, packet.begin());
+            emit scopePacketReceived(packet);
+        }
+    }
+    _block.samples.resize(0);
+}
+
+void ScopeDataDemux::_AddText(const char *bytes, int length, QByteArray &text)
+{
+    _gapBytes += length;
+    if (_holdingText)
+    {
+        if (_heldText.size() + length <= _channelCount)
         {
-            txt.append(QChar::fromLatin1(*it));
+            _heldText.append(bytes, length);
+            return;
         }
+        // too long to be a lost packet, so it must be real text
+        _ReleaseHeldText(text);
+    }
+    text.append(bytes, length);
+}
+
+void ScopeDataDemux::_ReleaseHeldText(QByteArray &text)
+{
+    if (!_heldText.isEmpty())
+    {
+        text.append(_heldText);
+        _heldText.resize(0);
     }
-    return txt;
+    _holdingText = false;
+}
+
+void ScopeDataDemux::_PublishCounters()
+{
+    // NOTE: only this thread writes them, readers just need a recent value
+    _publishedGoodFrames.store(_counters.goodFrames, std::memory_order_relaxed);
+    _publishedResyncs.store(_counters.resyncs, std::memory_order_relaxed);
+    _publishedDiscardedBytes.store(_counters.discardedBytes, std::memory_order_relaxed);
+    _publishedResetMarkers.store(_counters.resetMarkers, std::memory_order_relaxed);
+    _publishedExtendedFrames.store(_counters.extendedFrames, std::memory_order_relaxed);
+    _publishedCrcErrors.store(_counters.crcErrors, std::memory_order_relaxed);
 }
 
 } // namespace STMBL_Servoterm
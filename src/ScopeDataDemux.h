@@ -20,31 +20,94 @@
 #ifndef STMBL_SERVOTERM_SCOPEDATADEMUX_H
 #define STMBL_SERVOTERM_SCOPEDATADEMUX_H
 
+#include "ScopeSampleBlock.h"
+
 #include <QObject>
 #include <QVector>
+#include <QByteArray>
 
-QT_BEGIN_NAMESPACE
-class QByteArray;
-QT_END_NAMESPACE
+#include <atomic>
 
 namespace STMBL_Servoterm {
 
+// splits what the drive sends into console text and scope packets, which
+// come in two flavors:
+//   legacy:   0xFF, then one 8-bit code (never 0xFE/0xFF) per channel
+//   extended: 0xFF 0xFF, channel count, one little endian 16-bit sample
+//             per channel, CRC-16/CCITT-FALSE of the count and samples
+// a lone 0xFE resets the scope scan; both kinds may be mixed freely
 class ScopeDataDemux : public QObject
 {
     Q_OBJECT
 public:
+    // link health, for telling a bad connection apart from a slow GUI
+    struct Counters
+    {
+        quint64 goodFrames;
+        quint64 resyncs;
+        quint64 discardedBytes;
+        quint64 resetMarkers;
+        quint64 extendedFrames; // of the good frames
+        quint64 crcErrors;
+    };
+
     ScopeDataDemux(QObject *parent = nullptr);
-    QString addData(const QByteArray &data);
+    void addData(const QByteArray &data, QByteArray &text); // NOTE: appends the console text (Latin-1) to text
+    void reset(); // forget any partial packet and zero the counters
+    Counters counters() const; // NOTE: safe to call from any thread
+    // NOTE: 0 detects the channel count from the spacing of the packet markers
+    void setChannelCount(int channelCount);
+    int channelCount() const;
 signals:
-    void scopePacketReceived(const QVector<float> &packet);
+    void scopePacketsReceived(const STMBL_Servoterm::ScopeSampleBlock &block);
+    void scopePacketReceived(const QVector<float> &packet); // NOTE: only emitted if connected, prefer scopePacketsReceived()
     void scopeResetReceived();
+    void channelCountChanged(int channelCount); // NOTE: emitted after the packets of the old width were flushed
 protected:
+    void _SetChannelCount(int channelCount);
+    void _DetectChannelCount(qint64 markerDistance);
+    const char * _ReadFrame(const char *it, const char *end);
+    void _FlushBlock();
+    void _AddText(const char *bytes, int length, QByteArray &text);
+    void _ReleaseHeldText(QByteArray &text);
+    void _PublishCounters();
     enum State
     {
         SCOPEDATADEMUX_STATE_IDLE = 0,
-        SCOPEDATADEMUX_STATE_READING_PACKET
+        SCOPEDATADEMUX_STATE_READING_MARKER, // legacy packet or extended frame?
+        SCOPEDATADEMUX_STATE_READING_PACKET,
+        SCOPEDATADEMUX_STATE_READING_FRAME
     } _state;
-    QVector<float> _packet;
+    int _configuredChannelCount; // 0 for automatic
+    int _channelCount;
+    quint8 _packet[SCOPE_MAXIMUM_CHANNEL_COUNT];
+    int _packetFill;
+    quint8 _frame[1 + 2*SCOPE_MAXIMUM_CHANNEL_COUNT + 2];
+    int _frameFill;
+    int _frameLength; // 0 until the header was read
+    ScopeSampleBlock _block;
+
+    // while packets arrive back to back, up to one packet's worth of
+    // text is held back, in case it is really a packet whose 0xFF got lost
+    int _gapBytes;
+    bool _frameFollowsFrame;
+    bool _holdingText;
+    QByteArray _heldText;
+
+    // the same marker spacing over and over means the drive sends a
+    // different number of channels than we expect
+    qint64 _streamPosition;
+    qint64 _lastPacketMarkerPosition;
+    int _candidateChannelCount;
+    int _candidatePackets;
+
+    Counters _counters;
+    std::atomic<quint64> _publishedGoodFrames;
+    std::atomic<quint64> _publishedResyncs;
+    std::atomic<quint64> _publishedDiscardedBytes;
+    std::atomic<quint64> _publishedResetMarkers;
+    std::atomic<quint64> _publishedExtendedFrames;
+    std::atomic<quint64> _publishedCrcErrors;
 };
 
 } // namespace STMBL_Servoterm
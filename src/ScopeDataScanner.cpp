@@ -0,0 +1,339 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeDataScanner.h"
+#include "globals.h"
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+// NOTE: the vector kernels are compiled with per-function target
+// attributes rather than global compiler flags, so the executable
+// still runs on machines without them (e.g. the 32-bit MinGW build)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__i386__) || defined(__x86_64__))
+    #define SCOPE_SCAN_HAVE_SSE2 1
+    #define SCOPE_SCAN_HAVE_AVX2 1
+    #define SCOPE_SCAN_TARGET(isa) __attribute__((target(isa)))
+    #include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+    #define SCOPE_SCAN_HAVE_SSE2 1
+    #define SCOPE_SCAN_TARGET(isa)
+    #include <emmintrin.h>
+#endif
+
+namespace STMBL_Servoterm {
+
+static const float SCOPE_CODE_SCALE = 1.0f/128.0f;
+static const float SCOPE_WIDE_SCALE = 1.0f/32768.0f;
+
+static int FindMarkerScalar(const char *data, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        if (static_cast<quint8>(data[i]) >= 0xFE)
+            return i;
+    }
+    return size;
+}
+
+// NOTE: the convert kernels are templated on the channel count, so the
+// common packet widths get fixed-size, unrolled loops; N = 0 is the
+// generic fallback that goes by channelCount instead
+template<int N>
+static void ConvertPacketScalar(const quint8 *codes, float *samples, int channelCount)
+{
+    const int count = (N > 0) ? N : channelCount;
+    for (int channel = 0; channel < count; channel++)
+    {
+        samples[channel] = (static_cast<int>(codes[channel]) - 128)*SCOPE_CODE_SCALE;
+    }
+}
+
+static void ConvertWidePacketScalar(const quint8 *bytes, float *samples, int channelCount)
+{
+    for (int channel = 0; channel < channelCount; channel++)
+    {
+        const qint16 value = static_cast<qint16>(bytes[2*channel] | (bytes[2*channel + 1] << 8));
+        samples[channel] = value*SCOPE_WIDE_SCALE;
+    }
+}
+
+#ifdef SCOPE_SCAN_HAVE_SSE2
+SCOPE_SCAN_TARGET("sse2") static int FindMarkerSse2(const char *data, int size)
+{
+    // a byte is a marker if max(byte, 0xFE) == byte
+    const __m128i threshold = _mm_set1_epi8(static_cast<char>(0xFE));
+    int i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, threshold), v));
+        if (mask != 0)
+            return i + qCountTrailingZeroBits(static_cast<quint32>(mask));
+    }
+    return i + FindMarkerScalar(data + i, size - i);
+}
+
+template<int N>
+SCOPE_SCAN_TARGET("sse2") static void ConvertPacketSse2(const quint8 *codes, float *samples, int channelCount)
+{
+    const int count = (N > 0) ? N : channelCount;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i offset = _mm_set1_epi32(128);
+    const __m128 scale = _mm_set1_ps(SCOPE_CODE_SCALE);
+    int channel = 0;
+    for (; channel + 8 <= count; channel += 8)
+    {
+        const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(codes + channel)), zero);
+        const __m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(words, zero), offset);
+        const __m128i hi = _mm_sub_epi32(_mm_unpackhi_epi16(words, zero), offset);
+        _mm_storeu_ps(samples + channel,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(samples + channel + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    if (channel + 4 <= count)
+    {
+        quint32 packed;
+        std::memcpy(&packed, codes + channel, sizeof(packed));
+        const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(packed)), zero);
+        const __m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(words, zero), offset);
+        _mm_storeu_ps(samples + channel, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        channel += 4;
+    }
+    for (; channel < count; channel++)
+    {
+        samples[channel] = (static_cast<int>(codes[channel]) - 128)*SCOPE_CODE_SCALE;
+    }
+}
+// NOTE: the vector versions rely on x86 being little endian, like the wire format
+SCOPE_SCAN_TARGET("sse2") static void ConvertWidePacketSse2(const quint8 *bytes, float *samples, int channelCount)
+{
+    const __m128 scale = _mm_set1_ps(SCOPE_WIDE_SCALE);
+    int channel = 0;
+    for (; channel + 8 <= channelCount; channel += 8)
+    {
+        // sign extend by putting each word in the top half and shifting it back down
+        const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 2*channel));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+        _mm_storeu_ps(samples + channel,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(samples + channel + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    ConvertWidePacketScalar(bytes + 2*channel, samples + channel, channelCount - channel);
+}
+#endif // SCOPE_SCAN_HAVE_SSE2
+
+#ifdef SCOPE_SCAN_HAVE_AVX2
+SCOPE_SCAN_TARGET("avx2") static int FindMarkerAvx2(const char *data, int size)
+{
+    const __m256i threshold = _mm256_set1_epi8(static_cast<char>(0xFE));
+    int i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, threshold), v));
+        if (mask != 0)
+            return i + qCountTrailingZeroBits(static_cast<quint32>(mask));
+    }
+    return i + FindMarkerSse2(data + i, size - i);
+}
+
+template<int N>
+SCOPE_SCAN_TARGET("avx2") static void ConvertPacketAvx2(const quint8 *codes, float *samples, int channelCount)
+{
+    const int count = (N > 0) ? N : channelCount;
+    const __m256i offset = _mm256_set1_epi32(128);
+    const __m256 scale = _mm256_set1_ps(SCOPE_CODE_SCALE);
+    int channel = 0;
+    for (; channel + 8 <= count; channel += 8)
+    {
+        const __m256i ints = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(codes + channel))), offset);
+        _mm256_storeu_ps(samples + channel, _mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale));
+    }
+    // the 4 channel tail is no wider than SSE anyway
+    ConvertPacketSse2<0>(codes + channel, samples + channel, count - channel);
+}
+SCOPE_SCAN_TARGET("avx2") static void ConvertWidePacketAvx2(const quint8 *bytes, float *samples, int channelCount)
+{
+    const __m256 scale = _mm256_set1_ps(SCOPE_WIDE_SCALE);
+    int channel = 0;
+    for (; channel + 8 <= channelCount; channel += 8)
+    {
+        const __m256i ints = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 2*channel)));
+        _mm256_storeu_ps(samples + channel, _mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale));
+    }
+    ConvertWidePacketScalar(bytes + 2*channel, samples + channel, channelCount - channel);
+}
+#endif // SCOPE_SCAN_HAVE_AVX2
+
+typedef void (*ConvertPacketFunction)(const quint8 *codes, float *samples, int channelCount);
+
+struct ScanKernels
+{
+    ScopeScanIsa isa;
+    int (*findMarker)(const char *data, int size);
+    ConvertPacketFunction convertPacket4;
+    ConvertPacketFunction convertPacket8;
+    ConvertPacketFunction convertPacket16;
+    ConvertPacketFunction convertPacketGeneric;
+    ConvertPacketFunction convertWidePacket;
+};
+
+static ScanKernels KernelsForIsa(ScopeScanIsa isa)
+{
+    ScanKernels kernels = {SCOPE_SCAN_ISA_SCALAR, &FindMarkerScalar,
+        &ConvertPacketScalar<4>, &ConvertPacketScalar<8>, &ConvertPacketScalar<16>, &ConvertPacketScalar<0>,
+        &ConvertWidePacketScalar};
+#ifdef SCOPE_SCAN_HAVE_SSE2
+    if (isa >= SCOPE_SCAN_ISA_SSE2)
+    {
+        kernels.isa = SCOPE_SCAN_ISA_SSE2;
+        kernels.findMarker = &FindMarkerSse2;
+        kernels.convertPacket4 = &ConvertPacketSse2<4>;
+        kernels.convertPacket8 = &ConvertPacketSse2<8>;
+        kernels.convertPacket16 = &ConvertPacketSse2<16>;
+        kernels.convertPacketGeneric = &ConvertPacketSse2<0>;
+        kernels.convertWidePacket = &ConvertWidePacketSse2;
+    }
+#endif
+#ifdef SCOPE_SCAN_HAVE_AVX2
+    if (isa >= SCOPE_SCAN_ISA_AVX2)
+    {
+        kernels.isa = SCOPE_SCAN_ISA_AVX2;
+        kernels.findMarker = &FindMarkerAvx2;
+        kernels.convertPacket4 = &ConvertPacketAvx2<4>;
+        kernels.convertPacket8 = &ConvertPacketAvx2<8>;
+        kernels.convertPacket16 = &ConvertPacketAvx2<16>;
+        kernels.convertPacketGeneric = &ConvertPacketAvx2<0>;
+        kernels.convertWidePacket = &ConvertWidePacketAvx2;
+    }
+#endif
+    return kernels;
+}
+
+static ScanKernels & Kernels()
+{
+    static ScanKernels kernels = KernelsForIsa(ScopeScanBestIsa());
+    return kernels;
+}
+
+ScopeScanIsa ScopeScanBestIsa()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && defined(SCOPE_SCAN_HAVE_SSE2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SCOPE_SCAN_ISA_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SCOPE_SCAN_ISA_SSE2;
+    return SCOPE_SCAN_ISA_SCALAR;
+#elif defined(SCOPE_SCAN_HAVE_SSE2)
+    return SCOPE_SCAN_ISA_SSE2; // always present on x86-64
+#else
+    return SCOPE_SCAN_ISA_SCALAR;
+#endif
+}
+
+ScopeScanIsa ScopeScanCurrentIsa()
+{
+    return Kernels().isa;
+}
+
+const char * ScopeScanIsaName(ScopeScanIsa isa)
+{
+    switch (isa)
+    {
+        case SCOPE_SCAN_ISA_SSE2:
+        return "SSE2";
+
+        case SCOPE_SCAN_ISA_AVX2:
+        return "AVX2";
+
+        default:
+        return "scalar";
+    }
+}
+
+void ScopeScanSetIsa(ScopeScanIsa isa)
+{
+    Kernels() = KernelsForIsa(qMin(isa, ScopeScanBestIsa()));
+}
+
+int ScopeScanFindMarker(const char *data, int size)
+{
+    return Kernels().findMarker(data, size);
+}
+
+void ScopeScanConvertPacket(const quint8 *codes, float *samples, int channelCount)
+{
+    const ScanKernels &kernels = Kernels();
+    switch (channelCount)
+    {
+        case 4:
+        kernels.convertPacket4(codes, samples, channelCount);
+        break;
+
+        case 8:
+        kernels.convertPacket8(codes, samples, channelCount);
+        break;
+
+        case 16:
+        kernels.convertPacket16(codes, samples, channelCount);
+        break;
+
+        default:
+        kernels.convertPacketGeneric(codes, samples, channelCount);
+        break;
+    }
+}
+
+void ScopeScanConvertWidePacket(const quint8 *bytes, float *samples, int channelCount)
+{
+    Kernels().convertWidePacket(bytes, samples, channelCount);
+}
+
+// a byte at a time through a table, which is already far beyond
+// what a USB full speed link can deliver
+static const quint16 * Crc16Table()
+{
+    static quint16 table[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            quint16 crc = static_cast<quint16>(i << 8);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 0x8000) ? static_cast<quint16>((crc << 1) ^ 0x1021) : static_cast<quint16>(crc << 1);
+            table[i] = crc;
+        }
+        initialized = true;
+    }
+    return table;
+}
+
+quint16 ScopeScanCrc16(const quint8 *data, int size)
+{
+    static const quint16 * const table = Crc16Table();
+    quint16 crc = 0xFFFF;
+    for (int i = 0; i < size; i++)
+        crc = static_cast<quint16>((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+} // namespace STMBL_Servoterm
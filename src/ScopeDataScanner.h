@@ -0,0 +1,58 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPEDATASCANNER_H
+#define STMBL_SERVOTERM_SCOPEDATASCANNER_H
+
+#include <QtGlobal>
+
+namespace STMBL_Servoterm {
+
+// the kernels used by ScopeDataDemux, picked once at runtime
+// depending on what the CPU supports (it can be overridden
+// for benchmarking against the plain C++ implementation)
+enum ScopeScanIsa
+{
+    SCOPE_SCAN_ISA_SCALAR = 0,
+    SCOPE_SCAN_ISA_SSE2,
+    SCOPE_SCAN_ISA_AVX2
+};
+
+ScopeScanIsa ScopeScanBestIsa();
+ScopeScanIsa ScopeScanCurrentIsa();
+const char * ScopeScanIsaName(ScopeScanIsa isa);
+void ScopeScanSetIsa(ScopeScanIsa isa); // NOTE: clamped to ScopeScanBestIsa()
+
+// returns the offset of the first 0xFE/0xFF marker byte, or size if there is none
+int ScopeScanFindMarker(const char *data, int size);
+
+// converts one packet of channelCount unsigned codes to floats in [-1, 1)
+// NOTE: 4, 8 and 16 channels have their own unrolled kernels
+void ScopeScanConvertPacket(const quint8 *codes, float *samples, int channelCount);
+
+// converts the channelCount little endian 16-bit samples of an extended
+// frame to floats in [-1, 1)
+void ScopeScanConvertWidePacket(const quint8 *bytes, float *samples, int channelCount);
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), as used by extended frames
+quint16 ScopeScanCrc16(const quint8 *data, int size);
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPEDATASCANNER_H
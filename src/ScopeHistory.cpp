@@ -0,0 +1,393 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeHistory.h"
+#include "globals.h"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+
+namespace STMBL_Servoterm {
+
+static const int PYRAMID_BRANCHING = 16; // entries of a level per entry of the next
+static const quint64 MINIMUM_TOP_LEVEL_ENTRIES = 16;
+static const qint64 DEFAULT_BUDGET = 64 << 20;
+static const qint64 MINIMUM_FALLBACK_BUDGET = 1 << 20; // no history at all below this
+
+// the full scale of the codes, 128 for 8-bit ones and 32768 for 16-bit ones
+template<typename Code>
+static inline float CodeScale()
+{
+    return std::numeric_limits<Code>::max() + 1.0f;
+}
+
+template<typename Code>
+static inline Code SampleToCode(float sample)
+{
+    return static_cast<Code>(qBound<int>(std::numeric_limits<Code>::min(), qRound(sample*CodeScale<Code>()), std::numeric_limits<Code>::max()));
+}
+
+template<typename Code>
+static inline Code * Codes(QByteArray &ring)
+{
+    return reinterpret_cast<Code *>(ring.data());
+}
+
+template<typename Code>
+static inline const Code * Codes(const QByteArray &ring)
+{
+    return reinterpret_cast<const Code *>(ring.constData());
+}
+
+// whether all of the samples are 8-bit codes
+static bool FitsNarrowCodes(const float *samples, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const int code = qRound(samples[i]*CodeScale<qint16>());
+        if ((code & 0xFF) != 0 || code < -32768 || code > 32767)
+            return false;
+    }
+    return true;
+}
+
+ScopeHistory::ScopeHistory() :
+    _channelCount(SCOPE_CHANNEL_COUNT),
+    _codeBytes(1),
+    _budget(DEFAULT_BUDGET),
+    _allocatedBudget(-1),
+    _capacity(0),
+    _endPacket(0)
+{
+}
+
+void ScopeHistory::setBudget(qint64 bytes)
+{
+    _budget = qMax<qint64>(0, bytes);
+    clear();
+}
+
+qint64 ScopeHistory::budget() const
+{
+    return _budget;
+}
+
+qint64 ScopeHistory::allocatedBudget() const
+{
+    return _allocatedBudget;
+}
+
+void ScopeHistory::setChannelCount(int channelCount)
+{
+    if (channelCount == _channelCount)
+        return;
+    _channelCount = channelCount;
+    clear();
+}
+
+int ScopeHistory::channelCount() const
+{
+    return _channelCount;
+}
+
+int ScopeHistory::sampleBits() const
+{
+    return 8*_codeBytes;
+}
+
+void ScopeHistory::clear()
+{
+    // NOTE: the memory is only taken once there is something to keep
+    _levels.clear();
+    _codeBytes = 1;
+    _allocatedBudget = -1;
+    _capacity = 0;
+    _endPacket = 0;
+}
+
+quint64 ScopeHistory::capacity() const
+{
+    return _capacity;
+}
+
+quint64 ScopeHistory::firstPacket() const
+{
+    return (_endPacket > _capacity) ? _endPacket - _capacity : 0;
+}
+
+quint64 ScopeHistory::endPacket() const
+{
+    return _endPacket;
+}
+
+void ScopeHistory::append(const float *samples, int packetCount)
+{
+    if (_codeBytes == 1 && !FitsNarrowCodes(samples, packetCount*_channelCount))
+    {
+        clear();
+        _codeBytes = 2;
+    }
+    if (_allocatedBudget < 0)
+        _Allocate();
+    if (_capacity == 0)
+        return;
+    if (static_cast<quint64>(packetCount) > _capacity)
+    {
+        // only the newest ones fit anyway
+        const int skipped = packetCount - static_cast<int>(_capacity);
+        _endPacket += skipped;
+        samples += skipped*_channelCount;
+        packetCount -= skipped;
+    }
+    if (_codeBytes == 1)
+        _Append<qint8>(samples, packetCount);
+    else
+        _Append<qint16>(samples, packetCount);
+}
+
+void ScopeHistory::readColumns(qint64 first, int packetsPerColumn, int columnCount, float *columns, int &validFirst, int &validLast) const
+{
+    const qint64 kept = static_cast<qint64>(firstPacket());
+    const qint64 end = static_cast<qint64>(_endPacket);
+    validFirst = columnCount;
+    validLast = 0;
+    for (int column = 0; column < columnCount; column++)
+    {
+        const qint64 start = qMax(kept, first + static_cast<qint64>(column)*packetsPerColumn);
+        const qint64 stop = qMin(end, first + static_cast<qint64>(column + 1)*packetsPerColumn);
+        if (start >= stop)
+            continue;
+        validFirst = qMin(validFirst, column);
+        validLast = column + 1;
+    }
+    if (validFirst > validLast)
+        validFirst = validLast;
+    if (_codeBytes == 1)
+        _ReadColumns<qint8>(first, packetsPerColumn, columnCount, columns);
+    else
+        _ReadColumns<qint16>(first, packetsPerColumn, columnCount, columns);
+}
+
+void ScopeHistory::readPackets(quint64 first, int count, float *samples) const
+{
+    if (_codeBytes == 1)
+        _ReadPackets<qint8>(first, count, samples);
+    else
+        _ReadPackets<qint16>(first, count, samples);
+}
+
+void ScopeHistory::_Allocate()
+{
+    // NOTE: the bigger budgets don't fit a 32-bit address space, or
+    //       just not next to everything else, so settle for less
+    _allocatedBudget = 0;
+    for (qint64 budget = _budget; budget >= MINIMUM_FALLBACK_BUDGET || budget == _budget; budget /= 2)
+    {
+        if (_TryAllocate(budget))
+        {
+            _allocatedBudget = budget;
+            return;
+        }
+    }
+}
+
+bool ScopeHistory::_TryAllocate(qint64 budget)
+{
+    // the pyramid adds 2/15ths on top of the packets themselves
+    const qint64 bytesPerPacket = _channelCount*_codeBytes;
+    quint64 capacity = static_cast<quint64>(budget/(bytesPerPacket + 2*bytesPerPacket/(PYRAMID_BRANCHING - 1) + 1));
+    // NOTE: a ring can't grow beyond what a QByteArray holds
+    capacity = qMin<quint64>(capacity, static_cast<quint64>(std::numeric_limits<int>::max()/_codeBytes));
+    int levelCount = 1;
+    quint64 span = 1;
+    while (span*PYRAMID_BRANCHING*MINIMUM_TOP_LEVEL_ENTRIES <= capacity)
+    {
+        span *= PYRAMID_BRANCHING;
+        levelCount++;
+    }
+    capacity -= capacity % span; // NOTE: so every level's entries line up with the ring
+    _capacity = capacity;
+    if (_capacity == 0)
+        return true;
+    try
+    {
+        _levels.resize(levelCount);
+        span = 1;
+        for (int level = 0; level < levelCount; level++)
+        {
+            Level &entries = _levels[level];
+            entries.span = span;
+            entries.capacity = _capacity/span;
+            const int bytes = static_cast<int>(entries.capacity*_codeBytes);
+            entries.minimums.resize(_channelCount);
+            entries.maximums.resize(level == 0 ? 0 : _channelCount);
+            for (int channel = 0; channel < _channelCount; channel++)
+            {
+                entries.minimums[channel].resize(bytes);
+                if (level > 0)
+                    entries.maximums[channel].resize(bytes);
+            }
+            span *= PYRAMID_BRANCHING;
+        }
+    }
+    catch (const std::bad_alloc &)
+    {
+        _levels.clear();
+        _capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+template<typename Code>
+void ScopeHistory::_Append(const float *samples, int packetCount)
+{
+    const int C = _channelCount;
+    const int levelCount = _levels.size();
+    const quint64 first = _endPacket;
+    const quint64 end = first + packetCount;
+    for (int channel = 0; channel < C; channel++)
+    {
+        Code * const raw = Codes<Code>(_levels[0].minimums[channel]);
+        for (int i = 0; i < packetCount; i++)
+            raw[(first + i) % _capacity] = SampleToCode<Code>(samples[i*C + channel]);
+
+        // every entry completed by these packets is made up from its
+        // children, which were all completed before it (or just now)
+        for (int level = 1; level < levelCount; level++)
+        {
+            const Level &children = _levels[level - 1];
+            Level &entries = _levels[level];
+            const Code * const childMinimums = Codes<Code>(children.minimums[channel]);
+            const Code * const childMaximums = (level == 1) ? childMinimums : Codes<Code>(children.maximums[channel]);
+            Code * const minimums = Codes<Code>(entries.minimums[channel]);
+            Code * const maximums = Codes<Code>(entries.maximums[channel]);
+            for (quint64 entry = first/entries.span; entry < end/entries.span; entry++)
+            {
+                // NOTE: the children of an entry never straddle the end of their ring
+                const quint64 firstChild = (entry*PYRAMID_BRANCHING) % children.capacity;
+                Code minimum = childMinimums[firstChild];
+                Code maximum = childMaximums[firstChild];
+                for (quint64 child = firstChild + 1; child < firstChild + PYRAMID_BRANCHING; child++)
+                {
+                    minimum = qMin(minimum, childMinimums[child]);
+                    maximum = qMax(maximum, childMaximums[child]);
+                }
+                minimums[entry % entries.capacity] = minimum;
+                maximums[entry % entries.capacity] = maximum;
+            }
+        }
+    }
+    _endPacket = end;
+}
+
+template<typename Code>
+void ScopeHistory::_ReadColumns(qint64 first, int packetsPerColumn, int columnCount, float *columns) const
+{
+    const int C = _channelCount;
+    const qint64 kept = static_cast<qint64>(firstPacket());
+    const qint64 end = static_cast<qint64>(_endPacket);
+    const float scale = 1.0f/CodeScale<Code>();
+    // NOTE: a channel at a time, so each one's rings are walked in order
+    for (int channel = 0; channel < C; channel++)
+    {
+        for (int column = 0; column < columnCount; column++)
+        {
+            const qint64 start = qMax(kept, first + static_cast<qint64>(column)*packetsPerColumn);
+            const qint64 stop = qMin(end, first + static_cast<qint64>(column + 1)*packetsPerColumn);
+            if (start >= stop)
+                continue;
+            int minimum = std::numeric_limits<Code>::max();
+            int maximum = std::numeric_limits<Code>::min();
+            _FoldRange<Code>(channel, start, stop, minimum, maximum);
+            float * const out = columns + column*2*C;
+            out[channel] = minimum*scale;
+            out[C + channel] = maximum*scale;
+        }
+    }
+}
+
+template<typename Code>
+void ScopeHistory::_ReadPackets(quint64 first, int count, float *samples) const
+{
+    const int C = _channelCount;
+    const float scale = 1.0f/CodeScale<Code>();
+    for (int channel = 0; channel < C; channel++)
+    {
+        const Code * const raw = Codes<Code>(_levels[0].minimums[channel]);
+        for (int i = 0; i < count; i++)
+            samples[i*C + channel] = raw[(first + i) % _capacity]*scale;
+    }
+}
+
+template<typename Code>
+void ScopeHistory::_FoldEntries(int level, int channel, quint64 entry, quint64 count, int &minimum, int &maximum) const
+{
+    const Level &entries = _levels[level];
+    const Code * const minimums = Codes<Code>(entries.minimums[channel]);
+    const Code * const maximums = (level == 0) ? minimums : Codes<Code>(entries.maximums[channel]);
+    // NOTE: at most two contiguous runs, on either side of the end of the ring
+    quint64 index = entry % entries.capacity;
+    while (count > 0)
+    {
+        const quint64 run = qMin(count, entries.capacity - index);
+        Code runMinimum = static_cast<Code>(minimum);
+        Code runMaximum = static_cast<Code>(maximum);
+        for (quint64 i = index; i < index + run; i++)
+        {
+            runMinimum = qMin(runMinimum, minimums[i]);
+            runMaximum = qMax(runMaximum, maximums[i]);
+        }
+        minimum = runMinimum;
+        maximum = runMaximum;
+        count -= run;
+        index = 0;
+    }
+}
+
+template<typename Code>
+void ScopeHistory::_FoldRange(int channel, quint64 first, quint64 last, int &minimum, int &maximum) const
+{
+    // climb as long as a whole entry of the next level still fits,
+    // taking single entries until lined up with it...
+    const int levelCount = _levels.size();
+    int level = 0;
+    while (level + 1 < levelCount)
+    {
+        const quint64 span = _levels[level].span;
+        const quint64 nextSpan = _levels[level + 1].span;
+        const quint64 aligned = (first + nextSpan - 1)/nextSpan*nextSpan;
+        if (aligned + nextSpan > last)
+            break;
+        _FoldEntries<Code>(level, channel, first/span, (aligned - first)/span, minimum, maximum);
+        first = aligned;
+        level++;
+    }
+    // ...then take whole entries on the way back down
+    for (; level >= 0; level--)
+    {
+        const quint64 span = _levels[level].span;
+        const quint64 count = (last - first)/span;
+        _FoldEntries<Code>(level, channel, first/span, count, minimum, maximum);
+        first += count*span;
+    }
+}
+
+} // namespace STMBL_Servoterm
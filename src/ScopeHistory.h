@@ -0,0 +1,97 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPEHISTORY_H
+#define STMBL_SERVOTERM_SCOPEHISTORY_H
+
+#include <QVector>
+#include <QByteArray>
+
+namespace STMBL_Servoterm {
+
+// the deep memory behind the oscilloscope: a ring of the most recent
+// packets that fit the memory budget, plus a pyramid of minimums and
+// maximums over 16, 256, 4096, ... packets kept up to date as they come
+// in, so any stretch of it can be summarized into screen columns in
+// time proportional to the number of columns, not of packets
+// NOTE: every channel has rings of its own (the packets, and the
+//       minimums and maximums of every level), so going through a
+//       stretch of one channel is a sequential walk; the samples are
+//       kept as the drive's codes, 8 bits wide until the first sample
+//       that needs 16 (which starts the history over at half the
+//       packets, the 16-bit format being the rarer one)
+class ScopeHistory
+{
+public:
+    ScopeHistory();
+    void setBudget(qint64 bytes); // NOTE: clears the history
+    qint64 budget() const;
+    // what the history actually got, NOTE: less than the budget when the
+    // memory wasn't there (halved until it was), -1 until there are packets
+    qint64 allocatedBudget() const;
+    void setChannelCount(int channelCount); // NOTE: clears the history when it changes
+    int channelCount() const;
+    int sampleBits() const; // 8 or 16
+    void clear();
+    quint64 capacity() const; // in packets
+    quint64 firstPacket() const; // the oldest one still kept
+    quint64 endPacket() const; // one past the newest one
+    void append(const float *samples, int packetCount);
+    // summarizes columnCount columns of packetsPerColumn packets each,
+    // starting at the first packet, into the channels' minimums and then
+    // maximums per column; only the columns from validFirst up to
+    // validLast have any data (the rest are left alone)
+    void readColumns(qint64 first, int packetsPerColumn, int columnCount, float *columns, int &validFirst, int &validLast) const;
+    // copies count packets from the first one on, which must all still be kept
+    void readPackets(quint64 first, int count, float *samples) const;
+protected:
+    struct Level
+    {
+        quint64 capacity; // in entries
+        quint64 span; // packets per entry
+        // a ring of codes per channel, where level 0 holds the
+        // packets themselves and has no separate maximums
+        QVector<QByteArray> minimums;
+        QVector<QByteArray> maximums;
+    };
+    void _Allocate();
+    bool _TryAllocate(qint64 budget);
+    template<typename Code>
+    void _Append(const float *samples, int packetCount);
+    template<typename Code>
+    void _ReadColumns(qint64 first, int packetsPerColumn, int columnCount, float *columns) const;
+    template<typename Code>
+    void _ReadPackets(quint64 first, int count, float *samples) const;
+    template<typename Code>
+    void _FoldEntries(int level, int channel, quint64 entry, quint64 count, int &minimum, int &maximum) const;
+    template<typename Code>
+    void _FoldRange(int channel, quint64 first, quint64 last, int &minimum, int &maximum) const;
+
+    int _channelCount;
+    int _codeBytes; // 1 or 2
+    qint64 _budget;
+    qint64 _allocatedBudget; // NOTE: -1 until _Allocate() ran, which is only tried once
+    quint64 _capacity;
+    quint64 _endPacket;
+    QVector<Level> _levels;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPEHISTORY_H
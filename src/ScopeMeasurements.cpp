@@ -0,0 +1,117 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeMeasurements.h"
+#include "OscilloscopeRenderer.h"
+
+#include <QLabel>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+namespace STMBL_Servoterm {
+
+enum MeasurementColumn
+{
+    MEASUREMENT_MINIMUM = 0,
+    MEASUREMENT_MAXIMUM,
+    MEASUREMENT_PEAK_TO_PEAK,
+    MEASUREMENT_MEAN,
+    MEASUREMENT_RMS,
+    MEASUREMENT_FREQUENCY,
+    MEASUREMENT_COLUMN_COUNT
+};
+
+static QString FormatValue(float value)
+{
+    return QString::number(value, 'f', 4);
+}
+
+static QString FormatFrequency(double hertz)
+{
+    if (hertz <= 0.0)
+        return "-";
+    if (hertz >= 1e3)
+        return QString::number(hertz*1e-3, 'f', 3) + " kHz";
+    return QString::number(hertz, 'f', 2) + " Hz";
+}
+
+static QString FormatDuration(double seconds)
+{
+    if (seconds >= 1.0)
+        return QString::number(seconds, 'f', 3) + " s";
+    return QString::number(seconds*1e3, 'f', 2) + " ms";
+}
+
+ScopeMeasurements::ScopeMeasurements(QWidget *parent) :
+    QWidget(parent),
+    _titleLabel(new QLabel("Measurements")),
+    _table(new QTableWidget(0, MEASUREMENT_COLUMN_COUNT))
+{
+    _table->setHorizontalHeaderLabels(QStringList() << "Min" << "Max" << "P-P" << "Mean" << "RMS" << "Freq");
+    _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    _table->setSelectionMode(QAbstractItemView::NoSelection);
+    _table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    _table->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    QVBoxLayout * const vbox = new QVBoxLayout(this);
+    vbox->setContentsMargins(0, 0, 0, 0);
+    vbox->addWidget(_titleLabel);
+    vbox->addWidget(_table);
+}
+
+void ScopeMeasurements::setReport(const ScopeStatisticsReport &report)
+{
+    if (!isVisible())
+        return;
+    QString title = report.selection ? "Selection" : "Sweep";
+    if (report.duration > 0.0)
+        title += ", " + FormatDuration(report.duration);
+    _titleLabel->setText(title);
+
+    const int channelCount = report.channels.size();
+    if (_table->rowCount() != channelCount)
+    {
+        _table->setRowCount(channelCount);
+        for (int channel = 0; channel < channelCount; channel++)
+        {
+            QTableWidgetItem * const header = new QTableWidgetItem(QString("Ch %1").arg(channel + 1));
+            header->setForeground(ScopeChannelColor(channel));
+            _table->setVerticalHeaderItem(channel, header);
+            for (int column = 0; column < MEASUREMENT_COLUMN_COUNT; column++)
+            {
+                QTableWidgetItem * const item = new QTableWidgetItem;
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                _table->setItem(channel, column, item);
+            }
+        }
+    }
+    for (int channel = 0; channel < channelCount; channel++)
+    {
+        const ScopeChannelStatistics &statistics = report.channels.at(channel);
+        _table->item(channel, MEASUREMENT_MINIMUM)->setText(FormatValue(statistics.minimum));
+        _table->item(channel, MEASUREMENT_MAXIMUM)->setText(FormatValue(statistics.maximum));
+        _table->item(channel, MEASUREMENT_PEAK_TO_PEAK)->setText(FormatValue(statistics.peakToPeak()));
+        _table->item(channel, MEASUREMENT_MEAN)->setText(FormatValue(statistics.mean));
+        _table->item(channel, MEASUREMENT_RMS)->setText(FormatValue(statistics.rms));
+        _table->item(channel, MEASUREMENT_FREQUENCY)->setText(FormatFrequency(statistics.frequency));
+    }
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,50 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPEMEASUREMENTS_H
+#define STMBL_SERVOTERM_SCOPEMEASUREMENTS_H
+
+#include "ScopeStatistics.h"
+
+#include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QLabel;
+class QTableWidget;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// a table of the oscilloscope's measurements, a row per channel
+// NOTE: while hidden, the reports are just dropped
+class ScopeMeasurements : public QWidget
+{
+    Q_OBJECT
+public:
+    ScopeMeasurements(QWidget *parent = nullptr);
+public slots:
+    void setReport(const STMBL_Servoterm::ScopeStatisticsReport &report);
+protected:
+    QLabel *_titleLabel;
+    QTableWidget *_table;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPEMEASUREMENTS_H
@@ -0,0 +1,211 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeRecorder.h"
+#include "RecordingWorker.h"
+
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+static const int FLUSH_INTERVAL_MS = 500; // how long packets may wait in a batch that isn't full
+
+ScopeRecorder::ScopeRecorder(QObject *parent) :
+    QObject(parent),
+    _writerThread(new QThread(this)),
+    _worker(new RecordingWorker),
+    _flushTimer(new QTimer(this)),
+    _recording(false),
+    _format(RECORDING_FORMAT_NATIVE),
+    _recordingSerial(0),
+    _pendingOpens(0),
+    _batchIndex(-1),
+    _droppedPackets(0),
+    _overrun(false)
+{
+    qRegisterMetaType<quint32>("quint32");
+    _flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    connect(_flushTimer, &QTimer::timeout, this, &ScopeRecorder::slot_FlushTimeout);
+    _writerThread->setObjectName("RecordingWriter");
+    _worker->moveToThread(_writerThread);
+    connect(_worker, &RecordingWorker::opened, this, &ScopeRecorder::slot_WorkerOpened);
+    connect(_worker, &RecordingWorker::openFailed, this, &ScopeRecorder::slot_WorkerOpenFailed);
+    connect(_worker, &RecordingWorker::errorMessage, this, &ScopeRecorder::errorMessage);
+    _writerThread->start();
+}
+
+ScopeRecorder::~ScopeRecorder()
+{
+    stop();
+    _writerThread->quit();
+    _writerThread->wait();
+    _worker->close(); // NOTE: whatever the thread didn't get to, safe now that it is gone
+    delete _worker;
+}
+
+void ScopeRecorder::start(const QStringList &filePaths, int format)
+{
+    stop();
+    // NOTE: the worker may still be finishing the last recording, so the
+    //       packets are batched up from here on and written once it gets
+    //       to the new file (or thrown away if it can't be opened)
+    _recordingSerial++;
+    QMetaObject::invokeMethod(_worker, "open", Q_ARG(QStringList, filePaths), Q_ARG(int, format), Q_ARG(int, _recordingSerial));
+    _pendingOpens++;
+    _recording = true;
+    _format = format;
+    _droppedPackets = 0;
+    _overrun = false;
+    _flushTimer->start();
+}
+
+void ScopeRecorder::setConfigCRC(quint32 crc)
+{
+    QMetaObject::invokeMethod(_worker, "setConfigCRC", Q_ARG(quint32, crc));
+}
+
+void ScopeRecorder::stop()
+{
+    if (!_recording)
+        return;
+    _recording = false;
+    _flushTimer->stop();
+    _SubmitBatch();
+    QMetaObject::invokeMethod(_worker, "close");
+}
+
+bool ScopeRecorder::isRecording() const
+{
+    return _recording;
+}
+
+int ScopeRecorder::format() const
+{
+    return _format;
+}
+
+quint64 ScopeRecorder::droppedPackets() const
+{
+    return _droppedPackets;
+}
+
+void ScopeRecorder::append(const ScopeSampleBlock &block)
+{
+    if (!_recording || block.isEmpty())
+        return;
+    const int channelCount = block.channelCount;
+    const int packetCount = block.packetCount();
+    for (int packet = 0; packet < packetCount;)
+    {
+        RecordingBatch *batch = (_batchIndex >= 0) ? _worker->batch(_batchIndex) : nullptr;
+        if (batch && batch->channelCount != channelCount)
+        {
+            _SubmitBatch();
+            batch = nullptr;
+        }
+        if (!batch)
+            batch = _TakeBatch(channelCount);
+        if (!batch)
+        {
+            // every batch is still waiting to be written
+            _droppedPackets += packetCount - packet;
+            if (!_overrun)
+                emit errorMessage("The recording isn't keeping up, dropping packets!");
+            _overrun = true;
+            return;
+        }
+
+        // carry on with the last segment if the packets follow on from it
+        const double startTime = block.packetTime(packet);
+        bool follows = false;
+        if (batch->segmentCount > 0)
+        {
+            const RecordingSegment &last = batch->segments.at(batch->segmentCount - 1);
+            const double expected = last.startTime + (batch->packetCount - last.firstPacket)*last.packetPeriod;
+            const double tolerance = 0.5*qMax(last.packetPeriod, block.packetPeriod);
+            follows = (tolerance > 0.0) ? (std::fabs(startTime - expected) <= tolerance) : (startTime == expected);
+        }
+        if (!follows)
+        {
+            RecordingSegment &segment = batch->segments[batch->segmentCount++];
+            segment.firstPacket = batch->packetCount;
+            segment.startTime = startTime;
+            segment.packetPeriod = block.packetPeriod;
+        }
+
+        const int count = qMin(packetCount - packet, batch->packetCapacity() - batch->packetCount);
+        std::copy(block.packet(packet), block.packet(packet) + count*channelCount, batch->samples.data() + batch->packetCount*channelCount);
+        batch->packetCount += count;
+        packet += count;
+        if (batch->packetCount == batch->packetCapacity() || batch->segmentCount == RECORDING_BATCH_SEGMENTS)
+            _SubmitBatch();
+    }
+}
+
+void ScopeRecorder::slot_FlushTimeout()
+{
+    _SubmitBatch();
+}
+
+void ScopeRecorder::slot_WorkerOpened(const QString &filePath)
+{
+    // stale if it was stopped or started again since
+    if (--_pendingOpens > 0 || !_recording)
+        return;
+    emit started(filePath);
+}
+
+void ScopeRecorder::slot_WorkerOpenFailed(const QString &filePath)
+{
+    if (--_pendingOpens > 0 || !_recording)
+        return;
+    stop();
+    emit startFailed(filePath);
+}
+
+RecordingBatch * ScopeRecorder::_TakeBatch(int channelCount)
+{
+    int index;
+    if (_worker->freeBatches.read(&index, 1) != 1)
+        return nullptr;
+    RecordingBatch * const batch = _worker->batch(index);
+    batch->recording = _recordingSerial;
+    batch->channelCount = channelCount;
+    batch->packetCount = 0;
+    batch->segmentCount = 0;
+    _batchIndex = index;
+    _overrun = false;
+    return batch;
+}
+
+void ScopeRecorder::_SubmitBatch()
+{
+    if (_batchIndex < 0 || _worker->batch(_batchIndex)->packetCount == 0)
+        return;
+    _worker->filledBatches.tryWrite(&_batchIndex, 1); // NOTE: always fits, there are only as many batches
+    _batchIndex = -1;
+    if (_worker->markBatchesPending())
+        QMetaObject::invokeMethod(_worker, "writeBatches");
+}
+
+} // namespace STMBL_Servoterm
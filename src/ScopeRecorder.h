@@ -0,0 +1,84 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPERECORDER_H
+#define STMBL_SERVOTERM_SCOPERECORDER_H
+
+#include "ScopeSampleBlock.h"
+
+#include <QObject>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+class QTimer;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+class RecordingWorker;
+struct RecordingBatch;
+
+// records the scope packets to a file, either format of RecordingFormat
+// NOTE: the packets are only copied into a batch here, a RecordingWorker
+//       on its own thread opens the file, formats and writes them; when
+//       it falls so far behind that every batch is waiting for it,
+//       packets are dropped (and counted) rather than held on to, so the
+//       GUI never waits for the disk
+class ScopeRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    ScopeRecorder(QObject *parent = nullptr);
+    ~ScopeRecorder();
+    // NOTE: doesn't wait for the file, started() or startFailed() tell how it went;
+    //       the first of the paths that can be created new is used
+    void start(const QStringList &filePaths, int format);
+    void setConfigCRC(quint32 crc);
+    void stop(); // NOTE: doesn't wait, the file is finished on the writer thread
+    bool isRecording() const;
+    int format() const;
+    quint64 droppedPackets() const; // since starting
+    void append(const ScopeSampleBlock &block);
+signals:
+    void started(const QString &filePath);
+    void startFailed(const QString &filePath);
+    void errorMessage(const QString &errorMessage);
+protected slots:
+    void slot_FlushTimeout();
+    void slot_WorkerOpened(const QString &filePath);
+    void slot_WorkerOpenFailed(const QString &filePath);
+protected:
+    RecordingBatch * _TakeBatch(int channelCount);
+    void _SubmitBatch();
+
+    QThread *_writerThread;
+    RecordingWorker *_worker;
+    QTimer *_flushTimer;
+    bool _recording;
+    int _format;
+    int _recordingSerial; // counts the start()s, so the worker can tell the batches apart
+    int _pendingOpens; // NOTE: only the outcome of the latest one matters
+    int _batchIndex; // the batch being filled, -1 if none
+    quint64 _droppedPackets;
+    bool _overrun; // NOTE: so it is reported once, not for every block
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPERECORDER_H
@@ -0,0 +1,621 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeRecording.h"
+#include "ScopeCsv.h"
+
+#include <QDateTime>
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+
+namespace STMBL_Servoterm {
+
+static const char RECORDING_MAGIC[] = "STMBLREC";
+static const int RECORDING_MAGIC_LENGTH = 8;
+static const quint32 RECORDING_VERSION = 1;
+static const int RECORDING_HEADER_SIZE = 80;
+static const char CHUNK_MAGIC[] = "CHNK";
+static const int CHUNK_HEADER_SIZE = 40;
+static const char INDEX_MAGIC[] = "SIDX";
+static const int INDEX_HEADER_SIZE = 8;
+static const int INDEX_ENTRY_SIZE = 32;
+static const quint32 FLAG_CONFIG_CRC_KNOWN = 1u << 0;
+static const int CSV_FLUSH_SIZE = 1024*1024;
+
+static void AppendU32(QByteArray &buffer, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    buffer.append(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+}
+
+static void AppendU64(QByteArray &buffer, quint64 value)
+{
+    uchar bytes[8];
+    qToLittleEndian<quint64>(value, bytes);
+    buffer.append(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+}
+
+static void AppendF64(QByteArray &buffer, double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    AppendU64(buffer, bits);
+}
+
+static quint32 ReadU32(const uchar *data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+static quint64 ReadU64(const uchar *data)
+{
+    return qFromLittleEndian<quint64>(data);
+}
+
+static double ReadF64(const uchar *data)
+{
+    const quint64 bits = ReadU64(data);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// the columns are padded so the next one starts 8-byte aligned
+static int ColumnStride(int packetCount, int codeBytes)
+{
+    return (packetCount*codeBytes + 7) & ~7;
+}
+
+// the full scale of the codes, like ScopeHistory keeps them
+static float CodeScale(int codeBytes)
+{
+    return (codeBytes == 1) ? 128.0f : 32768.0f;
+}
+
+// whether all of the samples are 8-bit codes
+static bool FitsNarrowCodes(const float *samples, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const int code = qRound(samples[i]*32768.0f);
+        if ((code & 0xFF) != 0 || code < -32768 || code > 32767)
+            return false;
+    }
+    return true;
+}
+
+ScopeRecordingWriter::ScopeRecordingWriter() :
+    _channelCount(0),
+    _configCRCKnown(false),
+    _configCRC(0),
+    _startDateTime(0),
+    _packetCount(0),
+    _fileOffset(0),
+    _lastPacketPeriod(0.0),
+    _chunkPackets(0),
+    _chunkCodeBytes(1),
+    _chunkFirstPacket(0),
+    _chunkStartTime(0.0),
+    _chunkPacketPeriod(0.0),
+    _chunkCount(0)
+{
+}
+
+ScopeRecordingWriter::~ScopeRecordingWriter()
+{
+    close();
+}
+
+bool ScopeRecordingWriter::open(const QString &filePath)
+{
+    close();
+    _file.setFileName(filePath);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::NewOnly))
+        return false;
+#else
+    if (_file.exists() || !_file.open(QIODevice::WriteOnly))
+        return false;
+#endif
+    _channelCount = 0;
+    _configCRCKnown = false;
+    _configCRC = 0;
+    _startDateTime = QDateTime::currentMSecsSinceEpoch();
+    _packetCount = 0;
+    _lastPacketPeriod = 0.0;
+    _chunkPackets = 0;
+    _index.resize(0);
+    _chunkCount = 0;
+    _WriteHeader(0); // NOTE: a placeholder until closing
+    _fileOffset = RECORDING_HEADER_SIZE;
+    return true;
+}
+
+bool ScopeRecordingWriter::isOpen() const
+{
+    return _file.isOpen();
+}
+
+QString ScopeRecordingWriter::fileName() const
+{
+    return _file.fileName();
+}
+
+void ScopeRecordingWriter::setConfigCRC(quint32 crc)
+{
+    _configCRCKnown = true;
+    _configCRC = crc;
+}
+
+void ScopeRecordingWriter::append(const ScopeSampleBlock &block)
+{
+    append(block.samples.constData(), block.packetCount(), block.channelCount, block.startTime, block.packetPeriod);
+}
+
+void ScopeRecordingWriter::append(const float *samples, int packetCount, int channelCount, double startTime, double packetPeriod)
+{
+    if (!_file.isOpen() || packetCount == 0)
+        return;
+    if (_channelCount == 0)
+    {
+        // the header says so straight away, so what makes it to the
+        // disk can be read even if the recording is never closed
+        _channelCount = channelCount;
+        _columns.resize(_channelCount);
+        for (int channel = 0; channel < _channelCount; channel++)
+            _columns[channel].resize(RECORDING_CHUNK_PACKETS*2);
+        _chunk.reserve(CHUNK_HEADER_SIZE + _channelCount*RECORDING_CHUNK_PACKETS*2);
+        _file.seek(0);
+        _WriteHeader(0);
+        _file.seek(_fileOffset);
+    }
+    if (channelCount != _channelCount)
+        return;
+    const int codeBytes = FitsNarrowCodes(samples, packetCount*channelCount) ? 1 : 2;
+
+    // carry on with the chunk so far if the block is where its
+    // timeline says it should be, and its codes fit
+    if (_chunkPackets > 0)
+    {
+        const double expected = _chunkStartTime + _chunkPackets*_chunkPacketPeriod;
+        const double tolerance = 0.5*qMax(_chunkPacketPeriod, packetPeriod);
+        if (codeBytes > _chunkCodeBytes || std::fabs(startTime - expected) > tolerance
+         || (tolerance == 0.0 && startTime != expected))
+            _FinishChunk();
+    }
+    _lastPacketPeriod = packetPeriod;
+
+    // transpose the packets into the columns
+    for (int packet = 0; packet < packetCount;)
+    {
+        if (_chunkPackets == 0)
+            _StartChunk(startTime + packet*packetPeriod, packetPeriod, codeBytes);
+        const int count = qMin(packetCount - packet, RECORDING_CHUNK_PACKETS - _chunkPackets);
+        const float chunkScale = CodeScale(_chunkCodeBytes);
+        for (int channel = 0; channel < _channelCount; channel++)
+        {
+            const float * const channelSamples = samples + packet*_channelCount + channel;
+            uchar * const column = reinterpret_cast<uchar *>(_columns[channel].data());
+            if (_chunkCodeBytes == 1)
+            {
+                qint8 * const codes = reinterpret_cast<qint8 *>(column) + _chunkPackets;
+                for (int i = 0; i < count; i++)
+                    codes[i] = static_cast<qint8>(qBound(-128, qRound(channelSamples[i*_channelCount]*chunkScale), 127));
+            }
+            else
+            {
+                uchar * const codes = column + _chunkPackets*2;
+                for (int i = 0; i < count; i++)
+                    qToLittleEndian<qint16>(static_cast<qint16>(qBound(-32768, qRound(channelSamples[i*_channelCount]*chunkScale), 32767)), codes + i*2);
+            }
+        }
+        _chunkPackets += count;
+        _packetCount += count;
+        packet += count;
+        if (_chunkPackets == RECORDING_CHUNK_PACKETS)
+            _FinishChunk();
+    }
+}
+
+void ScopeRecordingWriter::close()
+{
+    if (!_file.isOpen())
+        return;
+    _FinishChunk();
+
+    // the index goes at the end, then the header can point at it
+    const quint64 indexOffset = _fileOffset;
+    QByteArray index;
+    index.reserve(INDEX_HEADER_SIZE + _index.size());
+    index.append(INDEX_MAGIC, 4);
+    AppendU32(index, static_cast<quint32>(_chunkCount));
+    index.append(_index);
+    _file.write(index);
+    _file.seek(0);
+    _WriteHeader(indexOffset);
+    _file.close();
+}
+
+QFileDevice::FileError ScopeRecordingWriter::error() const
+{
+    return _file.error();
+}
+
+void ScopeRecordingWriter::_WriteHeader(quint64 indexOffset)
+{
+    QByteArray header;
+    header.reserve(RECORDING_HEADER_SIZE);
+    header.append(RECORDING_MAGIC, RECORDING_MAGIC_LENGTH);
+    AppendU32(header, RECORDING_VERSION);
+    AppendU32(header, RECORDING_HEADER_SIZE);
+    AppendU32(header, static_cast<quint32>(_channelCount));
+    AppendU32(header, _configCRCKnown ? FLAG_CONFIG_CRC_KNOWN : 0);
+    AppendU32(header, _configCRC);
+    AppendU32(header, 0);
+    AppendU64(header, static_cast<quint64>(_startDateTime));
+    AppendF64(header, _lastPacketPeriod);
+    AppendU64(header, _packetCount);
+    AppendU64(header, indexOffset);
+    AppendU64(header, _chunkCount);
+    AppendU64(header, 0);
+    _file.write(header);
+}
+
+void ScopeRecordingWriter::_StartChunk(double startTime, double packetPeriod, int codeBytes)
+{
+    _chunkPackets = 0;
+    _chunkCodeBytes = codeBytes;
+    _chunkFirstPacket = _packetCount;
+    _chunkStartTime = startTime;
+    _chunkPacketPeriod = packetPeriod;
+}
+
+void ScopeRecordingWriter::_FinishChunk()
+{
+    if (_chunkPackets == 0)
+        return;
+    const int stride = ColumnStride(_chunkPackets, _chunkCodeBytes);
+    const int columnBytes = _chunkPackets*_chunkCodeBytes;
+    _chunk.resize(0);
+    _chunk.append(CHUNK_MAGIC, 4);
+    AppendU32(_chunk, static_cast<quint32>(_chunkPackets));
+    AppendU32(_chunk, static_cast<quint32>(_chunkCodeBytes));
+    AppendU32(_chunk, 0);
+    AppendU64(_chunk, _chunkFirstPacket);
+    AppendF64(_chunk, _chunkStartTime);
+    AppendF64(_chunk, _chunkPacketPeriod);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        _chunk.append(_columns[channel].constData(), columnBytes);
+        _chunk.append(stride - columnBytes, '\0');
+    }
+    _file.write(_chunk);
+
+    AppendU64(_index, _fileOffset);
+    AppendU64(_index, _chunkFirstPacket);
+    AppendF64(_index, _chunkStartTime);
+    AppendU32(_index, static_cast<quint32>(_chunkPackets));
+    AppendU32(_index, static_cast<quint32>(_chunkCodeBytes));
+    _fileOffset += _chunk.size();
+    _chunkCount++;
+    _chunkPackets = 0;
+}
+
+ScopeRecordingReader::ScopeRecordingReader() :
+    _data(nullptr),
+    _size(0),
+    _channelCount(0),
+    _flags(0),
+    _configCRC(0),
+    _startDateTime(0),
+    _packetPeriod(0.0),
+    _packetCount(0)
+{
+}
+
+ScopeRecordingReader::~ScopeRecordingReader()
+{
+    close();
+}
+
+bool ScopeRecordingReader::open(const QString &filePath)
+{
+    close();
+    _file.setFileName(filePath);
+    if (!_file.open(QIODevice::ReadOnly))
+        return false;
+    _size = _file.size();
+    _data = (_size >= RECORDING_HEADER_SIZE) ? _file.map(0, _size) : nullptr;
+    if (!_data
+     || std::memcmp(_data, RECORDING_MAGIC, RECORDING_MAGIC_LENGTH) != 0
+     || ReadU32(_data + 8) != RECORDING_VERSION
+     || ReadU32(_data + 12) < static_cast<quint32>(RECORDING_HEADER_SIZE)
+     || ReadU32(_data + 16) == 0
+     || ReadU32(_data + 16) > static_cast<quint32>(SCOPE_MAXIMUM_CHANNEL_COUNT))
+    {
+        close();
+        return false;
+    }
+    _channelCount = static_cast<int>(ReadU32(_data + 16));
+    _flags = ReadU32(_data + 20);
+    _configCRC = ReadU32(_data + 24);
+    _startDateTime = static_cast<qint64>(ReadU64(_data + 32));
+    _packetPeriod = ReadF64(_data + 40);
+    const quint64 indexOffset = ReadU64(_data + 56);
+    const quint64 chunkCount = ReadU64(_data + 64);
+    // NOTE: a recording that was never closed has no index
+    if (!(indexOffset != 0 ? _ReadIndex(indexOffset, chunkCount) : _ScanChunks()))
+    {
+        close();
+        return false;
+    }
+    _packetCount = _index.isEmpty() ? 0 : _index.last().firstPacket + _index.last().packetCount;
+    return true;
+}
+
+bool ScopeRecordingReader::isOpen() const
+{
+    return _file.isOpen();
+}
+
+void ScopeRecordingReader::close()
+{
+    if (_data)
+        _file.unmap(const_cast<uchar *>(_data));
+    _data = nullptr;
+    _size = 0;
+    _index.clear();
+    _packetCount = 0;
+    if (_file.isOpen())
+        _file.close();
+}
+
+int ScopeRecordingReader::channelCount() const
+{
+    return _channelCount;
+}
+
+bool ScopeRecordingReader::isConfigCRCKnown() const
+{
+    return (_flags & FLAG_CONFIG_CRC_KNOWN) != 0;
+}
+
+quint32 ScopeRecordingReader::configCRC() const
+{
+    return _configCRC;
+}
+
+qint64 ScopeRecordingReader::startDateTime() const
+{
+    return _startDateTime;
+}
+
+double ScopeRecordingReader::packetPeriod() const
+{
+    return _packetPeriod;
+}
+
+quint64 ScopeRecordingReader::packetCount() const
+{
+    return _packetCount;
+}
+
+int ScopeRecordingReader::chunkCount() const
+{
+    return _index.size();
+}
+
+ScopeRecordingChunk ScopeRecordingReader::chunk(int index) const
+{
+    const IndexEntry &entry = _index[index];
+    const uchar * const header = _data + entry.offset;
+    ScopeRecordingChunk chunk;
+    chunk.firstPacket = entry.firstPacket;
+    chunk.packetCount = entry.packetCount;
+    chunk.codeBytes = entry.codeBytes;
+    chunk.startTime = entry.startTime;
+    chunk.packetPeriod = ReadF64(header + 32);
+    chunk.columns = header + CHUNK_HEADER_SIZE;
+    chunk.columnStride = ColumnStride(entry.packetCount, entry.codeBytes);
+    return chunk;
+}
+
+int ScopeRecordingReader::findChunk(quint64 packet) const
+{
+    // the last chunk starting at or before the packet
+    int low = 0;
+    int high = _index.size();
+    while (low < high)
+    {
+        const int middle = (low + high)/2;
+        if (_index[middle].firstPacket <= packet)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == 0 || packet >= _index[low - 1].firstPacket + _index[low - 1].packetCount)
+        return -1;
+    return low - 1;
+}
+
+void ScopeRecordingReader::readChunk(int index, ScopeSampleBlock &block) const
+{
+    const ScopeRecordingChunk c = chunk(index);
+    block.channelCount = _channelCount;
+    block.startTime = c.startTime;
+    block.packetPeriod = c.packetPeriod;
+    block.samples.resize(c.packetCount*_channelCount);
+    readPackets(c.firstPacket, c.packetCount, block.samples.data());
+}
+
+int ScopeRecordingReader::readPackets(quint64 first, int count, float *samples) const
+{
+    int done = 0;
+    for (int index = findChunk(first); index >= 0 && index < _index.size() && done < count; index++)
+    {
+        const ScopeRecordingChunk c = chunk(index);
+        const int offset = static_cast<int>(first + done - c.firstPacket);
+        const int n = qMin(count - done, c.packetCount - offset);
+        const float scale = 1.0f/CodeScale(c.codeBytes);
+        for (int channel = 0; channel < _channelCount; channel++)
+        {
+            const uchar * const column = c.columns + channel*c.columnStride;
+            float * const out = samples + done*_channelCount + channel;
+            if (c.codeBytes == 1)
+            {
+                const qint8 * const codes = reinterpret_cast<const qint8 *>(column) + offset;
+                for (int i = 0; i < n; i++)
+                    out[i*_channelCount] = codes[i]*scale;
+            }
+            else
+            {
+                const uchar * const codes = column + offset*2;
+                for (int i = 0; i < n; i++)
+                    out[i*_channelCount] = qFromLittleEndian<qint16>(codes + i*2)*scale;
+            }
+        }
+        done += n;
+    }
+    return done;
+}
+
+bool ScopeRecordingReader::_ReadIndex(quint64 offset, quint64 count)
+{
+    if (offset + INDEX_HEADER_SIZE > static_cast<quint64>(_size)
+     || std::memcmp(_data + offset, INDEX_MAGIC, 4) != 0
+     || ReadU32(_data + offset + 4) != count
+     || (static_cast<quint64>(_size) - offset - INDEX_HEADER_SIZE)/INDEX_ENTRY_SIZE < count)
+        return false;
+    _index.resize(static_cast<int>(count));
+    const uchar *entries = _data + offset + INDEX_HEADER_SIZE;
+    quint64 nextPacket = 0;
+    for (int i = 0; i < _index.size(); i++, entries += INDEX_ENTRY_SIZE)
+    {
+        IndexEntry &entry = _index[i];
+        entry.offset = ReadU64(entries);
+        entry.firstPacket = ReadU64(entries + 8);
+        entry.startTime = ReadF64(entries + 16);
+        entry.packetCount = static_cast<int>(ReadU32(entries + 24));
+        entry.codeBytes = static_cast<int>(ReadU32(entries + 28));
+        // NOTE: so a damaged index can't point outside of the file
+        IndexEntry check;
+        if (entry.firstPacket != nextPacket || !_ReadChunkHeader(entry.offset, check)
+         || check.firstPacket != entry.firstPacket || check.packetCount != entry.packetCount || check.codeBytes != entry.codeBytes)
+            return false;
+        nextPacket += entry.packetCount;
+    }
+    return true;
+}
+
+bool ScopeRecordingReader::_ScanChunks()
+{
+    // whatever whole chunks made it to the disk
+    quint64 offset = RECORDING_HEADER_SIZE;
+    quint64 nextPacket = 0;
+    IndexEntry entry;
+    while (_ReadChunkHeader(offset, entry) && entry.firstPacket == nextPacket)
+    {
+        _index.append(entry);
+        offset += _ChunkSize(entry);
+        nextPacket += entry.packetCount;
+    }
+    return true;
+}
+
+bool ScopeRecordingReader::_ReadChunkHeader(quint64 offset, IndexEntry &entry) const
+{
+    if (offset < static_cast<quint64>(RECORDING_HEADER_SIZE) || offset + CHUNK_HEADER_SIZE > static_cast<quint64>(_size)
+     || std::memcmp(_data + offset, CHUNK_MAGIC, 4) != 0)
+        return false;
+    const uchar * const header = _data + offset;
+    const quint32 packetCount = ReadU32(header + 4);
+    const quint32 codeBytes = ReadU32(header + 8);
+    if (packetCount == 0 || packetCount > static_cast<quint32>(RECORDING_CHUNK_PACKETS) || (codeBytes != 1 && codeBytes != 2))
+        return false;
+    entry.offset = offset;
+    entry.packetCount = static_cast<int>(packetCount);
+    entry.codeBytes = static_cast<int>(codeBytes);
+    entry.firstPacket = ReadU64(header + 16);
+    entry.startTime = ReadF64(header + 24);
+    return offset + _ChunkSize(entry) <= static_cast<quint64>(_size);
+}
+
+qint64 ScopeRecordingReader::_ChunkSize(const IndexEntry &entry) const
+{
+    return CHUNK_HEADER_SIZE + static_cast<qint64>(_channelCount)*ColumnStride(entry.packetCount, entry.codeBytes);
+}
+
+ScopeRecordingConverter::ScopeRecordingConverter(QObject *parent) :
+    QObject(parent),
+    _cancelled(false)
+{
+}
+
+void ScopeRecordingConverter::cancel()
+{
+    _cancelled.store(true, std::memory_order_relaxed);
+}
+
+void ScopeRecordingConverter::convert(const QString &recordingPath, const QString &csvPath)
+{
+    _cancelled.store(false, std::memory_order_relaxed);
+    const bool converted = _Convert(recordingPath, csvPath);
+    if (!converted)
+        QFile::remove(csvPath); // NOTE: rather than leave half of it behind
+    emit finished(converted, recordingPath, csvPath);
+}
+
+bool ScopeRecordingConverter::_Convert(const QString &recordingPath, const QString &csvPath)
+{
+    ScopeRecordingReader reader;
+    if (!reader.open(recordingPath))
+        return false;
+    QFile csvFile(csvPath);
+    if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    ScopeSampleBlock block;
+    QByteArray lines;
+    lines.reserve(CSV_FLUSH_SIZE + 64*1024);
+    int lastPercent = -1;
+    for (int index = 0; index < reader.chunkCount(); index++)
+    {
+        if (_cancelled.load(std::memory_order_relaxed))
+            return false;
+        reader.readChunk(index, block);
+        AppendScopeCsvLines(lines, block);
+        if (lines.size() >= CSV_FLUSH_SIZE)
+        {
+            if (csvFile.write(lines) != lines.size())
+                return false;
+            lines.resize(0);
+        }
+        const int percent = int((index + 1)*qint64(100)/reader.chunkCount());
+        if (percent != lastPercent)
+        {
+            lastPercent = percent;
+            emit progress(percent);
+        }
+    }
+    return csvFile.write(lines) == lines.size();
+}
+
+} // namespace STMBL_Servoterm
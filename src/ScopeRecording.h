@@ -0,0 +1,195 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPERECORDING_H
+#define STMBL_SERVOTERM_SCOPERECORDING_H
+
+#include "ScopeSampleBlock.h"
+
+#include <QObject>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+namespace STMBL_Servoterm {
+
+enum RecordingFormat
+{
+    RECORDING_FORMAT_NATIVE = 0, // see ScopeRecordingWriter
+    RECORDING_FORMAT_CSV // see AppendScopeCsvLines()
+};
+
+// recorded scope data, kept as the drive's codes a column per channel
+//
+// file layout (everything little-endian, every part starting 8-byte aligned):
+//     header, 80 bytes:
+//         "STMBLREC" magic, u32 version, u32 header size
+//         u32 channel count, u32 flags (bit 0: the config CRC is known)
+//         u32 config CRC (see CalculateConfigCRC()), u32 reserved
+//         s64 wall clock time the recording started, in ms since the epoch (UTC)
+//         f64 packet period in seconds (the last estimate, 0 if unknown)
+//         u64 packet count, u64 index offset, u64 chunk count
+//         8 reserved bytes
+//     then chunks of up to RECORDING_CHUNK_PACKETS packets:
+//         "CHNK" magic, u32 packet count, u32 code bytes (1 or 2), u32 reserved
+//         u64 first packet, f64 time of the first packet (seconds since
+//         connecting), f64 packet period (0 if unknown)
+//         a column of codes per channel, each padded to 8 bytes
+//     then the index, at the offset in the header:
+//         "SIDX" magic, u32 chunk count
+//         per chunk: u64 file offset, u64 first packet, f64 time, u32 packet count, u32 code bytes
+// the header is written again when the recording is closed, with the
+// config CRC, packet period, packet count and where the index is; a file
+// that wasn't closed (0 index offset) is read by walking the chunks instead
+// NOTE: the packets of a chunk follow one steady packet period, the
+//       writer starts a new one whenever the host's time stamps stray
+//       from that by half a packet or more; blocks with another channel
+//       count than the first one are left out
+
+static const char RECORDING_FILE_SUFFIX[] = "stmblrec";
+static const char RECORDING_CSV_SUFFIX[] = "csv";
+static const int RECORDING_CHUNK_PACKETS = 65536;
+
+class ScopeRecordingWriter
+{
+public:
+    ScopeRecordingWriter();
+    ~ScopeRecordingWriter();
+    bool open(const QString &filePath); // NOTE: the channel count is the first block's
+    bool isOpen() const;
+    QString fileName() const;
+    void setConfigCRC(quint32 crc);
+    void append(const ScopeSampleBlock &block);
+    void append(const float *samples, int packetCount, int channelCount, double startTime, double packetPeriod);
+    void close();
+    QFileDevice::FileError error() const; // of the last write
+protected:
+    void _WriteHeader(quint64 indexOffset);
+    void _StartChunk(double startTime, double packetPeriod, int codeBytes);
+    void _FinishChunk();
+
+    QFile _file;
+    int _channelCount;
+    bool _configCRCKnown;
+    quint32 _configCRC;
+    qint64 _startDateTime;
+    quint64 _packetCount;
+    quint64 _fileOffset; // where the next chunk goes
+    double _lastPacketPeriod;
+    // the chunk being filled
+    QVector<QByteArray> _columns; // NOTE: reserved for a whole chunk up front
+    int _chunkPackets;
+    int _chunkCodeBytes;
+    quint64 _chunkFirstPacket;
+    double _chunkStartTime;
+    double _chunkPacketPeriod;
+    QByteArray _chunk; // where a finished chunk is put together, so it's one write
+    QByteArray _index; // the entries, written out on close
+    quint64 _chunkCount;
+};
+
+// a chunk of a recording, pointing into the mapped file
+struct ScopeRecordingChunk
+{
+    ScopeRecordingChunk() : firstPacket(0), packetCount(0), codeBytes(1), startTime(0.0), packetPeriod(0.0), columns(nullptr), columnStride(0) {}
+    double packetTime(int index) const {return startTime + index*packetPeriod;}
+
+    quint64 firstPacket;
+    int packetCount;
+    int codeBytes;
+    double startTime;
+    double packetPeriod;
+    const uchar *columns; // the first channel's, the others follow every columnStride bytes
+    int columnStride;
+};
+
+// maps a recording into memory, so any stretch of it can be read
+// without going through the rest
+class ScopeRecordingReader
+{
+public:
+    ScopeRecordingReader();
+    ~ScopeRecordingReader();
+    bool open(const QString &filePath); // NOTE: false if it isn't a recording (or is damaged)
+    bool isOpen() const;
+    void close();
+    int channelCount() const;
+    bool isConfigCRCKnown() const;
+    quint32 configCRC() const;
+    qint64 startDateTime() const; // in ms since the epoch (UTC)
+    double packetPeriod() const;
+    quint64 packetCount() const;
+    int chunkCount() const;
+    ScopeRecordingChunk chunk(int index) const;
+    int findChunk(quint64 packet) const; // -1 if the recording doesn't have it
+    // the given chunk as samples, like they were received
+    void readChunk(int index, ScopeSampleBlock &block) const;
+    // copies count packets from the first one on, returns how many there were
+    int readPackets(quint64 first, int count, float *samples) const;
+protected:
+    struct IndexEntry
+    {
+        quint64 offset;
+        quint64 firstPacket;
+        double startTime;
+        int packetCount;
+        int codeBytes;
+    };
+    bool _ReadIndex(quint64 offset, quint64 count);
+    bool _ScanChunks();
+    bool _ReadChunkHeader(quint64 offset, IndexEntry &entry) const;
+    qint64 _ChunkSize(const IndexEntry &entry) const;
+
+    QFile _file;
+    const uchar *_data;
+    qint64 _size;
+    int _channelCount;
+    quint32 _flags;
+    quint32 _configCRC;
+    qint64 _startDateTime;
+    double _packetPeriod;
+    quint64 _packetCount;
+    QVector<IndexEntry> _index;
+};
+
+// writes a recording out as ScopeCsv lines, which for a big one takes
+// minutes (and ten times the disk space), so it lives on a thread of its own
+class ScopeRecordingConverter : public QObject
+{
+    Q_OBJECT
+public:
+    ScopeRecordingConverter(QObject *parent = nullptr);
+    void cancel(); // NOTE: safe to call from any thread, the partial CSV is removed
+public slots:
+    void convert(const QString &recordingPath, const QString &csvPath);
+signals:
+    void progress(int percent);
+    void finished(bool converted, const QString &recordingPath, const QString &csvPath);
+protected:
+    bool _Convert(const QString &recordingPath, const QString &csvPath);
+
+    std::atomic<bool> _cancelled;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SCOPERECORDING_H
@@ -0,0 +1,52 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPESAMPLEBLOCK_H
+#define STMBL_SERVOTERM_SCOPESAMPLEBLOCK_H
+
+#include "globals.h"
+
+#include <QMetaType>
+#include <QVector>
+
+namespace STMBL_Servoterm {
+
+// a contiguous run of scope packets, stored packet after packet,
+// so "samples" holds packetCount()*channelCount values
+// NOTE: the times are in seconds since connecting, with a packetPeriod
+//       of 0 while the drive's rate hasn't been worked out yet
+struct ScopeSampleBlock
+{
+    ScopeSampleBlock() : channelCount(SCOPE_CHANNEL_COUNT), startTime(0.0), packetPeriod(0.0) {}
+    int packetCount() const {return channelCount > 0 ? samples.size()/channelCount : 0;}
+    bool isEmpty() const {return samples.isEmpty();}
+    const float * packet(int index) const {return samples.constData() + index*channelCount;}
+    double packetTime(int index) const {return startTime + index*packetPeriod;}
+
+    int channelCount;
+    double startTime; // of the first packet
+    double packetPeriod;
+    QVector<float> samples;
+};
+
+} // namespace STMBL_Servoterm
+
+Q_DECLARE_METATYPE(STMBL_Servoterm::ScopeSampleBlock)
+
+#endif // STMBL_SERVOTERM_SCOPESAMPLEBLOCK_H
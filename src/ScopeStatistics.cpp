@@ -0,0 +1,230 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeStatistics.h"
+
+#include <cmath>
+#include <limits>
+
+namespace STMBL_Servoterm {
+
+static const float SAMPLE_SCALE = 32768.0f;
+// a zero crossing has to go this far below and then above zero
+static const int CROSSING_HYSTERESIS = 128;
+
+ScopeStatistics::ScopeStatistics() :
+    _channelCount(0),
+    _columnCount(0),
+    _column(-1),
+    _packet(0),
+    _packets(0)
+{
+}
+
+void ScopeStatistics::reset(int channelCount, int columnCount)
+{
+    _channelCount = channelCount;
+    _columnCount = qMax(1, columnCount);
+    _column = -1;
+    _packet = 0;
+    _packets = 0;
+    const int slots = _columnCount*_channelCount;
+    _columnSums.fill(0, slots);
+    _columnSquares.fill(0, slots);
+    _columnMinimums.fill(0, slots);
+    _columnMaximums.fill(0, slots);
+    _columnCrossings.fill(0, slots);
+    _columnFirstCrossings.fill(0, slots);
+    _columnPackets.fill(0, _columnCount);
+    _sums.fill(0, _channelCount);
+    _squares.fill(0, _channelCount);
+    _crossings.fill(0, _channelCount);
+    _lastCrossings.fill(0, _channelCount);
+    _armed.fill(0, _channelCount);
+    _minimumQueues.resize(_channelCount);
+    _maximumQueues.resize(_channelCount);
+    _crossingQueues.resize(_channelCount);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        _minimumQueues[channel].reset(_columnCount);
+        _maximumQueues[channel].reset(_columnCount);
+        _crossingQueues[channel].reset(_columnCount);
+    }
+}
+
+int ScopeStatistics::channelCount() const
+{
+    return _channelCount;
+}
+
+qint64 ScopeStatistics::packetCount() const
+{
+    return _packets;
+}
+
+void ScopeStatistics::beginColumn()
+{
+    if (_channelCount == 0)
+        return;
+    if (_column >= 0)
+        _CompleteColumn();
+    _column++;
+    // NOTE: the column leaving has the slot the new one gets
+    if (_column >= _columnCount)
+        _RemoveColumn(_column - _columnCount);
+    const int slot = _Slot(_column);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        const int i = slot*_channelCount + channel;
+        _columnSums[i] = 0;
+        _columnSquares[i] = 0;
+        _columnMinimums[i] = std::numeric_limits<qint16>::max();
+        _columnMaximums[i] = std::numeric_limits<qint16>::min();
+        _columnCrossings[i] = 0;
+    }
+    _columnPackets[slot] = 0;
+}
+
+void ScopeStatistics::addPacket(const float *samples)
+{
+    if (_channelCount == 0)
+        return;
+    if (_column < 0)
+        beginColumn();
+    const int slot = _Slot(_column);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        const int i = slot*_channelCount + channel;
+        const int code = qBound(-32768, qRound(samples[channel]*SAMPLE_SCALE), 32767);
+        const qint64 square = static_cast<qint64>(code)*code;
+        _columnSums[i] += code;
+        _columnSquares[i] += square;
+        _sums[channel] += code;
+        _squares[channel] += square;
+        _columnMinimums[i] = qMin(_columnMinimums[i], static_cast<qint16>(code));
+        _columnMaximums[i] = qMax(_columnMaximums[i], static_cast<qint16>(code));
+        _armed[channel] |= (code < -CROSSING_HYSTERESIS);
+        if (_armed[channel] && code >= CROSSING_HYSTERESIS)
+        {
+            _armed[channel] = 0;
+            if (_columnCrossings[i]++ == 0)
+                _columnFirstCrossings[i] = _packet;
+            _crossings[channel]++;
+            _lastCrossings[channel] = _packet;
+        }
+    }
+    _columnPackets[slot]++;
+    _packets++;
+    _packet++;
+}
+
+ScopeStatisticsReport ScopeStatistics::report(double packetPeriod) const
+{
+    ScopeStatisticsReport report;
+    report.packetCount = _packets;
+    report.duration = _packets*packetPeriod;
+    report.channels.resize(_channelCount);
+    if (_packets == 0)
+        return report;
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        ScopeChannelStatistics &statistics = report.channels[channel];
+        range(channel, statistics.minimum, statistics.maximum);
+        statistics.mean = static_cast<float>(static_cast<double>(_sums[channel])/_packets/SAMPLE_SCALE);
+        statistics.rms = static_cast<float>(std::sqrt(static_cast<double>(_squares[channel])/_packets)/SAMPLE_SCALE);
+        // the crossings from the first to the last one in the window make whole periods
+        if (_crossings[channel] < 2 || packetPeriod <= 0.0)
+            continue;
+        const ColumnQueue &crossingQueue = _crossingQueues[channel];
+        const qint64 firstColumn = crossingQueue.isEmpty() ? _column : crossingQueue.front();
+        const qint64 firstCrossing = _columnFirstCrossings[_Slot(firstColumn)*_channelCount + channel];
+        const qint64 span = _lastCrossings[channel] - firstCrossing;
+        if (span > 0)
+            statistics.frequency = (_crossings[channel] - 1)/(span*packetPeriod);
+    }
+    return report;
+}
+
+void ScopeStatistics::range(int channel, float &minimum, float &maximum) const
+{
+    // the front of the queues has the extremes of the completed
+    // columns, the one being filled is taken on top
+    qint16 lowest = std::numeric_limits<qint16>::max();
+    qint16 highest = std::numeric_limits<qint16>::min();
+    if (!_minimumQueues[channel].isEmpty())
+        lowest = _columnMinimums[_Slot(_minimumQueues[channel].front())*_channelCount + channel];
+    if (!_maximumQueues[channel].isEmpty())
+        highest = _columnMaximums[_Slot(_maximumQueues[channel].front())*_channelCount + channel];
+    if (_column >= 0 && _columnPackets[_Slot(_column)] > 0)
+    {
+        lowest = qMin(lowest, _columnMinimums[_Slot(_column)*_channelCount + channel]);
+        highest = qMax(highest, _columnMaximums[_Slot(_column)*_channelCount + channel]);
+    }
+    if (lowest > highest)
+        lowest = highest = 0;
+    minimum = lowest/SAMPLE_SCALE;
+    maximum = highest/SAMPLE_SCALE;
+}
+
+int ScopeStatistics::_Slot(qint64 column) const
+{
+    return static_cast<int>(column % _columnCount);
+}
+
+void ScopeStatistics::_CompleteColumn()
+{
+    const int slot = _Slot(_column);
+    if (_columnPackets[slot] == 0)
+        return; // NOTE: an empty one can't be an extreme
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        const int i = slot*_channelCount + channel;
+        ColumnQueue &minimumQueue = _minimumQueues[channel];
+        while (!minimumQueue.isEmpty() && _columnMinimums[_Slot(minimumQueue.back())*_channelCount + channel] >= _columnMinimums[i])
+            minimumQueue.popBack();
+        minimumQueue.pushBack(_column);
+        ColumnQueue &maximumQueue = _maximumQueues[channel];
+        while (!maximumQueue.isEmpty() && _columnMaximums[_Slot(maximumQueue.back())*_channelCount + channel] <= _columnMaximums[i])
+            maximumQueue.popBack();
+        maximumQueue.pushBack(_column);
+        if (_columnCrossings[i] > 0)
+            _crossingQueues[channel].pushBack(_column);
+    }
+}
+
+void ScopeStatistics::_RemoveColumn(qint64 column)
+{
+    const int slot = _Slot(column);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        const int i = slot*_channelCount + channel;
+        _sums[channel] -= _columnSums[i];
+        _squares[channel] -= _columnSquares[i];
+        _crossings[channel] -= _columnCrossings[i];
+        if (!_minimumQueues[channel].isEmpty() && _minimumQueues[channel].front() == column)
+            _minimumQueues[channel].popFront();
+        if (!_maximumQueues[channel].isEmpty() && _maximumQueues[channel].front() == column)
+            _maximumQueues[channel].popFront();
+        if (!_crossingQueues[channel].isEmpty() && _crossingQueues[channel].front() == column)
+            _crossingQueues[channel].popFront();
+    }
+    _packets -= _columnPackets[slot];
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,119 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPESTATISTICS_H
+#define STMBL_SERVOTERM_SCOPESTATISTICS_H
+
+#include <QMetaType>
+#include <QVector>
+
+namespace STMBL_Servoterm {
+
+// NOTE: in the same [-1, 1) units as the samples, the frequency in Hz
+//       (0 when there are fewer than two rising zero crossings, or the
+//       packet rate isn't known)
+struct ScopeChannelStatistics
+{
+    ScopeChannelStatistics() : minimum(0.0f), maximum(0.0f), mean(0.0f), rms(0.0f), frequency(0.0) {}
+    float peakToPeak() const {return maximum - minimum;}
+    float minimum;
+    float maximum;
+    float mean;
+    float rms;
+    double frequency;
+};
+
+struct ScopeStatisticsReport
+{
+    ScopeStatisticsReport() : selection(false), packetCount(0), duration(0.0) {}
+    bool selection; // over a selected span rather than the visible window
+    qint64 packetCount;
+    double duration; // in seconds, 0 while the packet rate isn't known
+    QVector<ScopeChannelStatistics> channels;
+};
+
+// the statistics of every channel over a sliding window of columns,
+// kept up to date as packets come in and columns fall out of the
+// window: running sums for the mean and RMS, and monotonic queues of
+// the columns' extremes for the minimum and maximum, so every packet
+// costs the same no matter how wide the window is
+// NOTE: the samples are counted as 16-bit codes, which hold both scope
+//       formats exactly and make the sums exact however long it runs
+class ScopeStatistics
+{
+public:
+    ScopeStatistics();
+    void reset(int channelCount, int columnCount);
+    int channelCount() const;
+    qint64 packetCount() const; // in the window
+    void beginColumn(); // the oldest column leaves the window, the next packets go into a new one
+    void addPacket(const float *samples);
+    ScopeStatisticsReport report(double packetPeriod) const;
+    void range(int channel, float &minimum, float &maximum) const;
+protected:
+    // a fixed capacity double ended queue of column numbers
+    class ColumnQueue
+    {
+    public:
+        ColumnQueue() : _head(0), _size(0) {}
+        void reset(int capacity) {_columns.fill(0, capacity); _head = 0; _size = 0;}
+        bool isEmpty() const {return _size == 0;}
+        qint64 front() const {return _columns[_head];}
+        qint64 back() const {return _columns[(_head + _size - 1) % _columns.size()];}
+        void pushBack(qint64 column) {_columns[(_head + _size++) % _columns.size()] = column;}
+        void popBack() {_size--;}
+        void popFront() {_head = (_head + 1) % _columns.size(); _size--;}
+    protected:
+        QVector<qint64> _columns;
+        int _head;
+        int _size;
+    };
+    int _Slot(qint64 column) const;
+    void _CompleteColumn();
+    void _RemoveColumn(qint64 column);
+
+    int _channelCount;
+    int _columnCount;
+    qint64 _column; // the number of the one being filled, -1 before the first
+    qint64 _packet; // the number of the next packet
+    // per column slot, channel after channel
+    QVector<qint64> _columnSums;
+    QVector<qint64> _columnSquares;
+    QVector<qint16> _columnMinimums;
+    QVector<qint16> _columnMaximums;
+    QVector<int> _columnCrossings;
+    QVector<qint64> _columnFirstCrossings;
+    QVector<int> _columnPackets; // per column slot
+    // per channel, over the whole window
+    QVector<qint64> _sums;
+    QVector<qint64> _squares;
+    QVector<int> _crossings;
+    QVector<qint64> _lastCrossings;
+    QVector<char> _armed; // for the next rising zero crossing
+    QVector<ColumnQueue> _minimumQueues; // increasing minimums, of the completed columns
+    QVector<ColumnQueue> _maximumQueues; // decreasing maximums, of the completed columns
+    QVector<ColumnQueue> _crossingQueues; // the completed columns with any crossings
+    qint64 _packets;
+};
+
+} // namespace STMBL_Servoterm
+
+Q_DECLARE_METATYPE(STMBL_Servoterm::ScopeStatisticsReport)
+
+#endif // STMBL_SERVOTERM_SCOPESTATISTICS_H
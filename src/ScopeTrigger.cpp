@@ -0,0 +1,70 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ScopeTrigger.h"
+
+namespace STMBL_Servoterm {
+
+ScopeTrigger::ScopeTrigger() :
+    _armed(false)
+{
+}
+
+void ScopeTrigger::setSettings(const ScopeTriggerSettings &settings)
+{
+    _settings = settings;
+    reset();
+}
+
+const ScopeTriggerSettings & ScopeTrigger::settings() const
+{
+    return _settings;
+}
+
+void ScopeTrigger::reset()
+{
+    _armed = false;
+}
+
+int ScopeTrigger::scan(const float *samples, int packetCount, int channelCount)
+{
+    if (_settings.channel < 0 || _settings.channel >= channelCount)
+        return -1;
+    // a falling edge is a rising one of the negated channel, so
+    // the loop only has the one (rarely taken) branch
+    const float sign = (_settings.slope == SCOPE_TRIGGER_FALLING) ? -1.0f : 1.0f;
+    const float fireLevel = sign*_settings.level;
+    const float armLevel = fireLevel - _settings.hysteresis;
+    const float *sample = samples + _settings.channel;
+    bool armed = _armed;
+    for (int i = 0; i < packetCount; i++, sample += channelCount)
+    {
+        const float value = sign*(*sample);
+        armed |= (value < armLevel);
+        if (armed & (value >= fireLevel))
+        {
+            _armed = false;
+            return i;
+        }
+    }
+    _armed = armed;
+    return -1;
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,74 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SCOPETRIGGER_H
+#define STMBL_SERVOTERM_SCOPETRIGGER_H
+
+#include <QMetaType>
+
+namespace STMBL_Servoterm {
+
+enum ScopeTriggerMode
+{
+    SCOPE_TRIGGER_FREE_RUN = 0, // just sweeps, no trigger
+    SCOPE_TRIGGER_AUTO, // like normal, but sweeps anyway when nothing triggers for a screen's worth
+    SCOPE_TRIGGER_NORMAL, // redraws on every trigger, holding the last one in between
+    SCOPE_TRIGGER_SINGLE // draws the first trigger after being armed, then holds it
+};
+
+enum ScopeTriggerSlope
+{
+    SCOPE_TRIGGER_RISING = 0,
+    SCOPE_TRIGGER_FALLING
+};
+
+// NOTE: the level and hysteresis are in the same [-1, 1) units as the samples
+struct ScopeTriggerSettings
+{
+    ScopeTriggerSettings() : mode(SCOPE_TRIGGER_FREE_RUN), slope(SCOPE_TRIGGER_RISING), channel(0), level(0.0f), hysteresis(0.02f) {}
+    ScopeTriggerMode mode;
+    ScopeTriggerSlope slope;
+    int channel;
+    float level;
+    float hysteresis;
+};
+
+// an edge trigger on one channel, with hysteresis so noise around the
+// level doesn't retrigger: it is armed once the channel is hysteresis
+// below the level (above, for a falling edge) and fires when it reaches it
+class ScopeTrigger
+{
+public:
+    ScopeTrigger();
+    void setSettings(const ScopeTriggerSettings &settings); // NOTE: also resets
+    const ScopeTriggerSettings & settings() const;
+    void reset(); // waits to be armed again
+    // returns the first packet in which it fires, or -1 if none does
+    // NOTE: it needs to be reset() to fire again after that
+    int scan(const float *samples, int packetCount, int channelCount);
+protected:
+    ScopeTriggerSettings _settings;
+    bool _armed;
+};
+
+} // namespace STMBL_Servoterm
+
+Q_DECLARE_METATYPE(STMBL_Servoterm::ScopeTriggerSettings)
+
+#endif // STMBL_SERVOTERM_SCOPETRIGGER_H
@@ -1,50 +1,65 @@
 #include "SerialConnection.h"
-#include "ScopeDataDemux.h"
+#include "SerialIngestWorker.h"
 
 #include <QSerialPortInfo>
-#include <QTcpSocket>
-#include <QHostAddress>
+#include <QThread>
 #include <QTimer>
 #include <QMessageBox>
-#include <QMetaEnum>
+#include <QMetaMethod>
+#include <QRegExp>
+
+#include <algorithm>
+#include <limits>
 
 namespace STMBL_Servoterm {
 
 static const quint16 STMBL_USB_VENDOR_ID  = 0x0483; //  1155
 static const quint16 STMBL_USB_PRODUCT_ID = 0x5740; // 22336
 
+// a partial line (like a prompt) is shown once nothing was added to it
+// for this long, or once it gets unreasonably long
+static const qint64 PARTIAL_LINE_FLUSH_MS = 100;
+static const int MAXIMUM_PARTIAL_LINE_LENGTH = 4096;
+
+static const QString REPLAY_PORT_PREFIX = "replay:";
+
 SerialConnection::SerialConnection(QObject *parent) :
     QObject(parent),
-    _serialPort(new QSerialPort(this)),
-    _tcpSocket(new QTcpSocket(this)),
-    _demux(new ScopeDataDemux(this)),
+    _ingestThread(new QThread(this)),
+    _worker(new SerialIngestWorker),
     _redirectingTimer(new QTimer(this)),
     _serialSendTimer(new QTimer(this)),
+    _scopeSamplesRead(0),
+    _scopeChannelCount(SCOPE_CHANNEL_COUNT),
+    _replaySpeed(1.0),
     _redirectingToConfigEdit(false)
 {
+    _lines.reserve(1 << 16);
+    _partialLineClock.start();
     _redirectingTimer->setInterval(100);
     _redirectingTimer->setSingleShot(true);
     _serialSendTimer->setInterval(50);
 
-    connect(_serialPort, &QSerialPort::readyRead, this, &SerialConnection::slot_SerialDataReceived);
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
-    connect(_serialPort, &QSerialPort::errorOccurred, this, &SerialConnection::slot_SerialErrorOccurred);
-#endif
-    // connect(_serialPort, &QSerialPort::readChannelFinished, this, &SerialConnection::slot_SerialPortClosed); // NOTE: doesn't seem to actually work
-    connect(_tcpSocket, &QTcpSocket::stateChanged, this, &SerialConnection::slot_SocketStateChanged);
-    connect(_tcpSocket, &QTcpSocket::readyRead, this, &SerialConnection::slot_SocketDataReceived);
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
-    connect(_tcpSocket, &QTcpSocket::errorOccurred, this, &SerialConnection::slot_SocketErrorOccurred);
-#endif
-    connect(_demux, &ScopeDataDemux::scopePacketReceived, this, &SerialConnection::scopePacketReceived);
-    connect(_demux, &ScopeDataDemux::scopeResetReceived, this, &SerialConnection::scopeResetReceived);
+    _ingestThread->setObjectName("SerialIngest");
+    _worker->moveToThread(_ingestThread);
+
+    connect(_worker, &SerialIngestWorker::serialPortLost, this, &SerialConnection::slot_SerialPortLost);
+    connect(_worker, &SerialIngestWorker::replayFinished, this, &SerialConnection::slot_ReplayFinished);
+    connect(_worker, &SerialIngestWorker::socketConnected, this, &SerialConnection::slot_SocketConnected);
+    connect(_worker, &SerialIngestWorker::socketDisconnected, this, &SerialConnection::slot_SocketDisconnected);
+    connect(_worker, &SerialIngestWorker::errorMessage, this, &SerialConnection::errorMessage);
     connect(_redirectingTimer, &QTimer::timeout, this, &SerialConnection::slot_ConfigReceiveTimeout);
     connect(_serialSendTimer, &QTimer::timeout, this, &SerialConnection::slot_SerialSendFromQueue);
+
+    _ingestThread->start();
 }
 
 SerialConnection::~SerialConnection()
 {
-    _tcpSocket->abort();
+    QMetaObject::invokeMethod(_worker, "abort", Qt::BlockingQueuedConnection);
+    _ingestThread->quit();
+    _ingestThread->wait();
+    delete _worker; // NOTE: safe now that its thread is gone
 }
 
 QStringList SerialConnection::getSerialPortNames()
@@ -75,31 +90,39 @@ bool SerialConnection::isValidSerialPortName(const QString &portName)
     return QSerialPortInfo(portName).isNull();
 }
 
+QString SerialConnection::replayPortName(const QString &captureFilePath)
+{
+    return REPLAY_PORT_PREFIX + captureFilePath;
+}
+
 bool SerialConnection::isSerialConnection() const
 {
-    return _serialPort->isOpen();
+    return _worker->isSerialOpen();
+}
+
+bool SerialConnection::isReplayConnection() const
+{
+    return _worker->isReplaying();
 }
 
 bool SerialConnection::isConnected() const
 {
-    // return _serialPort->isOpen() || _tcpSocket->isOpen();
-    return _serialPort->isOpen() || _tcpSocket->state() == QAbstractSocket::ConnectedState;
+    return _worker->isSerialOpen() || _worker->isReplaying() || _worker->socketState() == QAbstractSocket::ConnectedState;
 }
 
 bool SerialConnection::isDisconnected() const
 {
-    // return !_serialPort->isOpen() && !_tcpSocket->isOpen();
-    return !_serialPort->isOpen() && _tcpSocket->state() == QAbstractSocket::UnconnectedState;
+    return !_worker->isSerialOpen() && !_worker->isReplaying() && _worker->socketState() == QAbstractSocket::UnconnectedState;
 }
 
 QString SerialConnection::serialPortName() const
 {
-    return _serialPort->portName();
+    return _serialPortName;
 }
 
 QString SerialConnection::networkPeerAddress() const
 {
-    return _tcpSocket->peerAddress().toString();
+    return _networkPeerAddress;
 }
 
 void SerialConnection::connectTo(const QString &portName)
@@ -110,12 +133,29 @@ void SerialConnection::connectTo(const QString &portName)
         {
             QMessageBox::critical(nullptr, "Error opening serial port", "Already connected! Currently open port is: \"" + serialPortName() + "\"");
         }
+        else if (isReplayConnection())
+        {
+            QMessageBox::critical(nullptr, "Error opening capture", "Already replaying a capture!");
+        }
         else // it must be the network connection
         {
             QMessageBox::critical(nullptr, "Error connecting to IP", "Already connected! Currently connected to: \"" + networkPeerAddress() + "\"");
         }
         return;
     }
+    if (portName.startsWith(REPLAY_PORT_PREFIX))
+    {
+        const QString filePath = portName.mid(REPLAY_PORT_PREFIX.size());
+        bool opened = false;
+        QMetaObject::invokeMethod(_worker, "openReplay", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, opened), Q_ARG(QString, filePath), Q_ARG(double, _replaySpeed));
+        if (!opened)
+        {
+            QMessageBox::critical(nullptr, "Error opening capture", "Unable to replay \"" + filePath + "\", it is missing or not a capture file");
+            return;
+        }
+        emit connected();
+        return;
+    }
     const bool isValidSerialPort = !isValidSerialPortName(portName);
     if (isValidSerialPort)
     {
@@ -124,13 +164,15 @@ void SerialConnection::connectTo(const QString &portName)
             QMessageBox::critical(nullptr, "Error opening serial port", "No port selected!");
             return;
         }
-        _serialPort->setPortName(portName);
-        _serialPort->setBaudRate(115200);
-        if (!_serialPort->open(QIODevice::ReadWrite))
+        // NOTE: opening is quick, so it is fine to wait for the ingest thread here
+        bool opened = false;
+        QMetaObject::invokeMethod(_worker, "openSerialPort", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, opened), Q_ARG(QString, portName));
+        if (!opened)
         {
             QMessageBox::critical(nullptr, "Error opening serial port", "Unable to open port \"" + portName + "\"");
             return;
         }
+        _serialPortName = portName;
         emit connected();
     }
     else // must be IP (or maybe even hostname?)
@@ -144,13 +186,14 @@ void SerialConnection::connectTo(const QString &portName)
         }
         const QString ip = parts.at(0);
         const quint16 port = parts.at(1).toInt();
-        _tcpSocket->connectToHost(ip, port);
+        QMetaObject::invokeMethod(_worker, "connectToHost", Q_ARG(QString, ip), Q_ARG(quint16, port));
     }
 }
 
 void SerialConnection::disconnectFrom()
 {
     const bool wasSerialConnection = isSerialConnection();
+    const bool wasReplayConnection = isReplayConnection();
     if (isDisconnected())
     {
         QMessageBox::critical(nullptr, "Error disconnecting", "Already disconnected!");
@@ -163,7 +206,7 @@ void SerialConnection::disconnectFrom()
         {
             QMessageBox::critical(nullptr, "Error closing serial port", "Unknown reason -- it is open, but cannot be closed?");
         }
-        else if (_tcpSocket->state() != QAbstractSocket::UnconnectedState && _tcpSocket->state() != QAbstractSocket::ConnectedState)
+        else if (_worker->socketState() != QAbstractSocket::UnconnectedState && _worker->socketState() != QAbstractSocket::ConnectedState)
         {
             QMessageBox::critical(nullptr, "Error disconnecting", "a network connection is in the middle of trying to connect");
         }
@@ -173,7 +216,7 @@ void SerialConnection::disconnectFrom()
         }
         return;
     }
-    if (wasSerialConnection)
+    if (wasSerialConnection || wasReplayConnection)
     {
         emit disconnected();
     }
@@ -181,14 +224,7 @@ void SerialConnection::disconnectFrom()
 
 void SerialConnection::sendData(const QByteArray &data)
 {
-    if (_serialPort->isOpen())
-    {
-        _serialPort->write(data);
-    }
-    else if (_tcpSocket->isOpen())
-    {
-        _tcpSocket->write(data);
-    }
+    QMetaObject::invokeMethod(_worker, "sendData", Q_ARG(QByteArray, data));
 }
 
 void SerialConnection::sendConfig(const QString &config)
@@ -217,6 +253,53 @@ void SerialConnection::startReadingConfig()
     sendData(QString("showconf\n").toLatin1());
 }
 
+void SerialConnection::setReplaySpeed(double speed)
+{
+    _replaySpeed = speed;
+}
+
+bool SerialConnection::startCapture(const QString &captureFilePath)
+{
+    bool opened = false;
+    QMetaObject::invokeMethod(_worker, "startCapture", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, opened), Q_ARG(QString, captureFilePath));
+    return opened;
+}
+
+void SerialConnection::stopCapture()
+{
+    QMetaObject::invokeMethod(_worker, "stopCapture", Qt::BlockingQueuedConnection);
+}
+
+quint64 SerialConnection::droppedScopePackets() const
+{
+    return _worker->droppedScopePackets();
+}
+
+quint64 SerialConnection::droppedTextBytes() const
+{
+    return _worker->droppedTextBytes();
+}
+
+ScopeDataDemux::Counters SerialConnection::demuxCounters() const
+{
+    return _worker->demuxCounters();
+}
+
+void SerialConnection::setScopeChannelCount(int channelCount)
+{
+    QMetaObject::invokeMethod(_worker, "setScopeChannelCount", Q_ARG(int, channelCount));
+}
+
+int SerialConnection::scopeChannelCount() const
+{
+    return _scopeChannelCount;
+}
+
+double SerialConnection::scopePacketPeriod() const
+{
+    return _scopeClockStamp.packetPeriod;
+}
+
 void SerialConnection::slot_ConfigReceiveTimeout()
 {
     _redirectingToConfigEdit = false;
@@ -232,114 +315,124 @@ void SerialConnection::slot_SerialSendFromQueue()
         _serialSendTimer->stop();
 }
 
-void SerialConnection::slot_SerialErrorOccurred(QSerialPort::SerialPortError error)
+void SerialConnection::slot_SerialPortLost()
 {
-    QString errorMsg;
-    bool forceClose = false;
-    switch (error)
-    {
-        case QSerialPort::NoError:
-        return; // all good!
-
-        // case QSerialPort::DeviceNotFoundError:
-        // case QSerialPort::PermissionError:
-        // case QSerialPort::OpenError:
-        // case QSerialPort::NotOpenError:
-
-        case QSerialPort::WriteError:
-        errorMsg = "serial port write error";
-        forceClose = true;
-        break;
-
-        case QSerialPort::ReadError:
-        errorMsg = "serial port read error";
-        forceClose = true;
-        break;
-
-        case QSerialPort::ResourceError:
-        errorMsg = "serial port resource error";
-        forceClose = true;
-        break;
-
-        // case QSerialPort::UnsupportedOperationError:
-        // case QSerialPort::TimeoutError:
-        // case QSerialPort::UnknownError:
-        default:
-        break;
-    }
-    if (errorMsg.isEmpty())
-    {
-        const QMetaEnum metaEnum = QMetaEnum::fromType<QSerialPort::SerialPortError>();
-        emit errorMessage(QString("serial port \"QSerialPort::") + metaEnum.valueToKey(error) + "\"");
-    }
-    if (forceClose)
-    {
-        const bool before = isConnected();
-        _Disconnect();
-        const bool after = isConnected();
-        if (before != after)
-        {
-            emit disconnected();
-        }
-    }
+    emit disconnected();
 }
 
-void SerialConnection::slot_SerialDataReceived()
+void SerialConnection::slot_ReplayFinished()
 {
-    _HandleReceivedData(_serialPort->readAll());
+    emit disconnected();
 }
 
-/*void SerialConnection::slot_SerialPortClosed()
+void SerialConnection::slot_SocketConnected(const QString &peerAddress)
 {
-}*/
+    _networkPeerAddress = peerAddress;
+    emit connected();
+}
 
-void SerialConnection::slot_SocketStateChanged(QAbstractSocket::SocketState socketState)
+void SerialConnection::slot_SocketDisconnected()
 {
-    if (socketState == QAbstractSocket::ConnectedState)
+    emit disconnected();
+}
+
+void SerialConnection::drainIngest()
+{
+    // console text, straight from the ring into the line buffer
+    const int textLength = _worker->text.readAvailable();
+    if (textLength > 0)
     {
-        emit connected();
+        _worker->text.read(_textLines.prepareWrite(textLength), textLength);
+        _textLines.commitWrite(textLength);
+        _partialLineClock.restart();
     }
-    else if (socketState == QAbstractSocket::UnconnectedState)
+    const bool flushPartial = (_partialLineClock.elapsed() >= PARTIAL_LINE_FLUSH_MS || _textLines.size() - _textLines.completeLength() > MAXIMUM_PARTIAL_LINE_LENGTH);
+    if (_textLines.takeLines(_lines, flushPartial))
     {
-        emit disconnected();
+        _partialLineClock.restart();
+        _HandleReceivedText(_lines);
     }
-}
 
-void SerialConnection::slot_SocketErrorOccurred(QAbstractSocket::SocketError error)
-{
-    const QMetaEnum metaEnum = QMetaEnum::fromType<QAbstractSocket::SocketError>();
-    emit errorMessage(QString("network connection \"QAbstractSocket::") + metaEnum.valueToKey(error) + "\"");
+    // scope samples, cut at the resets and channel count
+    // changes so everything stays in order
+    // NOTE: events are queued after the samples preceding them,
+    //       so an event beyond what is available waits for later
+    int available = _worker->scopeSamples.readAvailable();
+    while (true)
+    {
+        int count = available;
+        bool atEvent = false;
+        if (_worker->scopeEvents.readAvailable() > 0)
+        {
+            const quint64 eventPosition = _worker->scopeEvents.peek().position;
+            if (eventPosition <= _scopeSamplesRead + available)
+            {
+                count = static_cast<int>(eventPosition - _scopeSamplesRead);
+                atEvent = true;
+            }
+        }
+        _EmitScopeSamples(count);
+        available -= count;
+        if (!atEvent)
+            break;
+        ScopeStreamEvent event;
+        _worker->scopeEvents.read(&event, 1);
+        if (event.type == ScopeStreamEvent::SCOPE_STREAM_EVENT_RESET)
+        {
+            emit scopeResetReceived();
+        }
+        else if (event.channelCount != _scopeChannelCount)
+        {
+            _scopeChannelCount = event.channelCount;
+            emit scopeChannelCountChanged(_scopeChannelCount);
+        }
+    }
 }
 
-void SerialConnection::slot_SocketDataReceived()
+void SerialConnection::_Disconnect()
 {
-    _HandleReceivedData(_tcpSocket->readAll());
+    QMetaObject::invokeMethod(_worker, "disconnectFrom", Qt::BlockingQueuedConnection);
 }
 
-void SerialConnection::_Disconnect()
+void SerialConnection::_HandleReceivedText(const QString &lines)
 {
-    if (_serialPort->isOpen())
-    {
-        _serialPort->close();
-    }
-    else // it must be the network connection
+    if (_redirectingToConfigEdit)
     {
-        _tcpSocket->abort(); // close() and disconnectFromHost() were tried before
+        _redirectingTimer->start(); // extend (restart) timer to delay timeout
+        emit configLineReceived(lines);
     }
+    else
+        emit linesReceived(lines);
 }
 
-void SerialConnection::_HandleReceivedData(const QByteArray &data)
+void SerialConnection::_EmitScopeSamples(int sampleCount)
 {
-    QString txt = _demux->addData(data);
-    if (!txt.isEmpty())
+    if (sampleCount <= 0)
+        return;
+    // the block's time comes from the latest stamp at or before it
+    while (_worker->scopeClock.readAvailable() > 0 && _worker->scopeClock.peek().position <= _scopeSamplesRead)
+        _worker->scopeClock.read(&_scopeClockStamp, 1);
+    ScopeSampleBlock block;
+    block.channelCount = _scopeChannelCount;
+    block.packetPeriod = _scopeClockStamp.packetPeriod;
+    block.startTime = _scopeClockStamp.time + static_cast<double>((_scopeSamplesRead - _scopeClockStamp.position)/_scopeChannelCount)*_scopeClockStamp.packetPeriod;
+    block.samples.resize(sampleCount);
+    _worker->scopeSamples.read(block.samples.data(), sampleCount);
+    _scopeSamplesRead += sampleCount;
+    emit scopePacketsReceived(block);
+
+    // compatibility with per-packet consumers, only paid for if somebody listens
+    static const QMetaMethod packetSignal = QMetaMethod::fromSignal(&SerialConnection::scopePacketReceived);
+    if (isSignalConnected(packetSignal))
     {
-        if (_redirectingToConfigEdit)
+        const int packetCount = block.packetCount();
+        for (int i = 0; i < packetCount; i++)
         {
-            _redirectingTimer->start(); // extend (restart) timer to delay timeout
-            emit configLineReceived(txt);
+            const float * const samples = block.packet(i);
+            QVector<float> packet(block.channelCount);
+            std::copy(samples, samples + block.channelCount, packet.begin());
+            emit scopePacketReceived(packet);
         }
-        else
-            emit lineReceived(txt.replace("<=", "&lt;=")); // HACK, we really need to stop interpreting the data as HTML...
     }
 }
 
@@ -20,18 +20,23 @@
 #ifndef QTSERVOTERM_SERIALCONNECTION_H
 #define QTSERVOTERM_SERIALCONNECTION_H
 
+#include "ScopeSampleBlock.h"
+#include "ScopeDataDemux.h"
+#include "ScopeClock.h"
+#include "TextLineAssembler.h"
+
 #include <QObject>
-#include <QSerialPort>
-#include <QAbstractSocket>
+#include <QStringList>
+#include <QElapsedTimer>
 
 QT_BEGIN_NAMESPACE
-class QTcpSocket;
+class QThread;
 class QTimer;
 QT_END_NAMESPACE
 
 namespace STMBL_Servoterm {
 
-class ScopeDataDemux;
+class SerialIngestWorker;
 
 class SerialConnection : public QObject
 {
@@ -42,7 +47,9 @@ public:
 
     static QStringList getSerialPortNames();
     static bool isValidSerialPortName(const QString &portName);
+    static QString replayPortName(const QString &captureFilePath);
     bool isSerialConnection() const;
+    bool isReplayConnection() const;
     bool isConnected() const;
     bool isDisconnected() const;
     QString serialPortName() const;
@@ -53,33 +60,55 @@ public:
     void sendData(const QByteArray &data);
     void sendConfig(const QString &data);
     void startReadingConfig();
+    void setReplaySpeed(double speed); // NOTE: 0 means as fast as possible
+    bool startCapture(const QString &captureFilePath);
+    void stopCapture();
+    quint64 droppedScopePackets() const;
+    quint64 droppedTextBytes() const;
+    ScopeDataDemux::Counters demuxCounters() const;
+    void setScopeChannelCount(int channelCount); // NOTE: 0 detects it from the stream
+    int scopeChannelCount() const; // of the packets delivered so far
+    double scopePacketPeriod() const; // NOTE: in seconds, 0 until it has been estimated
+public slots:
+    // picks up what the ingest thread has decoded and emits it,
+    // NOTE: meant to run on FrameClock::frame(), ahead of the views
+    void drainIngest();
 signals:
-    void lineReceived(const QString &line);
+    void linesReceived(const QString &lines); // NOTE: plain text, whole lines unless a partial one went stale
     void configLineReceived(const QString &line);
-    void scopePacketReceived(const QVector<float> &packet);
+    void scopePacketsReceived(const STMBL_Servoterm::ScopeSampleBlock &block);
+    void scopePacketReceived(const QVector<float> &packet); // NOTE: per-packet compatibility signal, prefer scopePacketsReceived()
     void scopeResetReceived();
+    void scopeChannelCountChanged(int channelCount);
     void connected();
     void disconnected();
     void errorMessage(const QString &errorMessage);
 protected slots:
     void slot_ConfigReceiveTimeout();
     void slot_SerialSendFromQueue();
-    void slot_SerialErrorOccurred(QSerialPort::SerialPortError error);
-    void slot_SerialDataReceived();
-    // void slot_SerialPortClosed();
-    void slot_SocketStateChanged(QAbstractSocket::SocketState socketState);
-    void slot_SocketErrorOccurred(QAbstractSocket::SocketError error);
-    void slot_SocketDataReceived();
+    void slot_SerialPortLost();
+    void slot_ReplayFinished();
+    void slot_SocketConnected(const QString &peerAddress);
+    void slot_SocketDisconnected();
 protected:
     void _Disconnect();
-    void _HandleReceivedData(const QByteArray &data);
+    void _HandleReceivedText(const QString &lines);
+    void _EmitScopeSamples(int sampleCount);
 
-    QSerialPort *_serialPort;
-    QTcpSocket *_tcpSocket;
-    ScopeDataDemux *_demux;
+    QThread *_ingestThread;
+    SerialIngestWorker *_worker;
     QTimer *_redirectingTimer;
     QTimer *_serialSendTimer;
     QStringList _txQueue;
+    QString _serialPortName;
+    QString _networkPeerAddress;
+    TextLineAssembler _textLines;
+    QString _lines; // NOTE: reused for every batch of lines
+    QElapsedTimer _partialLineClock; // since text last came in or lines were taken
+    quint64 _scopeSamplesRead;
+    int _scopeChannelCount;
+    ScopeClockStamp _scopeClockStamp; // the latest one reached
+    double _replaySpeed;
     bool _redirectingToConfigEdit;
 };
 
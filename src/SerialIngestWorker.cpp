@@ -0,0 +1,411 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SerialIngestWorker.h"
+
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QTimer>
+#include <QMetaEnum>
+
+namespace STMBL_Servoterm {
+
+// enough for a few seconds of data at full USB rate, so a stalled GUI doesn't lose anything
+static const int SCOPE_SAMPLES_RING_CAPACITY = 1 << 21;
+static const int SCOPE_EVENTS_RING_CAPACITY = 1 << 12;
+static const int SCOPE_CLOCK_RING_CAPACITY = 1 << 12;
+static const int TEXT_RING_CAPACITY = 1 << 20;
+static const int DECODED_TEXT_CAPACITY = 1 << 16; // more than a serial read ever returns
+static const int REPLAY_SLICE_MS = 5; // how long a replay may hog the thread in one go
+static const int REPLAY_MAXIMUM_DATA_SLICE = 64*1024; // NOTE: well below the ring capacities, or it could never fit
+
+SerialIngestWorker::SerialIngestWorker(QObject *parent) :
+    QObject(parent),
+    scopeSamples(SCOPE_SAMPLES_RING_CAPACITY),
+    scopeEvents(SCOPE_EVENTS_RING_CAPACITY),
+    scopeClock(SCOPE_CLOCK_RING_CAPACITY),
+    text(TEXT_RING_CAPACITY),
+    _serialPort(new QSerialPort(this)),
+    _tcpSocket(new QTcpSocket(this)),
+    _demux(new ScopeDataDemux(this)),
+    _scopeSamplesWritten(0),
+    _scopePacketsDecoded(0),
+    _arrivalTime(0.0),
+    _nextScopeTime(0.0),
+    _resetHeld(false),
+    _channelCountHeld(false),
+    _replayTimer(new QTimer(this)),
+    _replaySpeed(1.0),
+    _replayHasPending(false),
+    _replayPendingUs(0),
+    _replayPendingOffset(0),
+    _replaying(false),
+    _serialOpen(false),
+    _socketState(QAbstractSocket::UnconnectedState),
+    _droppedScopePackets(0),
+    _droppedTextBytes(0)
+{
+    connect(_serialPort, &QSerialPort::readyRead, this, &SerialIngestWorker::slot_SerialDataReceived);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 8, 0))
+    connect(_serialPort, &QSerialPort::errorOccurred, this, &SerialIngestWorker::slot_SerialErrorOccurred);
+#endif
+    connect(_tcpSocket, &QTcpSocket::stateChanged, this, &SerialIngestWorker::slot_SocketStateChanged);
+    connect(_tcpSocket, &QTcpSocket::readyRead, this, &SerialIngestWorker::slot_SocketDataReceived);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    connect(_tcpSocket, &QTcpSocket::errorOccurred, this, &SerialIngestWorker::slot_SocketErrorOccurred);
+#endif
+    connect(_demux, &ScopeDataDemux::scopePacketsReceived, this, &SerialIngestWorker::slot_ScopePacketsDecoded);
+    connect(_demux, &ScopeDataDemux::scopeResetReceived, this, &SerialIngestWorker::slot_ScopeResetDecoded);
+    connect(_demux, &ScopeDataDemux::channelCountChanged, this, &SerialIngestWorker::slot_ScopeChannelCountChanged);
+    _decodedText.reserve(DECODED_TEXT_CAPACITY);
+    _arrivalClock.start();
+    _replayTimer->setSingleShot(true);
+    _replayTimer->setTimerType(Qt::PreciseTimer);
+    connect(_replayTimer, &QTimer::timeout, this, &SerialIngestWorker::slot_ReplayTimeout);
+}
+
+SerialIngestWorker::~SerialIngestWorker()
+{
+    _tcpSocket->abort();
+}
+
+bool SerialIngestWorker::openSerialPort(const QString &portName)
+{
+    _demux->reset();
+    _ResetScopeClock();
+    _serialPort->setPortName(portName);
+    _serialPort->setBaudRate(115200);
+    const bool opened = _serialPort->open(QIODevice::ReadWrite);
+    _serialOpen.store(opened, std::memory_order_release);
+    return opened;
+}
+
+void SerialIngestWorker::connectToHost(const QString &host, quint16 port)
+{
+    _demux->reset();
+    _ResetScopeClock();
+    _tcpSocket->connectToHost(host, port);
+}
+
+bool SerialIngestWorker::openReplay(const QString &filePath, double speed)
+{
+    if (!_replay.open(filePath))
+        return false;
+    _demux->reset();
+    _ResetScopeClock();
+    _replaySpeed = speed;
+    _replayHasPending = false;
+    _replayClock.start();
+    _replaying.store(true, std::memory_order_release);
+    _replayTimer->start(0);
+    return true;
+}
+
+void SerialIngestWorker::disconnectFrom()
+{
+    if (_replaying.load(std::memory_order_relaxed))
+    {
+        _StopReplay();
+    }
+    else if (_serialPort->isOpen())
+    {
+        _serialPort->close();
+        _serialOpen.store(false, std::memory_order_release);
+    }
+    else // it must be the network connection
+    {
+        _tcpSocket->abort(); // close() and disconnectFromHost() were tried before
+    }
+}
+
+void SerialIngestWorker::abort()
+{
+    stopCapture();
+    _StopReplay();
+    if (_serialPort->isOpen())
+        disconnectFrom();
+    _tcpSocket->abort();
+}
+
+void SerialIngestWorker::sendData(const QByteArray &data)
+{
+    if (_serialPort->isOpen())
+    {
+        _serialPort->write(data);
+    }
+    else if (_tcpSocket->isOpen())
+    {
+        _tcpSocket->write(data);
+    }
+}
+
+bool SerialIngestWorker::startCapture(const QString &filePath)
+{
+    if (!_capture.open(filePath))
+        return false;
+    _captureClock.start();
+    return true;
+}
+
+void SerialIngestWorker::stopCapture()
+{
+    _capture.close();
+}
+
+void SerialIngestWorker::setScopeChannelCount(int channelCount)
+{
+    _demux->setChannelCount(channelCount);
+}
+
+void SerialIngestWorker::slot_SerialErrorOccurred(QSerialPort::SerialPortError error)
+{
+    QString errorMsg;
+    bool forceClose = false;
+    switch (error)
+    {
+        case QSerialPort::NoError:
+        return; // all good!
+
+        // case QSerialPort::DeviceNotFoundError:
+        // case QSerialPort::PermissionError:
+        // case QSerialPort::OpenError:
+        // case QSerialPort::NotOpenError:
+
+        case QSerialPort::WriteError:
+        errorMsg = "serial port write error";
+        forceClose = true;
+        break;
+
+        case QSerialPort::ReadError:
+        errorMsg = "serial port read error";
+        forceClose = true;
+        break;
+
+        case QSerialPort::ResourceError:
+        errorMsg = "serial port resource error";
+        forceClose = true;
+        break;
+
+        // case QSerialPort::UnsupportedOperationError:
+        // case QSerialPort::TimeoutError:
+        // case QSerialPort::UnknownError:
+        default:
+        break;
+    }
+    if (errorMsg.isEmpty())
+    {
+        const QMetaEnum metaEnum = QMetaEnum::fromType<QSerialPort::SerialPortError>();
+        emit errorMessage(QString("serial port \"QSerialPort::") + metaEnum.valueToKey(error) + "\"");
+    }
+    if (forceClose && _serialPort->isOpen())
+    {
+        disconnectFrom();
+        emit serialPortLost();
+    }
+}
+
+void SerialIngestWorker::slot_SerialDataReceived()
+{
+    _HandleReceivedData(_serialPort->readAll(), _arrivalClock.nsecsElapsed()*1e-9);
+}
+
+void SerialIngestWorker::slot_SocketStateChanged(QAbstractSocket::SocketState socketState)
+{
+    _socketState.store(socketState, std::memory_order_release);
+    if (socketState == QAbstractSocket::ConnectedState)
+    {
+        emit socketConnected(_tcpSocket->peerAddress().toString());
+    }
+    else if (socketState == QAbstractSocket::UnconnectedState)
+    {
+        emit socketDisconnected();
+    }
+}
+
+void SerialIngestWorker::slot_SocketErrorOccurred(QAbstractSocket::SocketError error)
+{
+    const QMetaEnum metaEnum = QMetaEnum::fromType<QAbstractSocket::SocketError>();
+    emit errorMessage(QString("network connection \"QAbstractSocket::") + metaEnum.valueToKey(error) + "\"");
+}
+
+void SerialIngestWorker::slot_SocketDataReceived()
+{
+    _HandleReceivedData(_tcpSocket->readAll(), _arrivalClock.nsecsElapsed()*1e-9);
+}
+
+void SerialIngestWorker::slot_ScopePacketsDecoded(const ScopeSampleBlock &block)
+{
+    const int packetCount = block.packetCount();
+    // never wait for the GUI, if it fell that far behind the packets are lost
+    // NOTE: so are they while an event is held back, rather than the event
+    if (_FlushScopeEvents() && scopeSamples.writeAvailable() >= block.samples.size())
+    {
+        // stamp the block with when its first packet was sent, going by the
+        // clock estimate once there is one and by the arrival until then
+        ScopeClockStamp stamp;
+        stamp.position = _scopeSamplesWritten;
+        stamp.time = qMax(_scopeClock.isLocked() ? _scopeClock.packetTime(_scopePacketsDecoded) : _arrivalTime, _nextScopeTime);
+        stamp.packetPeriod = _scopeClock.packetPeriod();
+        _nextScopeTime = stamp.time + packetCount*stamp.packetPeriod;
+        // NOTE: a missed stamp only means the previous one gets extrapolated
+        scopeClock.tryWrite(&stamp, 1);
+        scopeSamples.tryWrite(block.samples.constData(), block.samples.size());
+        _scopeSamplesWritten += block.samples.size();
+    }
+    else
+    {
+        _droppedScopePackets.fetch_add(packetCount, std::memory_order_relaxed);
+    }
+    _scopePacketsDecoded += packetCount;
+}
+
+void SerialIngestWorker::slot_ScopeResetDecoded()
+{
+    _WriteScopeEvent(ScopeStreamEvent::SCOPE_STREAM_EVENT_RESET);
+}
+
+void SerialIngestWorker::slot_ScopeChannelCountChanged(int channelCount)
+{
+    Q_UNUSED(channelCount);
+    _WriteScopeEvent(ScopeStreamEvent::SCOPE_STREAM_EVENT_CHANNEL_COUNT);
+    // NOTE: another packet layout may well come at another rate
+    _scopeClock.reset();
+}
+
+void SerialIngestWorker::slot_ReplayTimeout()
+{
+    QElapsedTimer slice;
+    slice.start();
+    while (_replay.isOpen())
+    {
+        if (!_replayHasPending)
+        {
+            if (!_replay.readNext(_replayPendingUs, _replayPending))
+            {
+                _StopReplay();
+                emit replayFinished();
+                return;
+            }
+            _replayHasPending = true;
+            _replayPendingOffset = 0;
+        }
+        // a recorded chunk may be bigger than the rings altogether, so it goes in slices
+        const int sliceLength = qMin(_replayPending.size() - _replayPendingOffset, REPLAY_MAXIMUM_DATA_SLICE);
+        if (_replaySpeed > 0.0)
+        {
+            // keep the original timing, scaled
+            const qint64 waitMs = static_cast<qint64>(_replayPendingUs/(1000.0*_replaySpeed)) - _replayClock.elapsed();
+            if (waitMs > 0)
+            {
+                _replayTimer->start(static_cast<int>(qMin<qint64>(waitMs, 1000)));
+                return;
+            }
+        }
+        else if (scopeSamples.writeAvailable() < sliceLength || text.writeAvailable() < sliceLength)
+        {
+            // as fast as possible, but without overrunning the GUI
+            _replayTimer->start(1);
+            return;
+        }
+        if (slice.elapsed() >= REPLAY_SLICE_MS)
+        {
+            // let the event loop (and a disconnect request) through
+            _replayTimer->start(0);
+            return;
+        }
+        // NOTE: the recorded arrival times, so the scope clock doesn't depend on the replay speed
+        _HandleReceivedData(QByteArray::fromRawData(_replayPending.constData() + _replayPendingOffset, sliceLength), _replayPendingUs*1e-6);
+        _replayPendingOffset += sliceLength;
+        _replayHasPending = (_replayPendingOffset < _replayPending.size());
+    }
+}
+
+void SerialIngestWorker::_StopReplay()
+{
+    _replayTimer->stop();
+    _replay.close();
+    _replayPending.clear();
+    _replayPendingOffset = 0;
+    _replayHasPending = false;
+    _replaying.store(false, std::memory_order_release);
+}
+
+void SerialIngestWorker::_WriteScopeEvent(ScopeStreamEvent::Type type)
+{
+    if (type == ScopeStreamEvent::SCOPE_STREAM_EVENT_RESET)
+        _resetHeld = true;
+    else
+        _channelCountHeld = true;
+    _FlushScopeEvents();
+}
+
+bool SerialIngestWorker::_FlushScopeEvents()
+{
+    // an event must never be lost, the GUI would go on slicing the
+    // samples with the wrong channel count; held ones are retried with
+    // every block, and several of a kind at the same position are one
+    ScopeStreamEvent event;
+    event.position = _scopeSamplesWritten;
+    event.channelCount = _demux->channelCount();
+    if (_resetHeld)
+    {
+        event.type = ScopeStreamEvent::SCOPE_STREAM_EVENT_RESET;
+        if (!scopeEvents.tryWrite(&event, 1))
+            return false;
+        _resetHeld = false;
+    }
+    if (_channelCountHeld)
+    {
+        event.type = ScopeStreamEvent::SCOPE_STREAM_EVENT_CHANNEL_COUNT;
+        if (!scopeEvents.tryWrite(&event, 1))
+            return false;
+        _channelCountHeld = false;
+    }
+    return true;
+}
+
+void SerialIngestWorker::_ResetScopeClock()
+{
+    _scopeClock.reset();
+    _arrivalClock.restart();
+    _arrivalTime = 0.0;
+    _nextScopeTime = 0.0;
+}
+
+void SerialIngestWorker::_HandleReceivedData(const QByteArray &data, double arrivalTime)
+{
+    if (_capture.isOpen())
+    {
+        const quint64 droppedBefore = _capture.droppedBytes();
+        _capture.append(_captureClock.nsecsElapsed()/1000, data);
+        if (droppedBefore == 0 && _capture.droppedBytes() > 0)
+            emit errorMessage("The capture isn't keeping up with the disk, dropping data!");
+    }
+    // NOTE: the text buffer is reused, resizing to 0 keeps the reserved capacity
+    _decodedText.resize(0);
+    _arrivalTime = arrivalTime;
+    const quint64 packetsBefore = _scopePacketsDecoded;
+    _demux->addData(data, _decodedText);
+    if (_scopePacketsDecoded != packetsBefore)
+        _scopeClock.addArrival(_scopePacketsDecoded, arrivalTime);
+    if (!_decodedText.isEmpty() && !text.tryWrite(_decodedText.constData(), _decodedText.size()))
+        _droppedTextBytes.fetch_add(_decodedText.size(), std::memory_order_relaxed);
+}
+
+} // namespace STMBL_Servoterm
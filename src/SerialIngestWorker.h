@@ -0,0 +1,146 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SERIALINGESTWORKER_H
+#define STMBL_SERVOTERM_SERIALINGESTWORKER_H
+
+#include "ScopeSampleBlock.h"
+#include "ScopeDataDemux.h"
+#include "SpscRing.h"
+#include "ScopeClock.h"
+#include "CaptureFile.h"
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QSerialPort>
+#include <QAbstractSocket>
+
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+class QTcpSocket;
+class QTimer;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// something that happened at a specific point of the scope sample stream
+struct ScopeStreamEvent
+{
+    enum Type
+    {
+        SCOPE_STREAM_EVENT_RESET = 0,
+        SCOPE_STREAM_EVENT_CHANNEL_COUNT
+    };
+    quint64 position; // in the stream of samples written to SerialIngestWorker::scopeSamples
+    Type type;
+    int channelCount; // the width of the packets from here on
+};
+
+// owns the serial port / network socket and the demux, and lives on
+// its own thread so reading never waits for the GUI; decoded data is
+// handed over through the rings below, which the GUI drains once per
+// frame (see SerialConnection::drainIngest())
+class SerialIngestWorker : public QObject
+{
+    Q_OBJECT
+public:
+    SerialIngestWorker(QObject *parent = nullptr);
+    ~SerialIngestWorker();
+
+    // safe to call from any thread
+    bool isSerialOpen() const {return _serialOpen.load(std::memory_order_acquire);}
+    bool isReplaying() const {return _replaying.load(std::memory_order_acquire);}
+    QAbstractSocket::SocketState socketState() const {return static_cast<QAbstractSocket::SocketState>(_socketState.load(std::memory_order_acquire));}
+    quint64 droppedScopePackets() const {return _droppedScopePackets.load(std::memory_order_relaxed);}
+    quint64 droppedTextBytes() const {return _droppedTextBytes.load(std::memory_order_relaxed);}
+    ScopeDataDemux::Counters demuxCounters() const {return _demux->counters();}
+
+    // consumer (GUI) side of the hand-over
+    SpscRing<float> scopeSamples; // whole packets only
+    SpscRing<ScopeStreamEvent> scopeEvents; // in stream order
+    SpscRing<ScopeClockStamp> scopeClock; // NOTE: each one is queued before the samples it stamps
+    SpscRing<char> text; // Latin-1
+public slots:
+    bool openSerialPort(const QString &portName);
+    void connectToHost(const QString &host, quint16 port);
+    bool openReplay(const QString &filePath, double speed); // NOTE: a speed of 0 means as fast as the GUI keeps up
+    void disconnectFrom();
+    void abort();
+    void sendData(const QByteArray &data);
+    bool startCapture(const QString &filePath);
+    void stopCapture();
+    void setScopeChannelCount(int channelCount); // NOTE: 0 detects it
+signals:
+    void socketConnected(const QString &peerAddress);
+    void socketDisconnected();
+    void serialPortLost();
+    void replayFinished();
+    void errorMessage(const QString &errorMessage);
+protected slots:
+    void slot_SerialErrorOccurred(QSerialPort::SerialPortError error);
+    void slot_SerialDataReceived();
+    void slot_SocketStateChanged(QAbstractSocket::SocketState socketState);
+    void slot_SocketErrorOccurred(QAbstractSocket::SocketError error);
+    void slot_SocketDataReceived();
+    void slot_ScopePacketsDecoded(const STMBL_Servoterm::ScopeSampleBlock &block);
+    void slot_ScopeResetDecoded();
+    void slot_ScopeChannelCountChanged(int channelCount);
+    void slot_ReplayTimeout();
+protected:
+    void _HandleReceivedData(const QByteArray &data, double arrivalTime);
+    void _ResetScopeClock();
+    void _StopReplay();
+    void _WriteScopeEvent(ScopeStreamEvent::Type type);
+    bool _FlushScopeEvents(); // returns whether nothing is held back any more
+
+    QSerialPort *_serialPort;
+    QTcpSocket *_tcpSocket;
+    ScopeDataDemux *_demux;
+    quint64 _scopeSamplesWritten;
+    quint64 _scopePacketsDecoded; // NOTE: including the dropped ones, they arrived all the same
+    ScopeClockEstimator _scopeClock;
+    QElapsedTimer _arrivalClock;
+    double _arrivalTime; // of the data being demuxed, in seconds
+    double _nextScopeTime; // keeps the stamps from going backwards
+    // events that didn't fit in scopeEvents yet, NOTE: no samples are
+    // written while any are held, so they all belong at _scopeSamplesWritten
+    bool _resetHeld;
+    bool _channelCountHeld;
+    QByteArray _decodedText;
+    CaptureWriter _capture;
+    QElapsedTimer _captureClock;
+    CaptureReader _replay;
+    QTimer *_replayTimer;
+    QElapsedTimer _replayClock;
+    double _replaySpeed;
+    bool _replayHasPending;
+    qint64 _replayPendingUs;
+    QByteArray _replayPending;
+    int _replayPendingOffset; // how much of it was handled already
+    std::atomic<bool> _replaying;
+    std::atomic<bool> _serialOpen;
+    std::atomic<int> _socketState;
+    std::atomic<quint64> _droppedScopePackets;
+    std::atomic<quint64> _droppedTextBytes;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SERIALINGESTWORKER_H
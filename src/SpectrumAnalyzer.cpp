@@ -0,0 +1,236 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SpectrumAnalyzer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+static const int MINIMUM_FFT_SIZE = 256;
+static const int MAXIMUM_FFT_SIZE = 65536;
+static const int DEFAULT_FFT_SIZE = 4096;
+static const double PI = 3.14159265358979323846;
+
+SpectrumAnalyzer::SpectrumAnalyzer(QObject *parent) :
+    QObject(parent),
+    _plan(DEFAULT_FFT_SIZE),
+    _window(SPECTRUM_WINDOW_HANN),
+    _powerScale(1.0f),
+    _columnCount(0),
+    _channelCount(SCOPE_CHANNEL_COUNT),
+    _channelMask(~0u),
+    _averaging(1),
+    _peakHold(false),
+    _nyquist(0.0),
+    _writeIndex(0),
+    _received(0),
+    _fresh(false),
+    _averaged(0)
+{
+    _Restart();
+    _UpdateWindow();
+}
+
+void SpectrumAnalyzer::setColumnCount(int columnCount)
+{
+    _columnCount = qMax(0, columnCount);
+    _fresh = true; // NOTE: redo the columns even if no new packets came in
+}
+
+void SpectrumAnalyzer::setChannelCount(int channelCount)
+{
+    channelCount = qBound(1, channelCount, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    if (channelCount == _channelCount)
+        return;
+    _channelCount = channelCount;
+    _Restart();
+}
+
+void SpectrumAnalyzer::setFftSize(int fftSize)
+{
+    fftSize = qBound(MINIMUM_FFT_SIZE, fftSize, MAXIMUM_FFT_SIZE);
+    if (fftSize == _plan.size())
+        return;
+    _plan = FftPlan(fftSize);
+    _Restart();
+    _UpdateWindow();
+}
+
+void SpectrumAnalyzer::setWindow(int window)
+{
+    if (window == _window)
+        return;
+    _window = window;
+    _UpdateWindow();
+    _ResetAverages();
+}
+
+void SpectrumAnalyzer::setAveraging(int frames)
+{
+    _averaging = qMax(1, frames);
+}
+
+void SpectrumAnalyzer::setPeakHold(bool peakHold)
+{
+    _peakHold = peakHold;
+    resetPeaks();
+}
+
+void SpectrumAnalyzer::setChannelMask(quint32 channelMask)
+{
+    if (channelMask == _channelMask)
+        return;
+    // NOTE: the channels turned back on would have gone stale
+    _channelMask = channelMask;
+    _ResetAverages();
+    _fresh = true;
+}
+
+void SpectrumAnalyzer::resetPeaks()
+{
+    _peaks.fill(0.0f);
+}
+
+void SpectrumAnalyzer::addSamples(const ScopeSampleBlock &block)
+{
+    if (block.channelCount != _channelCount) // sanity check
+        return;
+    if (block.packetPeriod > 0.0)
+        _nyquist = 0.5/block.packetPeriod;
+    const int packetCount = block.packetCount();
+    const int size = _plan.size();
+    // NOTE: only the last size packets can make it into the ring anyway
+    const int first = qMax(0, packetCount - size);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        float * const ring = _samples.data() + channel*size;
+        const float *sample = block.samples.constData() + first*_channelCount + channel;
+        int index = _writeIndex;
+        for (int i = first; i < packetCount; i++, sample += _channelCount)
+        {
+            ring[index] = *sample;
+            if (++index == size)
+                index = 0;
+        }
+    }
+    _writeIndex = (_writeIndex + packetCount - first) % size;
+    _received += packetCount;
+    _fresh = true;
+}
+
+void SpectrumAnalyzer::compute()
+{
+    const int size = _plan.size();
+    if (!_fresh || _received < size || _columnCount == 0)
+        return;
+    _fresh = false;
+
+    const int binCount = _plan.binCount();
+    SpectrumColumns columns;
+    columns.columnCount = _columnCount;
+    columns.channelCount = _channelCount;
+    columns.channelMask = _channelMask;
+    columns.nyquist = _nyquist;
+    columns.averages.fill(SPECTRUM_FLOOR_DB, _columnCount*_channelCount);
+    if (_peakHold)
+        columns.peaks.fill(SPECTRUM_FLOOR_DB, _columnCount*_channelCount);
+
+    // NOTE: a plain average until there are enough spectra, exponential after
+    const float weight = 1.0f/qMin(_averaged + 1, _averaging);
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        if (!(_channelMask & (1u << channel)))
+            continue;
+        // oldest packet first
+        const float * const ring = _samples.constData() + channel*size;
+        std::copy(ring + _writeIndex, ring + size, _unwrapped.data());
+        std::copy(ring, ring + _writeIndex, _unwrapped.data() + size - _writeIndex);
+        _plan.powerSpectrum(_unwrapped.constData(), _windowCoefficients.constData(), _power.data());
+
+        const float * const power = _power.constData();
+        float * const averages = _averages.data() + channel*binCount;
+        for (int bin = 0; bin < binCount; bin++)
+            averages[bin] += weight*(power[bin] - averages[bin]);
+        _ReduceToColumns(averages, columns.averages.data() + channel*_columnCount);
+        if (!_peakHold)
+            continue;
+        float * const peaks = _peaks.data() + channel*binCount;
+        for (int bin = 0; bin < binCount; bin++)
+            peaks[bin] = qMax(peaks[bin], power[bin]);
+        _ReduceToColumns(peaks, columns.peaks.data() + channel*_columnCount);
+    }
+    _averaged++;
+    emit spectrumComputed(columns);
+}
+
+void SpectrumAnalyzer::_Restart()
+{
+    const int size = _plan.size();
+    _samples.fill(0.0f, size*_channelCount);
+    _unwrapped.resize(size);
+    _power.resize(_plan.binCount());
+    _writeIndex = 0;
+    _received = 0;
+    _fresh = false;
+    _ResetAverages();
+}
+
+void SpectrumAnalyzer::_ResetAverages()
+{
+    _averages.fill(0.0f, _plan.binCount()*_channelCount);
+    _peaks.fill(0.0f, _plan.binCount()*_channelCount);
+    _averaged = 0;
+}
+
+void SpectrumAnalyzer::_UpdateWindow()
+{
+    // NOTE: the periodic forms, which is what spectral analysis wants
+    const int size = _plan.size();
+    _windowCoefficients.resize(size);
+    double sum = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        const double phase = 2.0*PI*i/size;
+        double w;
+        if (_window == SPECTRUM_WINDOW_FLAT_TOP)
+            w = 0.21557895 - 0.41663158*std::cos(phase) + 0.277263158*std::cos(2.0*phase) - 0.083578947*std::cos(3.0*phase) + 0.006947368*std::cos(4.0*phase);
+        else
+            w = 0.5 - 0.5*std::cos(phase);
+        _windowCoefficients[i] = static_cast<float>(w);
+        sum += w;
+    }
+    // a full scale sine peaks at |X|^2 = (sum/2)^2
+    _powerScale = static_cast<float>(4.0/(sum*sum));
+}
+
+void SpectrumAnalyzer::_ReduceToColumns(const float *power, float *columns) const
+{
+    const qint64 binCount = _plan.binCount();
+    for (int column = 0; column < _columnCount; column++)
+    {
+        const int first = static_cast<int>(column*binCount/_columnCount);
+        const int last = qMax(first + 1, static_cast<int>((column + 1)*binCount/_columnCount));
+        const float highest = *std::max_element(power + first, power + last);
+        columns[column] = qMax(SPECTRUM_FLOOR_DB, 10.0f*std::log10(highest*_powerScale + 1e-30f));
+    }
+}
+
+} // namespace STMBL_Servoterm
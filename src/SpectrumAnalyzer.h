@@ -0,0 +1,109 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SPECTRUMANALYZER_H
+#define STMBL_SERVOTERM_SPECTRUMANALYZER_H
+
+#include "globals.h"
+#include "ScopeSampleBlock.h"
+#include "FftPlan.h"
+
+#include <QObject>
+#include <QMetaType>
+#include <QVector>
+
+namespace STMBL_Servoterm {
+
+enum SpectrumWindow
+{
+    SPECTRUM_WINDOW_HANN = 0,
+    SPECTRUM_WINDOW_FLAT_TOP // for reading amplitudes off, at the cost of resolution
+};
+
+static const float SPECTRUM_FLOOR_DB = -140.0f;
+
+// the spectra of the selected channels reduced to pixel columns, each
+// holding the highest bin that falls into it, in dB of a full scale sine
+// NOTE: the values are channel after channel, columnCount each, with
+//       the channels that aren't selected left at SPECTRUM_FLOOR_DB
+struct SpectrumColumns
+{
+    SpectrumColumns() : columnCount(0), channelCount(0), channelMask(0), nyquist(0.0) {}
+    int columnCount;
+    int channelCount;
+    quint32 channelMask;
+    double nyquist; // in Hz, 0 while the rate isn't known
+    QVector<float> averages;
+    QVector<float> peaks; // NOTE: empty without peak hold
+};
+
+// does all the work behind SpectrumView on a thread of its own: keeps
+// the last fftSize packets of every channel, and when asked to, windows
+// and transforms the selected channels, averages the power spectra and
+// reduces them to the view's width
+class SpectrumAnalyzer : public QObject
+{
+    Q_OBJECT
+public:
+    SpectrumAnalyzer(QObject *parent = nullptr);
+public slots:
+    void setColumnCount(int columnCount);
+    void setChannelCount(int channelCount);
+    void setFftSize(int fftSize);
+    void setWindow(int window); // one of SpectrumWindow
+    void setAveraging(int frames); // 1 for none
+    void setPeakHold(bool peakHold);
+    void setChannelMask(quint32 channelMask);
+    void resetPeaks();
+    void addSamples(const STMBL_Servoterm::ScopeSampleBlock &block);
+    void compute(); // NOTE: only if there is anything new since the last time
+signals:
+    void spectrumComputed(const STMBL_Servoterm::SpectrumColumns &columns);
+protected:
+    void _Restart();
+    void _ResetAverages();
+    void _UpdateWindow();
+    void _ReduceToColumns(const float *power, float *columns) const;
+
+    FftPlan _plan;
+    int _window;
+    QVector<float> _windowCoefficients;
+    float _powerScale; // to dB of a full scale sine
+    int _columnCount;
+    int _channelCount;
+    quint32 _channelMask;
+    int _averaging;
+    bool _peakHold;
+    double _nyquist;
+    QVector<float> _samples; // a ring of fftSize packets per channel, one channel after another
+    int _writeIndex;
+    qint64 _received; // packets since the last restart
+    bool _fresh; // anything new since the last compute()
+    QVector<float> _unwrapped;
+    QVector<float> _power;
+    QVector<float> _averages; // the averaged power, binCount per channel
+    QVector<float> _peaks; // the highest power, binCount per channel
+    int _averaged; // how many spectra went into _averages so far
+};
+
+} // namespace STMBL_Servoterm
+
+Q_DECLARE_METATYPE(STMBL_Servoterm::SpectrumColumns)
+
+#endif // STMBL_SERVOTERM_SPECTRUMANALYZER_H
@@ -0,0 +1,212 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SpectrumView.h"
+#include "OscilloscopeRenderer.h"
+
+#include <QResizeEvent>
+#include <QPainter>
+#include <QThread>
+
+#include <cmath>
+
+namespace STMBL_Servoterm {
+
+static const float DECIBELS_PER_DIVISION = 20.0f;
+// the frequency grid lines are at least this far apart
+static const int MINIMUM_FREQUENCY_DIVISION_PIXELS = 80;
+
+static inline int DecibelsToY(float decibels, int h)
+{
+    return qBound(0, static_cast<int>(decibels/SPECTRUM_FLOOR_DB*(h-1)), h-1);
+}
+
+static QString FormatHertz(double hertz)
+{
+    if (hertz >= 1e3)
+        return QString::number(hertz*1e-3, 'g', 4) + " kHz";
+    return QString::number(hertz, 'g', 4) + " Hz";
+}
+
+static void DrawSpectrumLine(QPainter &painter, const float *columns, int columnCount, double xScale, int h)
+{
+    QPolygon points;
+    points.reserve(columnCount);
+    for (int column = 0; column < columnCount; column++)
+        points.append(QPoint(static_cast<int>(column*xScale), DecibelsToY(columns[column], h)));
+    painter.drawPolyline(points);
+}
+
+SpectrumView::SpectrumView(QWidget *parent) :
+    QWidget(parent),
+    _analyzerThread(new QThread(this)),
+    _analyzer(new SpectrumAnalyzer),
+    _channelCount(SCOPE_CHANNEL_COUNT)
+{
+    qRegisterMetaType<STMBL_Servoterm::ScopeSampleBlock>();
+    qRegisterMetaType<STMBL_Servoterm::SpectrumColumns>();
+    setMinimumSize(400, 256);
+
+    _analyzerThread->setObjectName("SpectrumAnalyzer");
+    _analyzer->moveToThread(_analyzerThread);
+    connect(_analyzer, &SpectrumAnalyzer::spectrumComputed, this, &SpectrumView::slot_SpectrumComputed);
+    _analyzerThread->start();
+}
+
+SpectrumView::~SpectrumView()
+{
+    _analyzerThread->quit();
+    _analyzerThread->wait();
+    delete _analyzer; // NOTE: safe now that its thread is gone
+}
+
+void SpectrumView::setChannelCount(int channelCount)
+{
+    channelCount = qBound(1, channelCount, SCOPE_MAXIMUM_CHANNEL_COUNT);
+    if (channelCount == _channelCount)
+        return;
+    _channelCount = channelCount;
+    _columns = SpectrumColumns();
+    QMetaObject::invokeMethod(_analyzer, "setChannelCount", Q_ARG(int, channelCount));
+    update();
+}
+
+void SpectrumView::addChannelsSamples(const ScopeSampleBlock &block)
+{
+    if (!isVisible() || block.channelCount != _channelCount || block.isEmpty())
+        return;
+    // NOTE: the samples are implicitly shared, so this doesn't copy them
+    QMetaObject::invokeMethod(_analyzer, "addSamples", Q_ARG(STMBL_Servoterm::ScopeSampleBlock, block));
+}
+
+void SpectrumView::setFftSize(int fftSize)
+{
+    QMetaObject::invokeMethod(_analyzer, "setFftSize", Q_ARG(int, fftSize));
+}
+
+void SpectrumView::setWindow(int window)
+{
+    QMetaObject::invokeMethod(_analyzer, "setWindow", Q_ARG(int, window));
+}
+
+void SpectrumView::setAveraging(int frames)
+{
+    QMetaObject::invokeMethod(_analyzer, "setAveraging", Q_ARG(int, frames));
+}
+
+void SpectrumView::setPeakHold(bool peakHold)
+{
+    QMetaObject::invokeMethod(_analyzer, "setPeakHold", Q_ARG(bool, peakHold));
+}
+
+void SpectrumView::setChannelMask(quint32 channelMask)
+{
+    QMetaObject::invokeMethod(_analyzer, "setChannelMask", Q_ARG(quint32, channelMask));
+}
+
+void SpectrumView::resetPeaks()
+{
+    QMetaObject::invokeMethod(_analyzer, "resetPeaks");
+}
+
+void SpectrumView::frameTick()
+{
+    if (isVisible())
+        QMetaObject::invokeMethod(_analyzer, "compute");
+}
+
+void SpectrumView::slot_SpectrumComputed(const SpectrumColumns &columns)
+{
+    _columns = columns;
+    update();
+}
+
+void SpectrumView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+    _DrawGrid(painter);
+    if (_columns.columnCount == 0 || _columns.channelCount != _channelCount)
+        return;
+    const int h = height();
+    const double xScale = static_cast<double>(width())/_columns.columnCount;
+    for (int channel = 0; channel < _channelCount; channel++)
+    {
+        if (!(_columns.channelMask & (1u << channel)))
+            continue;
+        QColor color = ScopeChannelColor(channel);
+        if (!_columns.peaks.isEmpty())
+        {
+            // the peaks are drawn fainter, under the averages
+            QColor faint = color;
+            faint.setAlpha(80);
+            painter.setPen(faint);
+            DrawSpectrumLine(painter, _columns.peaks.constData() + channel*_columns.columnCount, _columns.columnCount, xScale, h);
+        }
+        painter.setPen(color);
+        DrawSpectrumLine(painter, _columns.averages.constData() + channel*_columns.columnCount, _columns.columnCount, xScale, h);
+    }
+}
+
+void SpectrumView::resizeEvent(QResizeEvent *event)
+{
+    QMetaObject::invokeMethod(_analyzer, "setColumnCount", Q_ARG(int, event->size().width()));
+    QWidget::resizeEvent(event);
+}
+
+void SpectrumView::_DrawGrid(QPainter &painter)
+{
+    const int w = width();
+    const int h = height();
+    const int fontHeight = painter.fontMetrics().height();
+    const QPen gridPen(Qt::lightGray, 0, Qt::DotLine);
+    for (float decibels = 0.0f; decibels > SPECTRUM_FLOOR_DB; decibels -= DECIBELS_PER_DIVISION)
+    {
+        const int y = DecibelsToY(decibels, h);
+        painter.setPen(gridPen);
+        painter.drawLine(0, y, w-1, y);
+        painter.setPen(Qt::gray);
+        painter.drawText(2, y + fontHeight, QString::number(decibels) + " dB");
+    }
+    if (_columns.nyquist <= 0.0)
+        return;
+
+    // the smallest 1/2/5 step that keeps the grid lines apart
+    const double hertzPerPixel = _columns.nyquist/w;
+    const double minimumDivision = MINIMUM_FREQUENCY_DIVISION_PIXELS*hertzPerPixel;
+    const double decade = std::pow(10.0, std::floor(std::log10(minimumDivision)));
+    double division = decade;
+    if (division < minimumDivision)
+        division = 2.0*decade;
+    if (division < minimumDivision)
+        division = 5.0*decade;
+    if (division < minimumDivision)
+        division = 10.0*decade;
+    for (int i = 1; i*division < _columns.nyquist; i++)
+    {
+        const int x = static_cast<int>(i*division/hertzPerPixel + 0.5);
+        painter.setPen(gridPen);
+        painter.drawLine(x, 0, x, h-1);
+        painter.setPen(Qt::gray);
+        painter.drawText(x + 2, h - fontHeight/2, FormatHertz(i*division));
+    }
+}
+
+} // namespace STMBL_Servoterm
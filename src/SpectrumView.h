@@ -0,0 +1,69 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SPECTRUMVIEW_H
+#define STMBL_SERVOTERM_SPECTRUMVIEW_H
+
+#include "globals.h"
+#include "ScopeSampleBlock.h"
+#include "SpectrumAnalyzer.h"
+
+#include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QThread;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// the spectrum of the selected channels, from 0 Hz up to the Nyquist
+// frequency, in dB of a full scale sine (see SpectrumAnalyzer, which
+// does the transforms on its own thread)
+// NOTE: while hidden, it doesn't even keep the packets
+class SpectrumView : public QWidget
+{
+    Q_OBJECT
+public:
+    SpectrumView(QWidget *parent = nullptr);
+    ~SpectrumView();
+public slots:
+    void setChannelCount(int channelCount);
+    void addChannelsSamples(const STMBL_Servoterm::ScopeSampleBlock &block);
+    void setFftSize(int fftSize);
+    void setWindow(int window);
+    void setAveraging(int frames);
+    void setPeakHold(bool peakHold);
+    void setChannelMask(quint32 channelMask);
+    void resetPeaks();
+    void frameTick(); // NOTE: nothing is transformed otherwise, see FrameClock
+protected slots:
+    void slot_SpectrumComputed(const STMBL_Servoterm::SpectrumColumns &columns);
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void _DrawGrid(QPainter &painter);
+    QThread *_analyzerThread;
+    SpectrumAnalyzer *_analyzer;
+    SpectrumColumns _columns; // the latest ones
+    int _channelCount;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SPECTRUMVIEW_H
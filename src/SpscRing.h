@@ -0,0 +1,102 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_SPSCRING_H
+#define STMBL_SERVOTERM_SPSCRING_H
+
+#include <QVector>
+
+#include <algorithm>
+#include <atomic>
+
+namespace STMBL_Servoterm {
+
+// a pre-allocated, lock-free ring buffer for exactly one producer
+// thread and one consumer thread; neither side ever blocks, the
+// producer just gets told when there isn't enough room
+template<typename T>
+class SpscRing
+{
+public:
+    // NOTE: the capacity is rounded up to a power of two
+    explicit SpscRing(int capacity) : _readIndex(0), _writeIndex(0), _data(nullptr), _mask(0)
+    {
+        int size = 1;
+        while (size < capacity)
+            size <<= 1;
+        _buffer.resize(size);
+        _data = _buffer.data(); // NOTE: detach once, before any threads get involved
+        _mask = size - 1;
+    }
+    int capacity() const {return _buffer.size();}
+
+    // producer side
+    int writeAvailable() const
+    {
+        return capacity() - static_cast<int>(_writeIndex.load(std::memory_order_relaxed) - _readIndex.load(std::memory_order_acquire));
+    }
+    // writes either all of the items or none of them
+    bool tryWrite(const T *items, int count)
+    {
+        if (count > writeAvailable())
+            return false;
+        const quint32 writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        _Copy(items, count, writeIndex);
+        _writeIndex.store(writeIndex + count, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    int readAvailable() const
+    {
+        return static_cast<int>(_writeIndex.load(std::memory_order_acquire) - _readIndex.load(std::memory_order_relaxed));
+    }
+    T peek() const
+    {
+        return _data[_readIndex.load(std::memory_order_relaxed) & _mask];
+    }
+    int read(T *items, int count)
+    {
+        count = qMin(count, readAvailable());
+        const quint32 readIndex = _readIndex.load(std::memory_order_relaxed);
+        const int first = qMin(count, capacity() - static_cast<int>(readIndex & _mask));
+        std::copy(_data + (readIndex & _mask), _data + (readIndex & _mask) + first, items);
+        std::copy(_data, _data + (count - first), items + first);
+        _readIndex.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+protected:
+    void _Copy(const T *items, int count, quint32 writeIndex)
+    {
+        const int first = qMin(count, capacity() - static_cast<int>(writeIndex & _mask));
+        std::copy(items, items + first, _data + (writeIndex & _mask));
+        std::copy(items + first, items + count, _data);
+    }
+
+    // NOTE: the indices run freely and wrap around, only masked when used
+    std::atomic<quint32> _readIndex;
+    std::atomic<quint32> _writeIndex;
+    QVector<T> _buffer;
+    T *_data;
+    quint32 _mask;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_SPSCRING_H
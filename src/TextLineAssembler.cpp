@@ -0,0 +1,96 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "TextLineAssembler.h"
+
+#include <cstring>
+
+namespace STMBL_Servoterm {
+
+TextLineAssembler::TextLineAssembler(int capacity) :
+    _buffer(qMax(1, capacity), Qt::Uninitialized),
+    _size(0),
+    _completeLength(0)
+{
+}
+
+char * TextLineAssembler::prepareWrite(int length)
+{
+    if (_size + length > _buffer.size())
+    {
+        // NOTE: only grows, so this stops happening after the first long burst
+        int capacity = _buffer.size();
+        while (capacity < _size + length)
+            capacity *= 2;
+        _buffer.resize(capacity);
+    }
+    return _buffer.data() + _size;
+}
+
+void TextLineAssembler::commitWrite(int length)
+{
+    const char * const data = _buffer.constData();
+    const int start = _size;
+    _size += length;
+    // only the new bytes can move the end of the last complete line
+    for (int i = _size - 1; i >= start; i--)
+    {
+        if (data[i] == '\n')
+        {
+            _completeLength = i + 1;
+            break;
+        }
+    }
+}
+
+void TextLineAssembler::append(const char *data, int length)
+{
+    std::memcpy(prepareWrite(length), data, length);
+    commitWrite(length);
+}
+
+bool TextLineAssembler::takeLines(QString &lines, bool includePartial)
+{
+    const int length = includePartial ? _size : _completeLength;
+    if (length == 0)
+        return false;
+
+    // Latin-1 maps straight onto the first 256 code points
+    lines.resize(length);
+    const uchar * const src = reinterpret_cast<const uchar *>(_buffer.constData());
+    ushort * const dst = reinterpret_cast<ushort *>(lines.data());
+    for (int i = 0; i < length; i++)
+        dst[i] = src[i];
+
+    // keep the partial line for next time
+    _size -= length;
+    if (_size > 0)
+        std::memmove(_buffer.data(), _buffer.constData() + length, _size);
+    _completeLength = 0;
+    return true;
+}
+
+void TextLineAssembler::clear()
+{
+    _size = 0;
+    _completeLength = 0;
+}
+
+} // namespace STMBL_Servoterm
@@ -0,0 +1,53 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STMBL_SERVOTERM_TEXTLINEASSEMBLER_H
+#define STMBL_SERVOTERM_TEXTLINEASSEMBLER_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace STMBL_Servoterm {
+
+// gathers the console bytes (Latin-1) as they trickle in and hands them
+// out as runs of complete lines; the buffers are reused, so a drive that
+// prints a lot doesn't keep the allocator busy
+class TextLineAssembler
+{
+public:
+    explicit TextLineAssembler(int capacity = 1 << 16);
+    char * prepareWrite(int length); // room for length more bytes, followed by commitWrite()
+    void commitWrite(int length);
+    void append(const char *data, int length);
+    int size() const {return _size;}
+    int completeLength() const {return _completeLength;} // up to and including the last newline
+    // converts the complete lines (or everything, with includePartial) into
+    // lines, reusing its memory, and drops them; false if there was nothing
+    bool takeLines(QString &lines, bool includePartial = false);
+    void clear();
+protected:
+    QByteArray _buffer;
+    int _size;
+    int _completeLength;
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_TEXTLINEASSEMBLER_H
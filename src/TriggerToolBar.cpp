@@ -0,0 +1,128 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TriggerToolBar.h"
+#include "globals.h"
+
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QLabel>
+#include <QAction>
+
+namespace STMBL_Servoterm {
+
+TriggerToolBar::TriggerToolBar(QWidget *parent) :
+    QToolBar("Trigger", parent),
+    _modeList(new QComboBox),
+    _channelList(new QComboBox),
+    _slopeList(new QComboBox),
+    _levelSpinBox(new QDoubleSpinBox),
+    _hysteresisSpinBox(new QDoubleSpinBox),
+    _armAction(new QAction("Arm", this)),
+    _updating(false)
+{
+    setObjectName("TriggerToolBar");
+    _modeList->addItem("Free Run", SCOPE_TRIGGER_FREE_RUN);
+    _modeList->addItem("Auto", SCOPE_TRIGGER_AUTO);
+    _modeList->addItem("Normal", SCOPE_TRIGGER_NORMAL);
+    _modeList->addItem("Single", SCOPE_TRIGGER_SINGLE);
+    _slopeList->addItem("Rising", SCOPE_TRIGGER_RISING);
+    _slopeList->addItem("Falling", SCOPE_TRIGGER_FALLING);
+    setChannelCount(SCOPE_CHANNEL_COUNT);
+    // NOTE: in the samples' full scale units
+    _levelSpinBox->setRange(-1.0, 1.0);
+    _levelSpinBox->setDecimals(3);
+    _levelSpinBox->setSingleStep(0.01);
+    _hysteresisSpinBox->setRange(0.0, 1.0);
+    _hysteresisSpinBox->setDecimals(3);
+    _hysteresisSpinBox->setSingleStep(0.005);
+
+    addWidget(new QLabel("Trigger "));
+    addWidget(_modeList);
+    addWidget(_channelList);
+    addWidget(_slopeList);
+    addWidget(new QLabel(" Level "));
+    addWidget(_levelSpinBox);
+    addWidget(new QLabel(" Hysteresis "));
+    addWidget(_hysteresisSpinBox);
+    addAction(_armAction);
+    setSettings(ScopeTriggerSettings());
+
+    connect(_modeList, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &TriggerToolBar::slot_SettingChanged);
+    connect(_channelList, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &TriggerToolBar::slot_SettingChanged);
+    connect(_slopeList, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &TriggerToolBar::slot_SettingChanged);
+    connect(_levelSpinBox, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), this, &TriggerToolBar::slot_SettingChanged);
+    connect(_hysteresisSpinBox, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), this, &TriggerToolBar::slot_SettingChanged);
+    connect(_armAction, &QAction::triggered, this, &TriggerToolBar::armClicked);
+}
+
+ScopeTriggerSettings TriggerToolBar::settings() const
+{
+    ScopeTriggerSettings settings;
+    settings.mode = static_cast<ScopeTriggerMode>(_modeList->currentData().toInt());
+    settings.slope = static_cast<ScopeTriggerSlope>(_slopeList->currentData().toInt());
+    settings.channel = qMax(0, _channelList->currentIndex());
+    settings.level = static_cast<float>(_levelSpinBox->value());
+    settings.hysteresis = static_cast<float>(_hysteresisSpinBox->value());
+    return settings;
+}
+
+void TriggerToolBar::setSettings(const ScopeTriggerSettings &settings)
+{
+    _updating = true;
+    _modeList->setCurrentIndex(qMax(0, _modeList->findData(settings.mode)));
+    _slopeList->setCurrentIndex(qMax(0, _slopeList->findData(settings.slope)));
+    _channelList->setCurrentIndex(qBound(0, settings.channel, _channelList->count() - 1));
+    _levelSpinBox->setValue(settings.level);
+    _hysteresisSpinBox->setValue(settings.hysteresis);
+    _updating = false;
+    _UpdateArmAction();
+    emit settingsChanged(this->settings());
+}
+
+void TriggerToolBar::setChannelCount(int channelCount)
+{
+    if (channelCount == _channelList->count())
+        return;
+    _updating = true;
+    const int channel = _channelList->currentIndex();
+    _channelList->clear();
+    for (int i = 0; i < channelCount; i++)
+        _channelList->addItem(QString("Channel %1").arg(i + 1));
+    _channelList->setCurrentIndex(qBound(0, channel, channelCount - 1));
+    _updating = false;
+    if (_channelList->currentIndex() != channel)
+        slot_SettingChanged();
+}
+
+void TriggerToolBar::slot_SettingChanged()
+{
+    if (_updating)
+        return;
+    _UpdateArmAction();
+    emit settingsChanged(settings());
+}
+
+void TriggerToolBar::_UpdateArmAction()
+{
+    // NOTE: the other modes rearm by themselves
+    _armAction->setEnabled(_modeList->currentData().toInt() == SCOPE_TRIGGER_SINGLE);
+}
+
+} // namespace STMBL_Servoterm
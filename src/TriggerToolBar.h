@@ -0,0 +1,63 @@
+/*
+* This file is part of the stmbl project.
+*
+* Copyright (C) 2020 Forest Darling <fdarling@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STMBL_SERVOTERM_TRIGGERTOOLBAR_H
+#define STMBL_SERVOTERM_TRIGGERTOOLBAR_H
+
+#include "ScopeTrigger.h"
+
+#include <QToolBar>
+
+QT_BEGIN_NAMESPACE
+class QComboBox;
+class QDoubleSpinBox;
+class QAction;
+QT_END_NAMESPACE
+
+namespace STMBL_Servoterm {
+
+// the oscilloscope's trigger controls
+class TriggerToolBar : public QToolBar
+{
+    Q_OBJECT
+public:
+    TriggerToolBar(QWidget *parent = nullptr);
+    ScopeTriggerSettings settings() const;
+    void setSettings(const ScopeTriggerSettings &settings);
+public slots:
+    void setChannelCount(int channelCount);
+signals:
+    void settingsChanged(const STMBL_Servoterm::ScopeTriggerSettings &settings);
+    void armClicked();
+protected slots:
+    void slot_SettingChanged();
+protected:
+    void _UpdateArmAction();
+    QComboBox *_modeList;
+    QComboBox *_channelList;
+    QComboBox *_slopeList;
+    QDoubleSpinBox *_levelSpinBox;
+    QDoubleSpinBox *_hysteresisSpinBox;
+    QAction *_armAction;
+    bool _updating; // NOTE: so setting the controls doesn't signal every one of them
+};
+
+} // namespace STMBL_Servoterm
+
+#endif // STMBL_SERVOTERM_TRIGGERTOOLBAR_H
@@ -23,101 +23,567 @@
 #include <QResizeEvent>
 #include <QPainter>
 #include <QTimer>
+#include <QStringList>
+
+#include <cmath>
 
 namespace STMBL_Servoterm {
 
 static const int MINIMUM_PLOT_SIZE = 256;
+static const int FADE_INTERVAL_MS = 50;
+static const int MAXIMUM_HITS = 65535;
+static const int MINIMUM_DENSITY_SCALE = 4;
+static const int DEFAULT_DENSITY_HALF_LIFE_MS = 2000;
+static const double DENSITY_GAMMA = 0.45; // NOTE: below 1 brings up the rarely hit points
+
+// the colour of every intensity, from white up to solid blue
+static const QRgb * FadePalette()
+{
+    static QRgb palette[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (int intensity = 0; intensity < 256; intensity++)
+            palette[intensity] = qRgb(255 - intensity, 255 - intensity, 255);
+        initialized = true;
+    }
+    return palette;
+}
+
+// the colour of every density level, from white (never hit)
+// through blue and red to yellow
+static const QRgb * DensityPalette()
+{
+    static const int STOP_COUNT = 4;
+    static const int STOPS[STOP_COUNT] = {1, 96, 192, 255};
+    static const QRgb STOP_COLORS[STOP_COUNT] = {qRgb(176, 176, 255), qRgb(0, 0, 255), qRgb(255, 0, 0), qRgb(255, 224, 0)};
+    static QRgb palette[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+        palette[0] = qRgb(255, 255, 255);
+        for (int stop = 0; stop + 1 < STOP_COUNT; stop++)
+        {
+            const QRgb from = STOP_COLORS[stop];
+            const QRgb to = STOP_COLORS[stop + 1];
+            const int span = STOPS[stop + 1] - STOPS[stop];
+            for (int i = 0; i <= span; i++)
+            {
+                palette[STOPS[stop] + i] = qRgb(qRed(from) + (qRed(to) - qRed(from))*i/span,
+                                                qGreen(from) + (qGreen(to) - qGreen(from))*i/span,
+                                                qBlue(from) + (qBlue(to) - qBlue(from))*i/span);
+            }
+        }
+        initialized = true;
+    }
+    return palette;
+}
+
+// resizes a square plane, every new pixel taking the highest of the old
+// ones it covers (or the nearest one, when growing) so thin traces survive
+template<typename T>
+static QVector<T> ResamplePlane(const QVector<T> &plane, int size, int newSize)
+{
+    QVector<T> resampled(newSize*newSize, 0);
+    if (size <= 0)
+        return resampled;
+    for (int y = 0; y < newSize; y++)
+    {
+        const int firstY = y*size/newSize;
+        const int lastY = qMax(firstY + 1, (y + 1)*size/newSize);
+        for (int x = 0; x < newSize; x++)
+        {
+            const int firstX = x*size/newSize;
+            const int lastX = qMax(firstX + 1, (x + 1)*size/newSize);
+            T value = 0;
+            for (int sy = firstY; sy < lastY; sy++)
+            {
+                for (int sx = firstX; sx < lastX; sx++)
+                    value = qMax(value, plane[sy*size + sx]);
+            }
+            resampled[y*newSize + x] = value;
+        }
+    }
+    return resampled;
+}
+
+QString XYChannelPairsToString(const QVector<XYChannelPair> &pairs)
+{
+    QStringList parts;
+    for (int i = 0; i < pairs.size(); i++)
+        parts.append(QString("%1/%2").arg(pairs[i].x + 1).arg(pairs[i].y + 1));
+    return parts.join(", ");
+}
+
+QVector<XYChannelPair> XYChannelPairsFromString(const QString &text)
+{
+    QVector<XYChannelPair> pairs;
+    const QStringList parts = text.split(',',
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        Qt::SkipEmptyParts);
+#else
+        QString::SkipEmptyParts);
+#endif
+    for (int i = 0; i < parts.size(); i++)
+    {
+        const QStringList channels = parts[i].split('/');
+        bool xOk = false;
+        bool yOk = false;
+        const int x = (channels.size() == 2) ? channels[0].trimmed().toInt(&xOk) : 0;
+        const int y = (channels.size() == 2) ? channels[1].trimmed().toInt(&yOk) : 0;
+        if (!xOk || !yOk || x < 1 || y < 1 || x > SCOPE_MAXIMUM_CHANNEL_COUNT || y > SCOPE_MAXIMUM_CHANNEL_COUNT)
+            return QVector<XYChannelPair>();
+        pairs.append(XYChannelPair(x - 1, y - 1));
+    }
+    return pairs;
+}
 
 XYOscilloscope::XYOscilloscope(QWidget *parent) :
     QWidget(parent),
-    _plot(QSize(MINIMUM_PLOT_SIZE, MINIMUM_PLOT_SIZE), QImage::Format_RGB32),
-    _timer(new QTimer(this))
+    _timer(new QTimer(this)),
+    _plotSize(MINIMUM_PLOT_SIZE),
+    _gridColumns(1),
+    _gridRows(1),
+    _mode(XY_PLOT_PERSISTENCE),
+    _densityMapping(XY_DENSITY_LOG),
+    _densityHalfLife(0),
+    _densityDecay(65536),
+    _peakHits(0),
+    _densityScale(0)
 {
-    _timer->setInterval(50);
+    _timer->setInterval(FADE_INTERVAL_MS);
     connect(_timer, &QTimer::timeout, this, &XYOscilloscope::slot_FadeTimeout);
-    setMinimumSize(MINIMUM_PLOT_SIZE, MINIMUM_PLOT_SIZE); // TODO set a square aspect ratio somehow
-    _plot.fill(Qt::white);
+    setDensityHalfLife(DEFAULT_DENSITY_HALF_LIFE_MS);
+    setChannelPairs(QVector<XYChannelPair>() << XYChannelPair(0, 1));
 }
 
-void XYOscilloscope::addChannelsSample(const QVector<float> &channelsSample)
+int XYOscilloscope::mode() const
 {
-    // update the off-screen buffer
-    QPoint pt(128+channelsSample.at(0)*128, 128-channelsSample.at(1)*128);
-    _plot.setPixel(pt, QColor(Qt::blue).rgba());
-    _points.insert(pt);
+    return _mode;
+}
 
-    // calculate what it would affect in screen coordinates
-    update(_ImageRectToWidgetRect(QRect(pt, QSize(1, 1))));
+QVector<XYChannelPair> XYOscilloscope::channelPairs() const
+{
+    QVector<XYChannelPair> pairs;
+    for (int i = 0; i < _plots.size(); i++)
+        pairs.append(_plots[i].channels);
+    return pairs;
+}
 
-    // make sure fading is re-enabled
-    if (!_timer->isActive())
-        _timer->start();
+void XYOscilloscope::setMode(int mode)
+{
+    if (mode == _mode)
+        return;
+    _mode = mode;
+    _Clear();
 }
 
-void XYOscilloscope::resetScanning()
+void XYOscilloscope::setDensityMapping(int mapping)
 {
+    if (mapping == _densityMapping)
+        return;
+    _densityMapping = mapping;
+    _densityScale = 0; // NOTE: so the table gets rebuilt and everything recoloured
+    for (int i = 0; i < _plots.size(); i++)
+        _plots[i].dirtyRect = _plots[i].dirtyRect.united(_plots[i].litRect);
 }
 
-// apparently the API changed
-#if QT_VERSION > QT_VERSION_CHECK(5, 10, 0)
-    #define SIZE_IN_BYTES_METHOD sizeInBytes
-#else
-    #define SIZE_IN_BYTES_METHOD byteCount
-#endif
+void XYOscilloscope::setDensityHalfLife(int milliseconds)
+{
+    _densityHalfLife = qMax(0, milliseconds);
+    _densityDecay = (_densityHalfLife > 0) ? static_cast<quint32>(65536.0*std::pow(0.5, static_cast<double>(FADE_INTERVAL_MS)/_densityHalfLife)) : 65536;
+    if (_mode == XY_PLOT_DENSITY && _densityHalfLife > 0 && !_timer->isActive())
+        _timer->start();
+}
 
-void XYOscilloscope::slot_FadeTimeout()
+void XYOscilloscope::setChannelPairs(const QVector<XYChannelPair> &pairs)
 {
-    QRect region; // could be done with QRegion too
-    const QRgb whiteVal = QColor(Qt::white).rgba();
-    for (QSet<QPoint>::iterator it = _points.begin(); it != _points.end(); /* */)
+    if (pairs.isEmpty() || pairs == channelPairs())
+        return;
+    // the plots of pairs that stay are kept, the others start out blank
+    QVector<Plot> plots(pairs.size());
+    for (int i = 0; i < pairs.size(); i++)
     {
-        QRgb val = _plot.pixel(*it);
-        val += 0x00010100; // increase the red and green channels (causes the solid blue pixel to fade to white)
-        _plot.setPixel(*it, val);
-        region = region.united(QRect(*it, QSize(1, 1)));
-        if (val == whiteVal)
+        plots[i].channels = pairs[i];
+        for (int j = 0; j < _plots.size(); j++)
         {
-            it = _points.erase(it);
+            if (_plots[j].channels == pairs[i])
+            {
+                plots[i] = _plots[j];
+                break;
+            }
         }
-        else // not fully faded yet
+        if (plots[i].image.isNull())
         {
-            ++it;
+            plots[i].image = QImage(_plotSize, _plotSize, QImage::Format_RGB32);
+            plots[i].image.fill(Qt::white);
+            plots[i].intensities.fill(0, _plotSize*_plotSize);
+            plots[i].hits.fill(0, _plotSize*_plotSize);
         }
     }
+    _plots = plots;
+    _gridColumns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(_plots.size()))));
+    _gridRows = (_plots.size() + _gridColumns - 1)/_gridColumns;
+    setMinimumSize(_gridColumns*MINIMUM_PLOT_SIZE, _gridRows*MINIMUM_PLOT_SIZE);
+    _Layout();
+    update();
+}
+
+void XYOscilloscope::addChannelsSample(const QVector<float> &channelsSample)
+{
+    _PlotSamples(channelsSample.constData(), 1, channelsSample.size());
+}
 
+void XYOscilloscope::addChannelsSamples(const ScopeSampleBlock &block)
+{
+    const int packetCount = block.packetCount();
+    if (packetCount == 0)
+        return;
+    _PlotSamples(block.samples.constData(), packetCount, block.channelCount);
+}
+
+void XYOscilloscope::resetScanning()
+{
+}
+
+void XYOscilloscope::frameTick()
+{
+    // NOTE: the counts are only turned into colours once per frame
+    const bool recolorAll = (_mode == XY_PLOT_DENSITY && _UpdateDensityLevels());
+    for (int i = 0; i < _plots.size(); i++)
+    {
+        Plot &plot = _plots[i];
+        if (recolorAll)
+            plot.dirtyRect = plot.dirtyRect.united(plot.litRect);
+        if (plot.dirtyRect.isNull())
+            continue;
+        if (_mode == XY_PLOT_DENSITY)
+            _Colorize(plot, plot.dirtyRect);
+        update(plot.dirtyRect.translated(_PlotRect(i).topLeft()));
+        plot.dirtyRect = QRect();
+    }
+}
+
+void XYOscilloscope::slot_FadeTimeout()
+{
+    bool anyLit = false;
+    for (int i = 0; i < _plots.size(); i++)
+        anyLit |= !_plots[i].litRect.isNull();
     // if we are done, then disable the timer for performance
-    if (_points.isEmpty())
+    if (!anyLit || (_mode == XY_PLOT_DENSITY && _densityHalfLife == 0))
+    {
         _timer->stop();
-
-    // redraw
-    update(_ImageRectToWidgetRect(region));
+        return;
+    }
+    if (_mode == XY_PLOT_DENSITY)
+        _peakHits = 0; // NOTE: worked out again on the way
+    for (int i = 0; i < _plots.size(); i++)
+    {
+        if (_mode == XY_PLOT_DENSITY)
+            _DecayDensity(_plots[i]);
+        else
+            _FadePersistence(_plots[i]);
+    }
 }
 
 void XYOscilloscope::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event);
-
     QPainter painter(this);
-    const int h = height();
-    const int w = width();
-    painter.drawImage(rect(), _plot);
-    painter.setPen(Qt::gray);
-    painter.drawEllipse(QRect(w/8, h/8, w*3/4-1, h*3/4-1)); // 3/4 size circle
-    // painter.drawEllipse(QRect(0, 0, w-1, h-1)); // full size circle
+    painter.fillRect(event->rect(), Qt::white);
+    for (int i = 0; i < _plots.size(); i++)
+    {
+        const QRect r = _PlotRect(i);
+        if (!r.intersects(event->rect()))
+            continue;
+        painter.drawImage(r.topLeft(), _plots[i].image);
+        painter.setPen(Qt::gray);
+        const int s = r.width();
+        painter.drawEllipse(QRect(r.left() + s/8, r.top() + s/8, s*3/4-1, s*3/4-1)); // 3/4 size circle
+        painter.drawText(r.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop, XYChannelPairsToString(QVector<XYChannelPair>() << _plots[i].channels));
+    }
 }
 
 void XYOscilloscope::resizeEvent(QResizeEvent *event)
 {
+    _Layout();
     QWidget::resizeEvent(event);
 }
 
-QRect XYOscilloscope::_ImageRectToWidgetRect(const QRect &r) const
+QRect XYOscilloscope::_PlotRect(int index) const
+{
+    // the grid is centered in the widget
+    const int left = (width() - _gridColumns*_plotSize)/2;
+    const int top = (height() - _gridRows*_plotSize)/2;
+    return QRect(left + (index % _gridColumns)*_plotSize, top + (index/_gridColumns)*_plotSize, _plotSize, _plotSize);
+}
+
+void XYOscilloscope::_Layout()
+{
+    // as big as the widget allows, keeping the plots square
+    const int plotSize = qMax(1, qMin(width()/_gridColumns, height()/_gridRows));
+    if (plotSize == _plotSize)
+        return;
+    const int oldSize = _plotSize;
+    _plotSize = plotSize;
+    for (int i = 0; i < _plots.size(); i++)
+    {
+        Plot &plot = _plots[i];
+        plot.intensities = ResamplePlane(plot.intensities, oldSize, plotSize);
+        plot.hits = ResamplePlane(plot.hits, oldSize, plotSize);
+        plot.image = QImage(plotSize, plotSize, QImage::Format_RGB32);
+        plot.litRect = plot.litRect.isNull() ? QRect() : QRect(0, 0, plotSize, plotSize);
+        _Colorize(plot, plot.image.rect());
+        plot.dirtyRect = QRect();
+    }
+    update();
+}
+
+void XYOscilloscope::_Clear()
+{
+    for (int i = 0; i < _plots.size(); i++)
+    {
+        Plot &plot = _plots[i];
+        plot.intensities.fill(0);
+        plot.hits.fill(0);
+        plot.litRect = QRect();
+        plot.image.fill(Qt::white);
+        plot.dirtyRect = plot.image.rect();
+    }
+    _peakHits = 0;
+}
+
+void XYOscilloscope::_PlotSamples(const float *samples, int packetCount, int channelCount)
+{
+    // everything a plot needs in the loop, for the ones this block has
+    // the channels of, so one pass over the block feeds them all
+    struct Target
+    {
+        int plot;
+        int xChannel;
+        int yChannel;
+        quint8 *intensities;
+        quint16 *hits;
+        QRgb *pixels;
+        int left;
+        int right;
+        int top;
+        int bottom;
+    };
+    const int size = _plotSize;
+    const int last = size - 1;
+    const float half = 0.5f*size;
+    QVector<Target> targets;
+    for (int i = 0; i < _plots.size(); i++)
+    {
+        Plot &plot = _plots[i];
+        if (plot.channels.x >= channelCount || plot.channels.y >= channelCount)
+            continue;
+        const Target target = {i, plot.channels.x, plot.channels.y, plot.intensities.data(), plot.hits.data(),
+                               reinterpret_cast<QRgb *>(plot.image.bits()), last, 0, last, 0};
+        targets.append(target);
+    }
+    if (targets.isEmpty())
+        return;
+    Target * const begin = targets.data();
+    Target * const end = begin + targets.size();
+
+    // accumulate the whole block, collecting the bounds of what changed
+    if (_mode == XY_PLOT_DENSITY)
+    {
+        int peak = _peakHits;
+        for (int i = 0; i < packetCount; i++)
+        {
+            const float * const packet = samples + i*channelCount;
+            for (Target *target = begin; target != end; ++target)
+            {
+                const int x = qBound(0, static_cast<int>((1.0f + packet[target->xChannel])*half), last);
+                const int y = qBound(0, static_cast<int>((1.0f - packet[target->yChannel])*half), last);
+                quint16 &count = target->hits[y*size + x];
+                count += (count < MAXIMUM_HITS);
+                peak = qMax(peak, static_cast<int>(count));
+                target->left = qMin(target->left, x);
+                target->right = qMax(target->right, x);
+                target->top = qMin(target->top, y);
+                target->bottom = qMax(target->bottom, y);
+            }
+        }
+        _peakHits = peak;
+    }
+    else
+    {
+        // NOTE: the images are always RGB32 without padding
+        const QRgb color = FadePalette()[255];
+        for (int i = 0; i < packetCount; i++)
+        {
+            const float * const packet = samples + i*channelCount;
+            for (Target *target = begin; target != end; ++target)
+            {
+                const int x = qBound(0, static_cast<int>((1.0f + packet[target->xChannel])*half), last);
+                const int y = qBound(0, static_cast<int>((1.0f - packet[target->yChannel])*half), last);
+                target->intensities[y*size + x] = 255;
+                target->pixels[y*size + x] = color;
+                target->left = qMin(target->left, x);
+                target->right = qMax(target->right, x);
+                target->top = qMin(target->top, y);
+                target->bottom = qMax(target->bottom, y);
+            }
+        }
+    }
+    for (Target *target = begin; target != end; ++target)
+    {
+        Plot &plot = _plots[target->plot];
+        const QRect region(QPoint(target->left, target->top), QPoint(target->right, target->bottom));
+        plot.litRect = plot.litRect.united(region);
+
+        // remember what it affected, for the next frame
+        plot.dirtyRect = plot.dirtyRect.united(region);
+    }
+
+    // make sure fading is re-enabled
+    if (!_timer->isActive() && (_mode == XY_PLOT_PERSISTENCE || _densityHalfLife > 0))
+        _timer->start();
+}
+
+void XYOscilloscope::_FadePersistence(Plot &plot)
 {
-    const qreal xScalar = static_cast<qreal>( width())/MINIMUM_PLOT_SIZE;
-    const qreal yScalar = static_cast<qreal>(height())/MINIMUM_PLOT_SIZE;
-    const QTransform trans = QTransform::fromScale(xScalar, yScalar);
-    const QRect widgetPixelRect = trans.mapRect(r);
-    return widgetPixelRect;
+    if (plot.litRect.isNull())
+        return;
+    // one step dimmer, and recoloured, for everything that might be lit,
+    // working out what still will be on the way
+    const QRgb * const palette = FadePalette();
+    const QRect region = plot.litRect;
+    const int w = plot.image.width();
+    int top = region.bottom() + 1;
+    int bottom = region.top() - 1;
+    int left = region.right() + 1;
+    int right = region.left() - 1;
+    for (int y = region.top(); y <= region.bottom(); y++)
+    {
+        quint8 * const intensities = plot.intensities.data() + y*w;
+        QRgb * const pixels = reinterpret_cast<QRgb *>(plot.image.scanLine(y));
+        quint8 lit = 0;
+        for (int x = region.left(); x <= region.right(); x++)
+        {
+            const quint8 intensity = (intensities[x] > 0) ? intensities[x] - 1 : 0;
+            intensities[x] = intensity;
+            lit |= intensity;
+        }
+        for (int x = region.left(); x <= region.right(); x++)
+            pixels[x] = palette[intensities[x]];
+        if (lit == 0)
+            continue;
+        top = qMin(top, y);
+        bottom = y;
+        int first = region.left();
+        while (intensities[first] == 0)
+            first++;
+        int last = region.right();
+        while (intensities[last] == 0)
+            last--;
+        left = qMin(left, first);
+        right = qMax(right, last);
+    }
+    plot.litRect = (top <= bottom) ? QRect(QPoint(left, top), QPoint(right, bottom)) : QRect();
+
+    // redraw, along with the next frame
+    plot.dirtyRect = plot.dirtyRect.united(region);
+}
+
+void XYOscilloscope::_DecayDensity(Plot &plot)
+{
+    if (plot.litRect.isNull())
+        return;
+    // scale every count down, working out the new peak and
+    // what is still lit on the way; the colours follow next frame
+    const QRect region = plot.litRect;
+    const int w = plot.image.width();
+    const quint32 decay = _densityDecay;
+    int peak = _peakHits;
+    int top = region.bottom() + 1;
+    int bottom = region.top() - 1;
+    int left = region.right() + 1;
+    int right = region.left() - 1;
+    for (int y = region.top(); y <= region.bottom(); y++)
+    {
+        quint16 * const hits = plot.hits.data() + y*w;
+        quint16 rowPeak = 0;
+        for (int x = region.left(); x <= region.right(); x++)
+        {
+            const quint16 count = static_cast<quint16>((hits[x]*decay) >> 16);
+            hits[x] = count;
+            rowPeak = qMax(rowPeak, count);
+        }
+        if (rowPeak == 0)
+            continue;
+        peak = qMax(peak, static_cast<int>(rowPeak));
+        top = qMin(top, y);
+        bottom = y;
+        int first = region.left();
+        while (hits[first] == 0)
+            first++;
+        int last = region.right();
+        while (hits[last] == 0)
+            last--;
+        left = qMin(left, first);
+        right = qMax(right, last);
+    }
+    _peakHits = peak;
+    plot.litRect = (top <= bottom) ? QRect(QPoint(left, top), QPoint(right, bottom)) : QRect();
+    plot.dirtyRect = plot.dirtyRect.united(region);
+}
+
+bool XYOscilloscope::_UpdateDensityLevels()
+{
+    // the levels are relative to the peak, rounded up to a power of
+    // two so the table only needs rebuilding once in a while
+    int scale = MINIMUM_DENSITY_SCALE;
+    while (scale < _peakHits)
+        scale *= 2;
+    if (scale == _densityScale)
+        return false;
+    _densityScale = scale;
+    _densityLevels.resize(MAXIMUM_HITS + 1);
+    quint8 * const levels = _densityLevels.data();
+    levels[0] = 0;
+    const double logScale = std::log(static_cast<double>(scale));
+    for (int count = 1; count <= MAXIMUM_HITS; count++)
+    {
+        const double fraction = qMin(1.0, static_cast<double>(count)/scale);
+        const double level = (_densityMapping == XY_DENSITY_GAMMA) ? std::pow(fraction, DENSITY_GAMMA) : std::log(static_cast<double>(qMin(count, scale)))/logScale;
+        levels[count] = static_cast<quint8>(1 + qRound(254.0*level));
+    }
+    return true;
+}
+
+void XYOscilloscope::_Colorize(Plot &plot, const QRect &region)
+{
+    const QRect r = region & plot.image.rect();
+    const int w = plot.image.width();
+    if (_mode == XY_PLOT_DENSITY)
+    {
+        if (_densityLevels.isEmpty())
+            _UpdateDensityLevels();
+        const QRgb * const palette = DensityPalette();
+        const quint8 * const levels = _densityLevels.constData();
+        for (int y = r.top(); y <= r.bottom(); y++)
+        {
+            const quint16 * const hits = plot.hits.constData() + y*w;
+            QRgb * const pixels = reinterpret_cast<QRgb *>(plot.image.scanLine(y));
+            for (int x = r.left(); x <= r.right(); x++)
+                pixels[x] = palette[levels[hits[x]]];
+        }
+    }
+    else
+    {
+        const QRgb * const palette = FadePalette();
+        for (int y = r.top(); y <= r.bottom(); y++)
+        {
+            const quint8 * const intensities = plot.intensities.constData() + y*w;
+            QRgb * const pixels = reinterpret_cast<QRgb *>(plot.image.scanLine(y));
+            for (int x = r.left(); x <= r.right(); x++)
+                pixels[x] = palette[intensities[x]];
+        }
+    }
 }
 
 } // namespace STMBL_Servoterm
@@ -21,39 +21,103 @@
 #define STMBL_SERVOTERM_XYOSCILLOSCOPE_H
 
 #include "globals.h"
+#include "ScopeSampleBlock.h"
 
 #include <QWidget>
 #include <QImage>
-#include <QSet>
+#include <QVector>
 
 QT_BEGIN_NAMESPACE
 class QTimer;
 QT_END_NAMESPACE
 
-inline uint qHash(const QPoint &pt)
+namespace STMBL_Servoterm {
+
+enum XYPlotMode
 {
-    return (pt.y() << 16) + pt.x();
-}
+    XY_PLOT_PERSISTENCE = 0, // every point fades away after it was hit
+    XY_PLOT_DENSITY // how often every point was hit
+};
 
-namespace STMBL_Servoterm {
+enum XYDensityMapping
+{
+    XY_DENSITY_LOG = 0,
+    XY_DENSITY_GAMMA
+};
+
+// the channels an X/Y plot shows, counted from 0
+struct XYChannelPair
+{
+    XYChannelPair(int x = 0, int y = 1) : x(x), y(y) {}
+    bool operator==(const XYChannelPair &other) const {return x == other.x && y == other.y;}
+    int x;
+    int y;
+};
+
+// like "1/2, 3/4", with the channels counted from 1 as in the rest of the UI
+QString XYChannelPairsToString(const QVector<XYChannelPair> &pairs);
+QVector<XYChannelPair> XYChannelPairsFromString(const QString &text); // NOTE: empty if it doesn't parse
 
+// plots channel pairs against each other, either every point fading
+// away over a few seconds after it was hit, or as a heatmap of how
+// often every point was hit (which shows where a trajectory spends its
+// time); the plots are square, in a grid filling the widget, at the
+// widget's own resolution
+// NOTE: each plot is kept as a plane with a value per pixel, which is
+//       decayed and mapped to colours through a table a row at a time,
+//       so it costs the same no matter how many points are lit; when the
+//       widget is resized the planes are resampled, so what was plotted
+//       so far stays
 class XYOscilloscope : public QWidget
 {
     Q_OBJECT
 public:
     XYOscilloscope(QWidget *parent = nullptr);
+    int mode() const;
+    QVector<XYChannelPair> channelPairs() const;
 public slots:
+    void setMode(int mode); // one of XYPlotMode, NOTE: starts the plots over
+    void setDensityMapping(int mapping); // one of XYDensityMapping
+    void setDensityHalfLife(int milliseconds); // 0 accumulates for good
+    void setChannelPairs(const QVector<STMBL_Servoterm::XYChannelPair> &pairs);
     void addChannelsSample(const QVector<float> &channelsSample);
+    void addChannelsSamples(const STMBL_Servoterm::ScopeSampleBlock &block);
     void resetScanning();
+    void frameTick(); // NOTE: nothing is repainted otherwise, see FrameClock
 protected slots:
     void slot_FadeTimeout();
 protected:
+    struct Plot
+    {
+        XYChannelPair channels;
+        QImage image; // _plotSize square
+        QVector<quint8> intensities; // row after row, 255 when just hit down to 0 when gone
+        QVector<quint16> hits; // row after row, saturating
+        QRect litRect; // bounds all the nonzero intensities or hits
+        QRect dirtyRect; // what changed since the last frame
+    };
     void paintEvent(QPaintEvent *event);
     void resizeEvent(QResizeEvent *event);
-    QRect _ImageRectToWidgetRect(const QRect &r) const;
-    QImage _plot;
+    QRect _PlotRect(int index) const; // in the widget
+    void _Layout();
+    void _Clear();
+    void _PlotSamples(const float *samples, int packetCount, int channelCount);
+    void _FadePersistence(Plot &plot);
+    void _DecayDensity(Plot &plot);
+    bool _UpdateDensityLevels(); // returns whether every colour changed
+    void _Colorize(Plot &plot, const QRect &region);
     QTimer *_timer;
-    QSet<QPoint> _points;
+    QVector<Plot> _plots;
+    int _plotSize; // in pixels, every plot is square
+    int _gridColumns;
+    int _gridRows;
+    int _mode;
+    int _densityMapping;
+    int _densityHalfLife;
+    quint32 _densityDecay; // what the hits are multiplied by every fade, in 1/65536ths
+    int _peakHits; // over all the plots, NOTE: never below the real peak
+    int _densityScale; // the count _densityLevels tops out at, a power of two
+    QVector<quint8> _densityLevels; // the colour of every count
 };
 
 } // namespace STMBL_Servoterm
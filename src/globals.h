@@ -22,7 +22,10 @@
 
 namespace STMBL_Servoterm {
 
+// what the firmware sends by default, some builds send more or fewer
+// channels per packet (see ScopeDataDemux::setChannelCount())
 static const int SCOPE_CHANNEL_COUNT = 8;
+static const int SCOPE_MAXIMUM_CHANNEL_COUNT = 16;
 
 } // namespace STMBL_Servoterm
 
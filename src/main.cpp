@@ -17,17 +17,72 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
 
 #include "MainWindow.h"
+#include "DriveSimulator.h"
+#include "globals.h"
+
+static int RunSimulator(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Simulates an STMBL drive on a local TCP port (connect to it with \"localhost:<port>\").");
+    parser.addHelpOption();
+    const QCommandLineOption simulatorOption("simulator", "Run the drive simulator instead of the terminal.");
+    const QCommandLineOption portOption("port", "TCP port to listen on.", "port", "5000");
+    const QCommandLineOption rateOption("rate", "Scope packets per second, 0 to saturate the link.", "packets", "5000");
+    const QCommandLineOption resetIntervalOption("reset-interval", "Packets between scope resets, 0 for none.", "packets", "0");
+    const QCommandLineOption textRateOption("text-rate", "Status lines per second, 0 for none.", "lines", "1");
+    const QCommandLineOption channelsOption("channels", "Scope channels per packet.", "count", QString::number(STMBL_Servoterm::SCOPE_CHANNEL_COUNT));
+    const QCommandLineOption extendedOption("extended", "Send 16-bit, CRC checked extended frames.");
+    parser.addOption(simulatorOption);
+    parser.addOption(portOption);
+    parser.addOption(rateOption);
+    parser.addOption(resetIntervalOption);
+    parser.addOption(textRateOption);
+    parser.addOption(channelsOption);
+    parser.addOption(extendedOption);
+    parser.process(app);
+
+    STMBL_Servoterm::DriveSimulator::Options options;
+    options.port = parser.value(portOption).toUShort();
+    options.packetRate = qBound(0, parser.value(rateOption).toInt(), STMBL_Servoterm::SIMULATOR_MAXIMUM_PACKET_RATE);
+    options.resetInterval = qMax(0, parser.value(resetIntervalOption).toInt());
+    options.textRate = qBound(0, parser.value(textRateOption).toInt(), STMBL_Servoterm::SIMULATOR_MAXIMUM_TEXT_RATE);
+    options.channelCount = parser.value(channelsOption).toInt();
+    options.extendedFrames = parser.isSet(extendedOption);
+
+    QTextStream err(stderr);
+    STMBL_Servoterm::DriveSimulator simulator(options);
+    if (!simulator.listen())
+    {
+        err << "couldn't listen on port " << options.port << ": " << simulator.errorString() << '\n';
+        return 1;
+    }
+    err << "simulating a drive on localhost:" << options.port << '\n';
+    err.flush(); // NOTE: the event loop runs from here on, don't leave it in the buffer
+    return app.exec();
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
     QCoreApplication::setOrganizationName("STMBL");
     QCoreApplication::setApplicationName("Servoterm");
     QCoreApplication::setApplicationVersion("0.1");
 
+    // NOTE: checked before any application object exists, since the
+    // simulator has to run headless (e.g. on a CI machine)
+    for (int i = 1; i < argc; i++)
+    {
+        if (qstrcmp(argv[i], "--simulator") == 0)
+            return RunSimulator(argc, argv);
+    }
+
+    QApplication app(argc, argv);
     STMBL_Servoterm::MainWindow mainWin;
     mainWin.show();
     return app.exec();